@@ -0,0 +1,65 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <vector>
+
+// A buffer for geometry that the CPU regenerates often (the floor,
+// debug lines, particles...). The buffer is split into a ring of
+// segments, each write goes into the next segment, and a fence per
+// segment makes sure the GPU has finished reading a segment before
+// we write to it again. The storage is only (re)allocated when a
+// write is larger than a segment.
+class StreamBuffer {
+public:
+    // segmentSize: bytes per segment, rounded up to a multiple of 'alignment'
+    // alignment:   typically the size of one vertex, so that offsets can
+    //              be turned into a 'first' vertex for glDrawArrays
+    StreamBuffer(GLenum target, GLsizeiptr segmentSize, GLsizeiptr alignment = 4, unsigned int segmentCount = 3);
+    ~StreamBuffer();
+
+    // Allocates the buffer, requires an OpenGL context
+    void Create();
+    // Releases the buffer and fences while the context still exists
+    void Destroy();
+    // Moves to the next segment and maps 'size' bytes of it for writing.
+    // Waits for the GPU only if it is still reading that segment.
+    // Returns nullptr and stays on the current segment if mapping fails.
+    void* Map(GLsizeiptr size);
+    // Finishes writing to the mapped segment
+    void Unmap();
+    // Map, copy and Unmap in one step. Returns the byte offset of the data,
+    // or -1 if the segment could not be mapped.
+    GLintptr Write(const void* data, GLsizeiptr size);
+    // Call after issuing the draws that read the current segment
+    void Fence();
+
+    GLuint GetID() const { return m_bufferID; }
+    // Byte offset of the most recent write, draws should read from here
+    GLintptr GetCurrentOffset() const { return m_currentSegment * m_segmentSize; }
+    // Offset of the most recent write in units of 'alignment'
+    GLint GetCurrentElement() const { return (GLint)(GetCurrentOffset() / m_alignment); }
+    // Number of times we actually had to wait on the GPU
+    unsigned int GetStallCount() const { return m_stalls; }
+    // Number of times a write did not fit and the storage was reallocated
+    unsigned int GetGrowCount() const { return m_grows; }
+
+private:
+    // Reallocates storage so that each segment holds at least 'size' bytes
+    void Grow(GLsizeiptr size);
+    // Blocks until the fence for a segment has been signaled
+    void WaitForSegment(unsigned int segment);
+
+    GLenum m_target;
+    GLuint m_bufferID;
+    GLsizeiptr m_segmentSize;
+    GLsizeiptr m_alignment;
+    unsigned int m_segmentCount;
+    unsigned int m_currentSegment;
+    std::vector<GLsync> m_fences;
+    bool m_mapped;
+    unsigned int m_stalls;
+    unsigned int m_grows;
+};
+
+#endif
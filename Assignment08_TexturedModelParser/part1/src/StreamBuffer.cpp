@@ -0,0 +1,136 @@
+#include "StreamBuffer.hpp"
+#include <cstring>
+#include <iostream>
+
+// Rounds 'size' up to the next multiple of 'alignment'
+static GLsizeiptr AlignUp(GLsizeiptr size, GLsizeiptr alignment) {
+    return ((size + alignment - 1) / alignment) * alignment;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr segmentSize, GLsizeiptr alignment, unsigned int segmentCount)
+    : m_target(target), m_bufferID(0),
+      m_segmentSize(AlignUp(segmentSize, alignment)), m_alignment(alignment),
+      m_segmentCount(segmentCount), m_currentSegment(segmentCount - 1),
+      m_fences(segmentCount, nullptr), m_mapped(false), m_stalls(0), m_grows(0) {}
+
+StreamBuffer::~StreamBuffer() {
+    Destroy();
+}
+
+void StreamBuffer::Create() {
+    glGenBuffers(1, &m_bufferID);
+    glBindBuffer(m_target, m_bufferID);
+    // Storage for every segment is allocated once up front
+    glBufferData(m_target, m_segmentSize * m_segmentCount, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::Destroy() {
+    for (unsigned int i = 0; i < m_segmentCount; ++i) {
+        if (m_fences[i] != nullptr) {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = nullptr;
+        }
+    }
+    if (m_bufferID != 0) {
+        glDeleteBuffers(1, &m_bufferID);
+        m_bufferID = 0;
+    }
+}
+
+void StreamBuffer::Grow(GLsizeiptr size) {
+    // Fences refer to the old storage, which the driver keeps alive
+    // until the GPU is done with it, so they can simply be dropped.
+    for (unsigned int i = 0; i < m_segmentCount; ++i) {
+        if (m_fences[i] != nullptr) {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = nullptr;
+        }
+    }
+    // Double so that a slowly growing mesh does not reallocate every time
+    GLsizeiptr newSize = m_segmentSize;
+    while (newSize < size) {
+        newSize *= 2;
+    }
+    m_segmentSize = AlignUp(newSize, m_alignment);
+    ++m_grows;
+
+    glBindBuffer(m_target, m_bufferID);
+    glBufferData(m_target, m_segmentSize * m_segmentCount, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::WaitForSegment(unsigned int segment) {
+    GLsync fence = m_fences[segment];
+    if (fence == nullptr) {
+        return;
+    }
+    // Poll first, most of the time the GPU finished long ago
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        ++m_stalls;
+        // Flush so the fence is guaranteed to eventually signal
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    if (result == GL_WAIT_FAILED) {
+        std::cerr << "StreamBuffer: glClientWaitSync failed" << std::endl;
+    }
+    glDeleteSync(fence);
+    m_fences[segment] = nullptr;
+}
+
+void* StreamBuffer::Map(GLsizeiptr size) {
+    if (m_mapped) {
+        Unmap();
+    }
+    if (size > m_segmentSize) {
+        Grow(size);
+    }
+
+    // The next segment in the ring, only made current once it is mapped
+    // so a failed map leaves the last good write where it was.
+    unsigned int next = (m_currentSegment + 1) % m_segmentCount;
+    WaitForSegment(next);
+
+    glBindBuffer(m_target, m_bufferID);
+    // The fence already told us the GPU is done with this range, so
+    // the driver does not need to synchronize for us.
+    void* ptr = glMapBufferRange(m_target, next * m_segmentSize, size,
+                                 GL_MAP_WRITE_BIT |
+                                 GL_MAP_INVALIDATE_RANGE_BIT |
+                                 GL_MAP_UNSYNCHRONIZED_BIT);
+    if (ptr == nullptr) {
+        std::cerr << "StreamBuffer: glMapBufferRange failed" << std::endl;
+        return nullptr;
+    }
+    m_currentSegment = next;
+    m_mapped = true;
+    return ptr;
+}
+
+void StreamBuffer::Unmap() {
+    if (!m_mapped) {
+        return;
+    }
+    glBindBuffer(m_target, m_bufferID);
+    glUnmapBuffer(m_target);
+    m_mapped = false;
+}
+
+GLintptr StreamBuffer::Write(const void* data, GLsizeiptr size) {
+    void* ptr = Map(size);
+    if (ptr == nullptr) {
+        return -1;
+    }
+    std::memcpy(ptr, data, size);
+    Unmap();
+    return GetCurrentOffset();
+}
+
+void StreamBuffer::Fence() {
+    // Replace any older fence, we only care about the latest draw
+    if (m_fences[m_currentSegment] != nullptr) {
+        glDeleteSync(m_fences[m_currentSegment]);
+    }
+    m_fences[m_currentSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
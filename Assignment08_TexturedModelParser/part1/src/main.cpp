@@ -20,6 +20,7 @@
 // Our libraries
 #include "Camera.hpp"
 #include "OBJMesh.hpp"
+#include "StreamBuffer.hpp"
 
 // vvvvvvvvvvvvvvvvvvvvvvvvvv Globals vvvvvvvvvvvvvvvvvvvvvvvvvv
 // Globals generally are prefixed with 'g' in this application.
@@ -38,9 +39,30 @@ bool gQuit = false; // If this is quit = 'true' then the program terminates.
 // program object that will be used for our OpenGL draw calls.
 GLuint gGraphicsPipelineShaderProgram   = 0;
 
+// Uniform locations in gGraphicsPipelineShaderProgram.
+// These are looked up once after linking rather than every frame.
+struct UniformLocations {
+    GLint modelMatrix       = -1;
+    GLint viewMatrix        = -1;
+    GLint projection        = -1;
+    GLint texture           = -1;
+    GLint lightPos          = -1;
+    GLint lightColor        = -1;
+    GLint materialAmbient   = -1;
+    GLint materialDiffuse   = -1;
+    GLint materialSpecular  = -1;
+    GLint materialShininess = -1;
+    GLint viewPos           = -1;
+    GLint shadingMode       = -1;
+};
+UniformLocations gUniforms;
+
 // OpenGL Objects
 GLuint gVertexArrayObjectFloor= 0;
-GLuint gVertexBufferObjectFloor = 0;
+// The floor is regenerated whenever its resolution changes, so it
+// lives in a ring of segments rather than a single static buffer.
+StreamBuffer gFloorStream(GL_ARRAY_BUFFER, 64 * 1024, sizeof(GLfloat) * 11);
+GLint gFloorFirstVertex = 0;
 
 // Camera
 Camera gCamera;
@@ -212,6 +234,47 @@ GLuint CreateShaderProgram(const std::string& vertexShaderSource, const std::str
 }
 
 
+/**
+* Looks up a single uniform, reporting (once) if it does not exist.
+*
+* @param name of the uniform in the shader
+* @param required exit if the uniform is missing
+* @return location of the uniform or -1
+*/
+GLint FindUniform(const char* name, bool required){
+    GLint location = glGetUniformLocation(gGraphicsPipelineShaderProgram, name);
+    if(location < 0){
+        std::cout << "Could not find " << name << ", maybe a mispelling?\n";
+        if(required){
+            exit(EXIT_FAILURE);
+        }
+    }
+    return location;
+}
+
+/**
+* Retrieves every uniform location we use once the program is linked.
+* Setting a uniform at location -1 is silently ignored by OpenGL, so
+* optional uniforms that were optimized away are harmless.
+*
+* @return void
+*/
+void QueryUniformLocations(){
+    gUniforms.modelMatrix       = FindUniform("u_ModelMatrix", true);
+    gUniforms.viewMatrix        = FindUniform("u_ViewMatrix", true);
+    gUniforms.projection        = FindUniform("u_Projection", true);
+    gUniforms.texture           = FindUniform("u_texture", false);
+    gUniforms.lightPos          = FindUniform("u_lightPos", false);
+    gUniforms.lightColor        = FindUniform("u_lightColor", false);
+    gUniforms.materialAmbient   = FindUniform("u_materialAmbient", false);
+    gUniforms.materialDiffuse   = FindUniform("u_materialDiffuse", false);
+    gUniforms.materialSpecular  = FindUniform("u_materialSpecular", false);
+    gUniforms.materialShininess = FindUniform("u_materialShininess", false);
+    gUniforms.viewPos           = FindUniform("u_viewPos", false);
+    gUniforms.shadingMode       = FindUniform("u_shadingMode", false);
+}
+
+
 /**
 * Create the graphics pipeline
 *
@@ -223,6 +286,8 @@ void CreateGraphicsPipeline(){
     std::string fragmentShaderSource    = LoadShaderAsString("./shaders/frag.glsl");
 
     gGraphicsPipelineShaderProgram = CreateShaderProgram(vertexShaderSource,fragmentShaderSource);
+
+    QueryUniformLocations();
 }
 
 
@@ -439,19 +504,21 @@ void GeneratePlaneBufferData() {
             vertexDataFloor.push_back(vertex.nx);
             vertexDataFloor.push_back(vertex.ny);
             vertexDataFloor.push_back(vertex.nz);
+            vertexDataFloor.push_back(vertex.s);
+            vertexDataFloor.push_back(vertex.t);
         }
     }
-    // Store size in a global so you can later determine how many
-    // vertices to draw in glDrawArrays;
-    // TODO: You need to verify to yourself if this 'size' represents the number of 'vertices' or not -- think about it.
-    gFloorTriangles = vertexDataFloor.size() / 9;
-
-    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectFloor);
-    glBufferData(GL_ARRAY_BUFFER,                       // Kind of buffer we are working with
-                            // (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
-                     vertexDataFloor.size() * sizeof(GL_FLOAT),     // Size of data in bytes
-                     vertexDataFloor.data(),                                            // Raw array of data
-                     GL_STATIC_DRAW);
+    // Write into the next segment of the ring rather than reallocating
+    // the whole buffer, and remember where the floor starts so Draw()
+    // reads from the segment we just filled. If the write failed the
+    // previous floor is still intact, so keep drawing that one.
+    if (gFloorStream.Write(vertexDataFloor.data(), vertexDataFloor.size() * sizeof(GLfloat)) >= 0) {
+        // Store size in a global so you can later determine how many
+        // vertices to draw in glDrawArrays;
+        // TODO: You need to verify to yourself if this 'size' represents the number of 'vertices' or not -- think about it.
+        gFloorTriangles = vertexDataFloor.size() / 11;
+        gFloorFirstVertex = gFloorStream.GetCurrentElement();
+    }
 }
 
 
@@ -463,9 +530,8 @@ void GeneratePlaneBufferData() {
 void VertexSpecification() {
     glGenVertexArrays(1, &gVertexArrayObjectFloor);
     glBindVertexArray(gVertexArrayObjectFloor);
-    glGenBuffers(1, &gVertexBufferObjectFloor);
-
-    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObjectFloor);
+    // Allocates (and binds) the storage for every segment of the floor
+    gFloorStream.Create();
 
     // Position
     glEnableVertexAttribArray(0);
@@ -522,48 +588,22 @@ void PreDraw(){
     // Model transformation by translating our object into world space
     glm::mat4 model = glm::translate(glm::mat4(1.0f),glm::vec3(0.0f,0.0f,0.0f));
 
-    // Retrieve our location of our Model Matrix
-    GLint u_ModelMatrixLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_ModelMatrix");
-    if(u_ModelMatrixLocation >=0){
-        glUniformMatrix4fv(u_ModelMatrixLocation,1,GL_FALSE,&model[0][0]);
-    }else{
-        std::cout << "Could not find u_ModelMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
+    // Update our model matrix
+    glUniformMatrix4fv(gUniforms.modelMatrix,1,GL_FALSE,&model[0][0]);
 
     // Update the View Matrix
-    GLint u_ViewMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram,"u_ViewMatrix");
-    if(u_ViewMatrixLocation>=0){
-        glm::mat4 viewMatrix = gCamera.GetViewMatrix();
-        glUniformMatrix4fv(u_ViewMatrixLocation,1,GL_FALSE,&viewMatrix[0][0]);
-    }else{
-        std::cout << "Could not find u_ViewMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
+    glm::mat4 viewMatrix = gCamera.GetViewMatrix();
+    glUniformMatrix4fv(gUniforms.viewMatrix,1,GL_FALSE,&viewMatrix[0][0]);
 
     // Projection matrix (in perspective)
     glm::mat4 perspective = glm::perspective(glm::radians(45.0f),
                                              (float)gScreenWidth/(float)gScreenHeight,
                                              0.1f,
                                              20.0f);
+    glUniformMatrix4fv(gUniforms.projection,1,GL_FALSE,&perspective[0][0]);
 
-    // Retrieve our location of our perspective matrix uniform
-    GLint u_ProjectionLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_Projection");
-    if(u_ProjectionLocation>=0){
-        glUniformMatrix4fv(u_ProjectionLocation,1,GL_FALSE,&perspective[0][0]);
-    }else{
-        std::cout << "Could not find u_Projection, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
-    }
-
-        GLint textureLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_texture");
-    if(textureLocation >= 0) {
-        glUniform1i(textureLocation, 0); // Use texture unit 0
-    } else {
-        std::cout << "Could not find u_texture uniform location\n";
-    }
+    // Use texture unit 0
+    glUniform1i(gUniforms.texture, 0);
 
     float timeValue = SDL_GetTicks() / 1000.0f;
 
@@ -574,60 +614,27 @@ void PreDraw(){
     float lightZ = cos(timeValue) * radius;
     glm::vec3 lightPos(lightX, lightY, lightZ);
 
-    // Create model matrix for light box
-glm::mat4 lightModel = glm::translate(glm::mat4(1.0f), glm::vec3(lightX, lightY, lightZ));
-lightModel = glm::scale(lightModel, glm::vec3(0.2f)); // Scale the light box
-
     // Set light position uniform
-    GLint u_lightPosLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_lightPos");
-    if (u_lightPosLocation >= 0) {
-        glUniform3fv(u_lightPosLocation, 1, &lightPos[0]);
-    }
+    glUniform3fv(gUniforms.lightPos, 1, &lightPos[0]);
 
     // Set light color uniform
     glm::vec3 lightColor(1.0f, 1.0f, 1.0f); // White light
-    GLint u_lightColorLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_lightColor");
-    if (u_lightColorLocation >= 0) {
-        glUniform3fv(u_lightColorLocation, 1, &lightColor[0]);
-    }
+    glUniform3fv(gUniforms.lightColor, 1, &lightColor[0]);
 
     glm::vec3 materialAmbient(0.1f, 0.1f, 0.1f);
     glm::vec3 materialDiffuse(0.5f, 0.5f, 0.5f);
     glm::vec3 materialSpecular(1.0f, 1.0f, 1.0f);
     float materialShininess = 32.0f;
 
-    GLint u_materialAmbientLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_materialAmbient");
-    if (u_materialAmbientLocation >= 0) {
-        glUniform3fv(u_materialAmbientLocation, 1, &materialAmbient[0]);
-    }
-
-    GLint u_materialDiffuseLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_materialDiffuse");
-    if (u_materialDiffuseLocation >= 0) {
-        glUniform3fv(u_materialDiffuseLocation, 1, &materialDiffuse[0]);
-    }
-
-    GLint u_materialSpecularLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_materialSpecular");
-    if (u_materialSpecularLocation >= 0) {
-        glUniform3fv(u_materialSpecularLocation, 1, &materialSpecular[0]);
-    }
-
-    GLint u_materialShininessLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_materialShininess");
-    if (u_materialShininessLocation >= 0) {
-        glUniform1f(u_materialShininessLocation, materialShininess);
-    }
+    glUniform3fv(gUniforms.materialAmbient, 1, &materialAmbient[0]);
+    glUniform3fv(gUniforms.materialDiffuse, 1, &materialDiffuse[0]);
+    glUniform3fv(gUniforms.materialSpecular, 1, &materialSpecular[0]);
+    glUniform1f(gUniforms.materialShininess, materialShininess);
 
     glm::vec3 cameraPos = gCamera.GetEyePosition();
-    GLint u_viewPosLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_viewPos");
-    if (u_viewPosLocation >= 0) {
-        glUniform3fv(u_viewPosLocation, 1, &cameraPos[0]);
-    }
-
-    GLint u_shadingModeLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_shadingMode");
-    if (u_shadingModeLocation >= 0) {
-        glUniform1i(u_shadingModeLocation, g_shadingMode);
-    }
+    glUniform3fv(gUniforms.viewPos, 1, &cameraPos[0]);
 
-GLint u_LightModelMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_ModelMatrix");
+    glUniform1i(gUniforms.shadingMode, g_shadingMode);
 }
 
 
@@ -642,7 +649,9 @@ GLint u_LightModelMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderP
 void Draw() {
     // Draw floor
     glBindVertexArray(gVertexArrayObjectFloor);
-    glDrawArrays(GL_TRIANGLES, 0, gFloorTriangles);
+    glDrawArrays(GL_TRIANGLES, gFloorFirstVertex, gFloorTriangles);
+    // Mark the segment as in use until the GPU has drawn it
+    gFloorStream.Fence();
 
     // Draw model
     if (gRenderModel) {
@@ -660,17 +669,14 @@ void Draw() {
     glm::mat4 lightModel = glm::translate(glm::mat4(1.0f), glm::vec3(lightX, lightY, lightZ));
     lightModel = glm::scale(lightModel, glm::vec3(0.2f));
 
-    GLint u_ModelMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_ModelMatrix");
-    if(u_ModelMatrixLocation >= 0) {
-        glUniformMatrix4fv(u_ModelMatrixLocation, 1, GL_FALSE, &lightModel[0][0]);
-    }
+    glUniformMatrix4fv(gUniforms.modelMatrix, 1, GL_FALSE, &lightModel[0][0]);
 
     glBindVertexArray(gVertexArrayObjectLight);
     glDrawArrays(GL_TRIANGLES, 0, gLightBoxVertices);
 
     // Reset model matrix for next frame if needed
     glm::mat4 defaultModel = glm::mat4(1.0f);
-    glUniformMatrix4fv(u_ModelMatrixLocation, 1, GL_FALSE, &defaultModel[0][0]);
+    glUniformMatrix4fv(gUniforms.modelMatrix, 1, GL_FALSE, &defaultModel[0][0]);
 }
 
 /**
@@ -724,8 +730,10 @@ void Input(){
     if (state[SDL_SCANCODE_UP]) {
         SDL_Delay(250);
         gFloorResolution+=1;
-        std::cout << "Resolution:" << gFloorResolution << std::endl;
-        //GeneratePlaneBufferData();
+        GeneratePlaneBufferData();
+        std::cout << "Resolution:" << gFloorResolution
+                  << " (floor stream: " << gFloorStream.GetGrowCount() << " grows, "
+                  << gFloorStream.GetStallCount() << " stalls)" << std::endl;
     }
     if (state[SDL_SCANCODE_DOWN]) {
         SDL_Delay(250);
@@ -733,8 +741,10 @@ void Input(){
         if(gFloorResolution<=1){
             gFloorResolution=1;
         }
-        std::cout << "Resolution:" << gFloorResolution << std::endl;
-        //GeneratePlaneBufferData();
+        GeneratePlaneBufferData();
+        std::cout << "Resolution:" << gFloorResolution
+                  << " (floor stream: " << gFloorStream.GetGrowCount() << " grows, "
+                  << gFloorStream.GetStallCount() << " stalls)" << std::endl;
     }
 
     // Camera
@@ -826,7 +836,7 @@ void CleanUp(){
     SDL_DestroyWindow(gGraphicsApplicationWindow );
     gGraphicsApplicationWindow = nullptr;
 
-    glDeleteBuffers(1, &gVertexBufferObjectFloor);
+    gFloorStream.Destroy();
     glDeleteVertexArrays(1, &gVertexArrayObjectFloor);
     glDeleteBuffers(1, &gVertexBufferObjectModel);
     glDeleteVertexArrays(1, &gVertexArrayObjectModel);
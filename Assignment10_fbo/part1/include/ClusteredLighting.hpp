@@ -0,0 +1,104 @@
+/** @file ClusteredLighting.hpp
+ *  @brief Assigns point lights to 3D clusters of the view frustum.
+ *
+ *  The view frustum is cut into a grid of screen tiles, and each tile
+ *  is sliced in depth (exponentially, so near slices are thin). Every
+ *  frame each light's bounding sphere is tested against the clusters it
+ *  could touch, and a list of light indices is built per cluster.
+ *
+ *  The lights, the per cluster (offset,count) grid and the index list
+ *  are uploaded into texture buffers. The fragment shader finds its
+ *  cluster from gl_FragCoord and its depth, and only shades the lights
+ *  in that cluster. Shading cost then depends on how many lights
+ *  overlap a pixel rather than on the number of lights in the scene.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef CLUSTEREDLIGHTING_HPP
+#define CLUSTEREDLIGHTING_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "UniformBuffer.hpp"
+
+// Size of our cluster grid
+const unsigned int CLUSTER_TILES_X = 16;
+const unsigned int CLUSTER_TILES_Y = 9;
+const unsigned int CLUSTER_SLICES  = 24;
+const unsigned int CLUSTER_COUNT   = CLUSTER_TILES_X*CLUSTER_TILES_Y*CLUSTER_SLICES;
+// Lights beyond this in a single cluster are dropped
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+// Texture slots the shader reads our buffers from
+const unsigned int CLUSTER_LIGHT_SLOT = 3;
+const unsigned int CLUSTER_GRID_SLOT  = 4;
+const unsigned int CLUSTER_INDEX_SLOT = 5;
+
+class ClusteredLighting{
+public:
+    // Constructor
+    ClusteredLighting();
+    // Destructor
+    ~ClusteredLighting();
+    // Creates our texture buffers
+    void Create(unsigned int screenWidth, unsigned int screenHeight);
+    // Rebuilds the cluster bounds. Only does work when the projection changes.
+    void SetProjection(const glm::mat4& projection, float zNear, float zFar);
+    // Assigns the lights to clusters and uploads the result
+    void Update(const std::vector<PointLightData>& lights, const glm::mat4& view);
+    // Binds our texture buffers to their texture slots
+    void Bind() const;
+    // Deletes our buffers
+    void Destroy();
+    // The values our shader needs to find a cluster (stored in FrameData)
+    // x: slice scale, y: slice bias, z,w: tile size in pixels
+    glm::vec4 GetScaleBias() const;
+    // Number of clusters in x, y and z
+    glm::ivec4 GetGridSize() const;
+    // How far a light reaches before it contributes less than 1/256
+    static float ComputeLightRadius(const PointLightData& light, float zFar);
+    // Statistics from the last Update
+    unsigned int GetLightCount() const { return m_lightCount; }
+    unsigned int GetLightIndexCount() const { return m_indices.size(); }
+    unsigned int GetDroppedCount() const { return m_dropped; }
+
+private:
+    // Appends 'light' to every cluster in the slices it overlaps
+    void AssignLight(uint16_t light, const glm::vec3& center, float radius);
+    // One texture buffer (a GL buffer plus a texture viewing it)
+    struct TextureBuffer{
+        GLuint buffer{0};
+        GLuint texture{0};
+    };
+    void CreateTextureBuffer(TextureBuffer& tb, GLenum format);
+    void UploadTextureBuffer(const TextureBuffer& tb, const void* data, GLsizeiptr size);
+
+    unsigned int m_screenWidth{0};
+    unsigned int m_screenHeight{0};
+    float m_near{0.0f};
+    float m_far{0.0f};
+    glm::mat4 m_projection{0.0f};
+    // Cluster bounds in view space, stored as separate arrays
+    // so four clusters can be tested at once.
+    std::vector<float> m_minX, m_minY, m_minZ;
+    std::vector<float> m_maxX, m_maxY, m_maxZ;
+    // Lights assigned to each cluster while building
+    std::vector<uint16_t> m_clusterCounts;
+    std::vector<uint16_t> m_clusterLights;
+    // What we upload
+    std::vector<glm::vec4> m_lightTexels;
+    std::vector<uint32_t>  m_grid;
+    std::vector<uint16_t>  m_indices;
+    TextureBuffer m_lightBuffer;
+    TextureBuffer m_gridBuffer;
+    TextureBuffer m_indexBuffer;
+    unsigned int m_lightCount{0};
+    unsigned int m_dropped{0};
+};
+
+#endif
@@ -4,6 +4,11 @@
  * The 'Create' function needs to be called before using the  
  * framebuffer.
  *
+ * A framebuffer can instead be created depth only, for shadow maps.
+ * Its depth texture is then either an array of square layers (one per
+ * shadow cascade) or a cube map (one face per direction around a point
+ * light), and BindLayer picks the layer that is drawn into.
+ *
  *  @author Mike
  *  @bug No known bugs.
  *
@@ -26,8 +31,24 @@ public:
     ~Framebuffer();
     // Create the framebuffer
     void Create(int width, int height);
+    // Creates a depth only framebuffer with 'layers' square layers.
+    // Returns false if the framebuffer is incomplete.
+    bool CreateDepthArray(int size, int layers);
+    // Creates a depth only framebuffer of six square cube map faces.
+    // Returns false if the framebuffer is incomplete.
+    bool CreateDepthCube(int size);
     // Select our framebuffer
     void Bind();
+    // Selects a depth only framebuffer with one layer (or cube face) attached
+    void BindLayer(int layer);
+    // Copies one layer of depth from a framebuffer created the same way
+    void CopyDepthLayer(Framebuffer& source, int layer);
+    // The depth texture of a depth only framebuffer
+    GLuint GetDepthTexture() const { return m_depthTexture; }
+    // GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP
+    GLenum GetDepthTarget() const { return m_depthTarget; }
+    // Width and height of each layer of a depth only framebuffer
+    int GetDepthSize() const { return m_depthSize; }
     // Update our framebuffer once per frame for any
     // changes that may have occurred.
     void Update();
@@ -38,6 +59,10 @@ public:
 private: 
     // Creates a quad that will be overlaid on top of the screen
     void SetupScreenQuad(float x,float y, float w, float h);
+    // Creates the depth texture and framebuffer for CreateDepthArray/Cube
+    bool CreateDepth(GLenum target, int size, int layers);
+    // Attaches one layer of our depth texture to 'framebufferTarget'
+    void AttachDepthLayer(GLenum framebufferTarget, int layer);
 // public member variables
 public:
     std::shared_ptr<Shader> m_fboShader;
@@ -49,6 +74,11 @@ private:
     unsigned int m_fbo_id; 
     // Finally create our render buffer object
     unsigned int m_rbo_id;
+    // Depth only framebuffers
+    GLuint m_depthTexture{0};
+    GLenum m_depthTarget{0};
+    int m_depthSize{0};
+    int m_depthLayers{0};
     // Store our screen buffer
     unsigned int m_quadVAO;
     unsigned int m_quadVBO;
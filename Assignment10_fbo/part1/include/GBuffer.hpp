@@ -0,0 +1,52 @@
+/** @file GBuffer.hpp
+ *  @brief The geometry buffer used by the deferred renderer.
+ *
+ *  The deferred path first draws the scene into several textures at
+ *  once (multiple render targets) without doing any lighting:
+ *      - albedo            (RGBA8)
+ *      - normal            (RG16F, octahedral encoded)
+ *      - depth             (DEPTH24_STENCIL8, used to rebuild position)
+ *  A second pass then lights every pixel exactly once from these
+ *  textures, so overdraw no longer multiplies the lighting cost.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef GBUFFER_HPP
+#define GBUFFER_HPP
+
+#include <glad/glad.h>
+
+// Texture slots the lighting pass reads the G-buffer from
+const unsigned int GBUFFER_ALBEDO_SLOT = 0;
+const unsigned int GBUFFER_NORMAL_SLOT = 1;
+const unsigned int GBUFFER_DEPTH_SLOT  = 2;
+
+class GBuffer{
+public:
+    // Constructor
+    GBuffer();
+    // Destructor
+    ~GBuffer();
+    // Creates our attachments. Returns false if the framebuffer is incomplete.
+    bool Create(int width, int height);
+    // Select our framebuffer and both color targets for drawing
+    void Bind();
+    // Done with our framebuffer
+    void Unbind();
+    // Binds our textures to their slots for the lighting pass
+    void BindTextures() const;
+    // Draws a quad over the whole screen
+    void DrawFullscreenQuad() const;
+    // Deletes everything
+    void Destroy();
+private:
+    GLuint m_fbo{0};
+    GLuint m_albedo{0};
+    GLuint m_normal{0};
+    GLuint m_depth{0};
+    GLuint m_quadVAO{0};
+    GLuint m_quadVBO{0};
+};
+
+#endif
@@ -0,0 +1,130 @@
+/** @file GeometryArena.hpp
+ *  @brief One set of large vertex/index buffers shared by every object.
+ *
+ *  Rather than each object owning its own VAO, VBO and IBO, the
+ *  GeometryArena owns a handful of large 'pages' per vertex format.
+ *  Objects receive a small (baseVertex, firstIndex, count) allocation
+ *  inside of a page and are drawn with glDrawElementsBaseVertex. Since
+ *  most objects end up in the same page, most draws do not need to
+ *  rebind a VAO or any buffers at all.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+// The glad library helps setup OpenGL extensions.
+#include <glad/glad.h>
+
+#include <iterator>
+#include <map>
+#include <vector>
+
+// The vertex formats supported by the arena.
+// These match the layouts that VertexBufferLayout creates.
+enum class VertexFormat{
+    Position=0, // x,y,z
+    Texture,    // x,y,z, s,t
+    Normal,     // x,y,z, nx,ny,nz, s,t, tx,ty,tz, bx,by,bz
+    Count
+};
+
+// Hands out ranges [offset, offset+size) from a fixed capacity.
+// Free ranges are kept sorted by offset so neighbouring ranges
+// can be merged back together when they are released.
+class FreeListAllocator{
+public:
+    // Returned from Allocate when there is no room left
+    static const unsigned int INVALID_OFFSET = 0xFFFFFFFF;
+    // Create an allocator managing 'capacity' units
+    FreeListAllocator(unsigned int capacity);
+    // Returns the offset of a free range of 'size' units (first fit)
+    // or INVALID_OFFSET if no range is large enough.
+    unsigned int Allocate(unsigned int size);
+    // Returns a previously allocated range to the free list
+    void Free(unsigned int offset, unsigned int size);
+    // Total number of units managed
+    unsigned int GetCapacity() const { return m_capacity; }
+    // Number of units currently handed out
+    unsigned int GetUsed() const { return m_used; }
+private:
+    // offset -> size of each free range
+    std::map<unsigned int, unsigned int> m_freeRanges;
+    unsigned int m_capacity;
+    unsigned int m_used{0};
+};
+
+// Where an object's geometry lives inside of the arena.
+struct GeometryAllocation{
+    // Which page (i.e. VAO/VBO/IBO) the data lives in
+    int page{-1};
+    // Added to every index when drawing
+    GLint baseVertex{0};
+    // First index in the page's index buffer
+    unsigned int firstIndex{0};
+    // Number of vertices and indices that were allocated
+    unsigned int vertexCount{0};
+    unsigned int indexCount{0};
+    // An allocation is only valid once it has been placed in a page
+    bool IsValid() const { return page >= 0; }
+};
+
+// Purpose:
+// Owns all of the static geometry for the program.
+//
+class GeometryArena{
+public:
+    // Singleton pattern for having one single arena
+    static GeometryArena& Instance();
+    // Copies geometry into the arena and returns where it was placed.
+    // vcount: the number of floats in vdata (not the number of vertices)
+    // icount: the number of indices in idata
+    GeometryAllocation Allocate(VertexFormat format, unsigned int vcount, unsigned int icount, float* vdata, unsigned int* idata);
+    // Releases an allocation so the space can be reused
+    void Free(GeometryAllocation& allocation);
+    // Selects the page an allocation lives in.
+    // Nothing is bound if that page is already selected.
+    void Bind(const GeometryAllocation& allocation);
+    // Binds (if needed) and draws an allocation as triangles
+    void Draw(const GeometryAllocation& allocation);
+    // Call when some other code has bound its own VAO so that
+    // the next Bind actually selects our page again.
+    void InvalidateBindings();
+    // Deletes every page. Must be called while the OpenGL context exists.
+    void Destroy();
+    // Statistics
+    unsigned int GetPageCount() const { return m_pages.size(); }
+    unsigned int GetDrawCount() const { return m_drawCount; }
+    unsigned int GetVAOBindCount() const { return m_vaoBindCount; }
+    void ResetStats();
+
+private:
+    // One VAO/VBO/IBO triple for a single vertex format
+    struct Page{
+        Page(VertexFormat f, unsigned int maxVertices, unsigned int maxIndices);
+        VertexFormat format;
+        GLuint vao{0};
+        GLuint vbo{0};
+        GLuint ibo{0};
+        FreeListAllocator vertices;
+        FreeListAllocator indices;
+    };
+    // Constructor is private because we should
+    // not be able to construct any other arenas.
+    GeometryArena();
+    // Creates a new page large enough for at least the given counts
+    int CreatePage(VertexFormat format, unsigned int vertexCount, unsigned int indexCount);
+    // All of our pages
+    std::vector<Page> m_pages;
+    // The VAO we last bound (0 when unknown)
+    GLuint m_boundVAO{0};
+    // Number of draws and VAO binds since the last ResetStats
+    unsigned int m_drawCount{0};
+    unsigned int m_vaoBindCount{0};
+};
+
+// Returns the number of floats per vertex for a format
+unsigned int GetVertexFormatStride(VertexFormat format);
+
+#endif
@@ -15,7 +15,7 @@
 #include <string>
 
 // Forward declarations
-#include "VertexBufferLayout.hpp"
+#include "GeometryArena.hpp"
 #include "Texture.hpp"
 #include "Transform.hpp"
 #include "Geometry.hpp"
@@ -43,8 +43,8 @@ public:
 	void Bind();
 protected: // Classes that inherit from Object are intended to be overridden.
 
-    // For now we have one buffer per object.
-    VertexBufferLayout m_vertexBufferLayout;
+    // Where our geometry lives in the shared GeometryArena
+    GeometryAllocation m_geometryAllocation;
     // For now we have one diffuse map
     Texture m_textureDiffuse;
     // Terrains are often 'multitextured' and have multiple textures.
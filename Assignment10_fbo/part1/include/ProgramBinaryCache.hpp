@@ -0,0 +1,74 @@
+/** @file ProgramBinaryCache.hpp
+ *  @brief Saves linked shader programs to disk so they do not need to be rebuilt.
+ *
+ *  Compiling and linking GLSL from text is slow, especially on software
+ *  OpenGL drivers. After a program links, the driver's binary form of it
+ *  is written into a cache directory. Later runs load that binary with
+ *  glProgramBinary instead of compiling again.
+ *
+ *  Entries are keyed by the hash of the program's sources combined with
+ *  the GL vendor, renderer and version strings, since binaries are only
+ *  valid for the driver that produced them. A driver may still reject a
+ *  binary (e.g. after an update), in which case the caller falls back to
+ *  compiling from source and the entry is rewritten.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef PROGRAMBINARYCACHE_HPP
+#define PROGRAMBINARYCACHE_HPP
+
+#include <glad/glad.h>
+
+#include <string>
+#include <cstdint>
+
+class ProgramBinaryCache{
+public:
+    // Singleton pattern for having one single cache
+    static ProgramBinaryCache& Instance();
+    // Where cache files are read from and written to.
+    // Defaults to ./shadercache
+    void SetDirectory(const std::string& directory);
+    // Turn the cache on or off (on by default when the driver supports it)
+    void SetEnabled(bool enabled);
+    // True if the driver can hand us program binaries
+    bool IsSupported();
+    // Must be called on a new program before glLinkProgram so the
+    // driver keeps a retrievable binary around.
+    void PrepareProgram(GLuint program);
+    // Tries to fill 'program' from the cache. Returns true if the
+    // binary was found and the driver accepted it.
+    bool Load(uint64_t sourceHash, GLuint program);
+    // Writes the binary of a successfully linked program to the cache
+    void Store(uint64_t sourceHash, GLuint program);
+    // Statistics
+    unsigned int GetHitCount() const { return m_hits; }
+    unsigned int GetMissCount() const { return m_misses; }
+    // Binaries that were found but rejected by the driver
+    unsigned int GetRejectCount() const { return m_rejects; }
+    // Prints hit/miss counts
+    void PrintStats() const;
+
+private:
+    // Constructor is private because we should
+    // not be able to construct any other caches.
+    ProgramBinaryCache();
+    // Loads the entry points and the driver identity. Needs a GL context.
+    void Initialize();
+    // The file a program is stored in
+    std::string GetPath(uint64_t sourceHash) const;
+
+    std::string m_directory{"./shadercache"};
+    // vendor, renderer and version joined together
+    std::string m_driver;
+    uint64_t m_driverHash{0};
+    bool m_initialized{false};
+    bool m_supported{false};
+    bool m_enabled{true};
+    unsigned int m_hits{0};
+    unsigned int m_misses{0};
+    unsigned int m_rejects{0};
+};
+
+#endif
@@ -26,8 +26,18 @@
 #include "SceneNode.hpp"
 #include "Camera.hpp"
 #include "Framebuffer.hpp"
+#include "UniformBuffer.hpp"
+#include "ClusteredLighting.hpp"
+#include "GBuffer.hpp"
+#include "ShadowMaps.hpp"
 
 
+// How the scene is shaded
+enum class RenderPath{
+    Forward,    // Light every fragment as objects are drawn
+    Deferred    // Fill a G-buffer, then light each pixel once
+};
+
 class Renderer{
 public:
     // The constructor	
@@ -42,6 +52,18 @@ public:
     // Sets the root of our renderer to some node to
     // draw an entire scene graph
     void setRoot(std::shared_ptr<SceneNode> startingNode);
+    // Chooses forward or deferred shading, can change every frame
+    void SetRenderPath(RenderPath path){ m_renderPath = path; }
+    RenderPath GetRenderPath() const { return m_renderPath; }
+    // GPU time of the most recent frame we have a result for (milliseconds)
+    double GetGPUFrameTime() const { return m_gpuFrameTime; }
+    // Adds a point light to the scene, returns its index
+    unsigned int AddPointLight(const PointLightData& light);
+    // Every light in the scene. The first two follow the camera.
+    std::vector<PointLightData>& GetPointLights(){ return m_pointLights; }
+    // The sun's and point lights' shadow maps. Shaders built with
+    // ShaderFeatures::shadows sample them.
+    ShadowMaps& GetShadowMaps(){ return m_shadowMaps; }
     // Returns the camera at an index
     Camera*& GetCamera(unsigned int index){
         if(index > m_cameras.size()-1){
@@ -60,8 +82,31 @@ protected:
     glm::mat4 m_projectionMatrix;
     // A renderer can have any number of framebuffers
     std::vector<Framebuffer*> m_framebuffers;
+    // Camera and light data shared by every shader, written once per frame
+    UniformBuffer m_frameDataBuffer;
+    UniformBuffer m_lightDataBuffer;
+    // Every point light in the scene
+    std::vector<PointLightData> m_pointLights;
+    // Sorts our lights into clusters for shaders using CLUSTERED_LIGHTING
+    ClusteredLighting m_clusteredLighting;
+    // Drawn before the scene every frame
+    ShadowMaps m_shadowMaps;
+    // Which path Render takes
+    RenderPath m_renderPath{RenderPath::Forward};
+    // Deferred path: our G-buffer and the full screen lighting shader
+    GBuffer m_gbuffer;
+    std::shared_ptr<Shader> m_deferredShader;
+    UniformHandle m_uInverseViewProjection;
+    glm::mat4 m_viewProjection;
+    // Two timer queries, so we read last frame's while this one runs
+    GLuint m_timerQueries[2]{0,0};
+    unsigned int m_frameCount{0};
+    double m_gpuFrameTime{0.0};
 
 private:
+    // Draws the scene into our framebuffer for each path
+    void RenderForward();
+    void RenderDeferred();
     // Screen dimension constants
     int m_screenWidth;
     int m_screenHeight;
@@ -18,17 +18,35 @@
 #include "Transform.hpp"
 #include "Camera.hpp"
 #include "Shader.hpp"
+#include "ShaderPreprocessor.hpp"
 
 #include "glm/vec3.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+// Which pass the scene is being drawn for
+enum class RenderPass{
+    Forward = 0,    // Shade and light each object as it is drawn
+    GBuffer,        // Only write the surface into the G-buffer (deferred)
+    Shadow,         // Only write depth into a shadow map
+    Count
+};
+
+// How a node takes part in the shadow maps
+enum class ShadowCaster{
+    None,       // Casts no shadows
+    Static,     // Never moves, drawn once into the cached shadow maps
+    Dynamic     // Drawn into the shadow maps every frame
+};
+
 class SceneNode{
 public:
     // A SceneNode is created by taking
     // a pointer to an object.
-    // For now, we also specify the shader paths as well (TODO: Implement a shader manager here
-    //                                                          instead for a cleaner code..
-    SceneNode(std::shared_ptr<Object> ob, std::string vertShader, std::string fragShader);
+    // We also specify the shader paths, the program itself comes from
+    // the ShaderManager and is shared with other nodes using the same files.
+    // The features pick which permutation of the shader is compiled.
+    SceneNode(std::shared_ptr<Object> ob, std::string vertShader, std::string fragShader,
+              const ShaderFeatures& features = ShaderFeatures());
     // Our destructor takes care of destroying
     // all of the children within the node.
     // Now we do not have to manage deleting
@@ -36,17 +54,25 @@ public:
     ~SceneNode();
     // Adds a child node to our current node.
     void AddChild(SceneNode* n);
-    // Draws the current SceneNode
-    void Draw();
+    // Draws the current SceneNode (and children) for a render pass
+    void Draw(RenderPass pass = RenderPass::Forward);
+    // Draws only the nodes casting one kind of shadow, for a shadow map
+    void DrawShadowCasters(ShadowCaster casters);
+    // Nodes are static casters by default. A static caster that is
+    // moved anyway needs the Renderer's shadow cache invalidated.
+    void SetShadowCaster(ShadowCaster caster){ m_shadowCaster = caster; }
+    ShadowCaster GetShadowCaster() const { return m_shadowCaster; }
     // Updates the current SceneNode
+    // Camera and light uniforms are shared by every node and
+    // are written once per frame by the Renderer.
     void Update(glm::mat4 projectionMatrix, Camera* camera);
     // Returns the local transformation transform
     // Remember that local is local to an object, where it's center is the origin.
     Transform& GetLocalTransform();
     // Returns a SceneNode's world transform
     Transform& GetWorldTransform();
-    // For now we have one shader per Node.
-    std::shared_ptr<Shader> m_shader; 
+    // The (possibly shared) shader for a pass, requested on first use
+    std::shared_ptr<Shader>& GetShader(RenderPass pass);
     
     // NOTE: Protected members are accessible by anything
     // that we inherit from, as well as ?
@@ -60,6 +86,26 @@ private:
     std::vector<SceneNode*> m_children;
     // The object stored in the scene graph
     std::shared_ptr<Object> m_object;
+    // The shader used for one render pass, and the handles to the
+    // uniforms we set every frame, looked up once the shader is ready.
+    // (The camera and lights come from the renderer's uniform buffers)
+    struct PassShader{
+        std::shared_ptr<Shader> shader;
+        ShaderFeatures features;
+        UniformHandle model;
+        bool uniformsFound{false};
+    };
+    // Finds the handles of a pass, done once its shader is ready
+    void FindUniforms(PassShader& pass);
+    // Draws only our own object for a pass
+    void DrawObject(RenderPass pass);
+    // Where our shaders come from
+    std::string m_vertShader;
+    std::string m_fragShader;
+    // One shader per pass
+    PassShader m_passes[(int)RenderPass::Count];
+    // Which shadow maps we are drawn into
+    ShadowCaster m_shadowCaster{ShadowCaster::Static};
     // Each SceneNode nodes locals transform.
     Transform m_localTransform;
     // We additionally can store the world transform
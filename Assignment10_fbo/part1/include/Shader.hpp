@@ -10,6 +10,10 @@
 #define SHADER_HPP
 
 #include <string>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 
 #if defined(LINUX) || defined(MINGW)
     #include <SDL2/SDL.h>
@@ -19,40 +23,121 @@
 
 #include <glad/glad.h>
 
+// A handle to an active uniform that was found when the shader
+// was linked. Setting a uniform through a handle does not need
+// any string lookups.
+struct UniformHandle{
+    int index{-1};
+    bool IsValid() const { return index >= 0; }
+};
+
 class Shader{
 public:
     // Shader constructor
     Shader();
     // Shader Destructor
     ~Shader();
+    // A shader owns an OpenGL program, so it cannot be copied.
+    // Share it through the ShaderManager instead.
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     // Use this shader in our pipeline.
-    void Bind() const;
+    // Nothing is sent to OpenGL if this shader is already in use.
+    // The first Bind finishes creating the program if needed.
+    void Bind();
     // Remove shader from our pipeline
     void Unbind() const;
-    // Load a shader
-    std::string LoadShader(const std::string& fname);
+    // Number of glUseProgram calls Bind has actually made
+    static unsigned int GetProgramSwitchCount();
+    static void ResetStats();
+    // Load a shader (safe to call from any thread)
+    static std::string LoadShader(const std::string& fname);
     // Create a Shader from a loaded vertex and fragment shader
     void CreateShader(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+    // Starts compiling and linking, but does not wait for the driver.
+    // If sourceHash is not 0 the linked program is added to the
+    // program binary cache under that hash once it is finished.
+    void BeginCreateShader(const std::string& vertexShaderSource, const std::string& fragmentShaderSource, uint64_t sourceHash = 0);
+    // Waits for a started program, checks for errors and finds its uniforms
+    void FinishCreateShader();
+    // True once the program can be used without waiting on the driver.
+    // Without KHR_parallel_shader_compile we cannot ask the driver,
+    // so any started program counts as ready.
+    bool IsReady() const;
+    // Create a Shader from the program binary cache.
+    // Returns false (and creates nothing) if there is no usable binary.
+    bool CreateShaderFromCache(uint64_t sourceHash);
     // return the shader id
     GLuint GetID() const;
+    // Returns a handle to a uniform. Finishes the program if needed.
+    // Unknown names are reported once
+    // and an invalid handle is returned (setting it does nothing).
+    UniformHandle GetUniformHandle(const std::string& name);
+    // Returns the GL type of a uniform (e.g. GL_FLOAT_MAT4) or 0
+    GLenum GetUniformType(UniformHandle handle) const;
+    // Number of active uniforms found when linking
+    unsigned int GetUniformCount() const;
     // Set our uniforms for our shader.
+    // The name versions look the name up in our table first,
+    // prefer the handle versions for anything set every frame.
     void SetUniformMatrix4fv(const GLchar* name, const GLfloat* value);
 	void SetUniform3f(const GLchar* name, float v0, float v1, float v2);
     void SetUniform1i(const GLchar* name, int value);
     void SetUniform1f(const GLchar* name, float value);
+    void SetUniformMatrix4fv(UniformHandle handle, const GLfloat* value);
+    void SetUniform3f(UniformHandle handle, float v0, float v1, float v2);
+    void SetUniform1i(UniformHandle handle, int value);
+    void SetUniform1f(UniformHandle handle, float value);
 
 private:
-    // Compiles loaded shaders
-    unsigned int CompileShader(unsigned int type, const std::string& source);
+    // The ShaderManager queues shaders and submits them in batches
+    friend class ShaderManager;
+    // Where we are in the process of creating our program
+    enum class State{
+        Empty,      // Nothing created yet
+        Queued,     // Waiting in the ShaderManager to be submitted
+        Compiling,  // Handed to the driver, result not checked yet
+        Ready,      // Linked and reflected
+        Failed      // The source could not be built, there is no program
+    };
+    // Gets the program to the Ready state, waiting if needed
+    void EnsureReady();
+    // Starts compiling a shader without checking the result
+    unsigned int StartCompileShader(unsigned int type, const std::string& source);
+    // Prints the log of a shader that failed to compile
+    bool CheckCompileStatus(unsigned int type, unsigned int id);
     // Makes sure shaders 'linked' successfully
     bool CheckLinkStatus(GLuint programID);
     // Shader loading utility programs
     void PrintProgramLog( GLuint program );
     void PrintShaderLog( GLuint shader );
     // Logs an error message 
-    void Log(const char* system, const char* message);
+    static void Log(const char* system, const char* message);
+    // Builds our table of uniforms from the linked program
+    void ReflectUniforms();
     // The unique shaderID
-    GLuint m_shaderID;
+    GLuint m_shaderID{0};
+    State m_state{State::Empty};
+    // Stages kept around until the link result has been checked
+    GLuint m_vertexShaderID{0};
+    GLuint m_fragmentShaderID{0};
+    // Key for the program binary cache (0 if not cached)
+    uint64_t m_sourceHash{0};
+    // The program that is currently in use, shared by all shaders
+    static GLuint s_boundProgram;
+    static unsigned int s_programSwitches;
+    // Everything we know about an active uniform
+    struct UniformInfo{
+        std::string name;
+        GLint location;
+        GLenum type;
+    };
+    // Every active uniform (array elements get their own entry)
+    std::vector<UniformInfo> m_uniforms;
+    // Uniform name -> index into m_uniforms
+    std::unordered_map<std::string,int> m_uniformLookup;
+    // Unknown uniform names we have already warned about
+    std::unordered_set<std::string> m_reportedUniforms;
 };
 
 #endif
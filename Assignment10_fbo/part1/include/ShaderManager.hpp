@@ -2,8 +2,23 @@
  *  @brief This Singleton class manages all of the shaders that have been created
  *
  *  The shader manager handles all of the shaders that have been loaded.
- *  
+ *  Shaders are keyed by a hash of their file paths and defines, so
+ *  asking for the same vertex/fragment pair twice returns the same
+ *  program rather than compiling and linking another copy. The key is
+ *  looked up before anything is read, so a hit never touches the disk.
+ *  (The binary cache is keyed on the preprocessed source instead.) This also
+ *  makes the manager our permutation cache: every distinct set of
+ *  ShaderFeatures is compiled once and shared by all objects using it.
  *
+ *  Shaders are created in batches. RequestShader returns straight away
+ *  and reads the files on a worker thread. The renderer hands every
+ *  queued shader to the driver at the start of a frame (as does the
+ *  first Bind of a queued shader). With KHR_parallel_shader_compile the
+ *  driver compiles them all at once, and scene nodes skip drawing until
+ *  Shader::IsReady says their program can be used without waiting.
+ *
+ *  The manager only keeps weak references. A program is deleted once
+ *  the last std::shared_ptr handed out for it goes away.
  *
  *  @author Mike
  *  @bug No known bugs.
@@ -13,17 +28,84 @@
 
 #include <unordered_map>
 #include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdint>
 
 #include "Shader.hpp"
+#include "ShaderPreprocessor.hpp"
 
 class ShaderManager{
 public:
-      
+    // Singleton pattern for having one single ShaderManager
+    // class at any given time.
+    static ShaderManager& Instance();
+    // Returns a shader built from the vertex and fragment shader files.
+    // Both files go through the ShaderPreprocessor, so #include works and
+    // each entry in defines is injected as '#define <entry>' right
+    // after the #version line. Identical requests share one program.
+    // The shader is queued, it is created when first bound (or used).
+    std::shared_ptr<Shader> RequestShader(const std::string& vertPath,
+                                          const std::string& fragPath,
+                                          const std::vector<std::string>& defines = {});
+    // Requests the permutation of a shader with the given features
+    std::shared_ptr<Shader> RequestShader(const std::string& vertPath,
+                                          const std::string& fragPath,
+                                          const ShaderFeatures& features);
+    // Same as RequestShader, but the shader is ready when this returns
+    std::shared_ptr<Shader> GetShader(const std::string& vertPath,
+                                      const std::string& fragPath,
+                                      const std::vector<std::string>& defines = {});
+    // Hands every queued shader to the driver without waiting for results
+    void SubmitPending();
+    // True if the driver supports KHR_parallel_shader_compile
+    bool HasParallelCompile() const { return m_parallelCompile; }
+    // Forgets entries whose programs have already been deleted
+    void Purge();
+    // Number of programs currently alive
+    unsigned int GetProgramCount() const;
+    // Requests that were served by an existing program
+    unsigned int GetHitCount() const { return m_hits; }
+    // Requests that had to create a new program
+    unsigned int GetMissCount() const { return m_misses; }
+
 private:
     // ShaderManager Constructor
     ShaderManager() {}
     // ShaderManager Destructor
     ~ShaderManager() {}
+    // The output of reading (and preprocessing) a program's files
+    struct ShaderSources{
+        std::string vertex;
+        std::string fragment;
+        uint64_t hash;
+        // False if either file failed to preprocess
+        bool valid;
+    };
+    // A shader waiting for its files to be read
+    struct PendingShader{
+        std::shared_ptr<Shader> shader;
+        // Our key in m_shaders
+        uint64_t key;
+        std::future<ShaderSources> sources;
+    };
+    // Runs on a worker thread
+    static ShaderSources Preprocess(std::string vertPath, std::string fragPath, std::vector<std::string> defines);
+    // Hashes the strings that make up a program
+    static uint64_t HashProgram(const std::string& vertex,
+                                const std::string& fragment,
+                                const std::vector<std::string>& defines);
+    // Looks for KHR_parallel_shader_compile. Needs a GL context.
+    void InitializeParallelCompile();
+    // hash of paths and defines -> program. Weak so that unused programs are released.
+    std::unordered_map<uint64_t, std::weak_ptr<Shader>> m_shaders;
+    // Requested, but not yet handed to the driver
+    std::vector<PendingShader> m_pending;
+    bool m_parallelInitialized{false};
+    bool m_parallelCompile{false};
+    unsigned int m_hits{0};
+    unsigned int m_misses{0};
 };
 
 #endif
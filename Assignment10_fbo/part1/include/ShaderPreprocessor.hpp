@@ -0,0 +1,60 @@
+/** @file ShaderPreprocessor.hpp
+ *  @brief Expands #include and injects #defines into GLSL source.
+ *
+ *  GLSL has no #include, so shared code (like our lighting) is pulled
+ *  in here before the source reaches the driver. Features such as the
+ *  number of lights are passed in as #defines, which lets the driver
+ *  compile a specialized 'permutation' of a shader with constant loop
+ *  bounds and unused branches removed entirely.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef SHADERPREPROCESSOR_HPP
+#define SHADERPREPROCESSOR_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+// The compile time features a shader permutation is built with.
+// Two objects with the same features share the same program.
+struct ShaderFeatures{
+    // Number of point lights the fragment shader loops over
+    // (at most MAX_POINT_LIGHTS)
+    int lightCount{1};
+    // Perturb normals with a tangent space normal map (texture slot 2)
+    bool normalMap{false};
+    // Blend in a detail map (texture slot 1)
+    bool detailMap{false};
+    // Shade every light in the scene through the light clusters
+    // (texture slots 3-5) instead of the LightData block
+    bool clustered{false};
+    // Write albedo and normals into the G-buffer instead of lighting
+    bool gbuffer{false};
+    // Only write depth, for a shadow map
+    bool shadowPass{false};
+    // Light with the sun and darken with the shadow maps (texture slots 6-8)
+    bool shadows{false};
+    // Returns the #defines for this permutation
+    std::vector<std::string> GetDefines() const;
+};
+
+class ShaderPreprocessor{
+public:
+    // Reads a shader file, expands every #include "file" and inserts the
+    // defines right after #version. Included paths are relative to the
+    // file doing the including, and each file is only included once.
+    // Safe to call from any thread.
+    // Returns false if a file could not be read or an include is bad,
+    // in which case 'output' is incomplete and must not be compiled.
+    static bool Process(const std::string& path, const std::vector<std::string>& defines, std::string& output);
+private:
+    // Appends a file (and everything it includes) to output
+    static bool Expand(const std::string& path, std::unordered_set<std::string>& included,
+                       std::string& output, int depth);
+    // Inserts '#define's after the #version line of a shader
+    static std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines);
+};
+
+#endif
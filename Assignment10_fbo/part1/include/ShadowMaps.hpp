@@ -0,0 +1,111 @@
+/** @file ShadowMaps.hpp
+ *  @brief Shadow maps for the sun and a few point lights.
+ *
+ *  The sun casts shadows through cascades. The camera's view is cut into
+ *  SHADOW_CASCADES depth ranges, each covered by its own orthographic
+ *  shadow map (one layer of a depth array). Point lights picked with
+ *  SetPointLight get a depth cube map each.
+ *
+ *  Every map has a second copy (the cache) holding only the static
+ *  casters. A layer of the cache is only redrawn when the light's matrix
+ *  for that layer changes, or after Invalidate. Each frame the cache is
+ *  copied into the map we sample and just the dynamic casters are drawn
+ *  on top, so the cost follows what moves rather than the whole scene.
+ *
+ *  So that the cascades do not change every time the camera moves, each
+ *  one is a little larger than its slice of the view, and its center
+ *  snaps to a grid an eighth of its width. Its cache is then redrawn
+ *  only after the camera has moved that far.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef SHADOWMAPS_HPP
+#define SHADOWMAPS_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Framebuffer.hpp"
+#include "UniformBuffer.hpp"
+
+class SceneNode;
+
+// Texture slots the shaders read the shadow maps from
+const unsigned int SHADOW_CASCADE_SLOT = 6;
+// One slot for each of the MAX_SHADOWED_POINT_LIGHTS cube maps
+const unsigned int SHADOW_POINT_SLOT   = 7;
+// Near plane of the cube maps, must match shadow.glsl
+const float SHADOW_POINT_NEAR = 0.5f;
+
+class ShadowMaps{
+public:
+    // Constructor
+    ShadowMaps();
+    // Destructor
+    ~ShadowMaps();
+    // Creates the maps and their caches. Each cascade is cascadeSize
+    // texels wide (a multiple of 8), each cube face cubeSize.
+    // Returns false if any framebuffer is incomplete.
+    bool Create(int cascadeSize, int cubeSize);
+    // 'direction' points towards the sun
+    void SetSun(const glm::vec3& direction, const glm::vec3& color);
+    // How far from the camera the cascades reach
+    void SetShadowDistance(float distance){ m_shadowDistance = distance; }
+    // Gives the light at 'lightIndex' the cube map in 'slot'.
+    // A lightIndex of -1 turns the slot off.
+    void SetPointLight(unsigned int slot, int lightIndex);
+    // Redraws every cache next frame, e.g. after a static caster moved
+    void Invalidate();
+    // Fits the cascades to the camera and the cube maps to their
+    // lights, then uploads the ShadowData and ShadowPass blocks.
+    void Update(const glm::mat4& view, const glm::mat4& projection,
+                const std::vector<PointLightData>& lights);
+    // Draws the shadow casters below 'root' into every map
+    void Render(SceneNode* root);
+    // Binds the maps to their texture slots
+    void BindTextures() const;
+    // Statistics from the last Render
+    unsigned int GetLayersDrawn() const { return m_layersDrawn; }
+    unsigned int GetStaticLayersDrawn() const { return m_staticLayersDrawn; }
+
+private:
+    // A shadow map, the cache of its static casters, and for
+    // each layer the matrix of this frame and of the cache.
+    struct CachedMap{
+        Framebuffer map;
+        Framebuffer cache;
+        std::vector<glm::mat4> matrices;
+        std::vector<glm::mat4> cachedMatrices;
+        std::vector<bool> cacheValid;
+        // Where layer 0's matrix is in the ShadowPass buffer
+        unsigned int firstPass{0};
+        bool active{false};
+    };
+    // Sets up the per layer arrays of a map
+    static void InitializeLayers(CachedMap& map, unsigned int layers, unsigned int firstPass);
+    // Fits each cascade around its slice of the view
+    void FitCascades(const glm::mat4& view, const glm::mat4& projection, ShadowData& data);
+    // Draws every layer of one map
+    void RenderMap(CachedMap& map, SceneNode* root);
+
+    CachedMap m_cascades;
+    CachedMap m_pointMaps[MAX_SHADOWED_POINT_LIGHTS];
+    int m_pointLightIndex[MAX_SHADOWED_POINT_LIGHTS];
+    glm::vec3 m_sunDirection{0.0f,1.0f,0.0f};
+    glm::vec3 m_sunColor{0.0f,0.0f,0.0f};
+    float m_shadowDistance{256.0f};
+    // The ShadowData block and every layer's ShadowPass block,
+    // m_passStride bytes apart so each can be bound on its own.
+    UniformBuffer m_shadowDataBuffer;
+    UniformBuffer m_passBuffer;
+    GLsizeiptr m_passStride{0};
+    std::vector<unsigned char> m_passData;
+    unsigned int m_layersDrawn{0};
+    unsigned int m_staticLayersDrawn{0};
+};
+
+#endif
@@ -0,0 +1,134 @@
+/** @file UniformBuffer.hpp
+ *  @brief A buffer of uniforms shared by every shader.
+ *
+ *  Values that are the same for the whole frame (the camera and the
+ *  lights) are written once per frame into a uniform buffer object
+ *  bound to a fixed binding point. Any shader that declares a matching
+ *  uniform block reads from it, so nothing needs to be set per object.
+ *
+ *  The structs below mirror the std140 blocks in our shaders and must
+ *  be kept in sync with them.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef UNIFORMBUFFER_HPP
+#define UNIFORMBUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <string>
+
+#include "glm/glm.hpp"
+
+// The fixed binding point of every uniform block we know about
+enum class UniformBlockBinding : GLuint{
+    FrameData  = 0,
+    LightData  = 1,
+    ShadowData = 2,
+    ShadowPass = 3
+};
+
+// Returns the binding point for a block name, or -1 if
+// the block is not one of ours.
+int GetUniformBlockBinding(const std::string& blockName);
+
+// Number of point lights in the LightData block
+const int MAX_POINT_LIGHTS = 2;
+
+// layout(std140) uniform FrameData
+struct FrameData{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    // xyz used, w is padding
+    glm::vec4 cameraPosition;
+    // Clustered lighting: x slice scale, y slice bias, zw tile size in pixels
+    glm::vec4 clusterScaleBias;
+    // Clustered lighting: number of clusters in x, y, z
+    glm::ivec4 clusterGridSize;
+};
+static_assert(sizeof(FrameData)==240, "FrameData does not match std140 layout");
+
+// One PointLight in the LightData block. The floats are placed
+// after each vec3 to fill the space std140 leaves there.
+struct PointLightData{
+    glm::vec3 lightColor;
+    float ambientIntensity;
+    glm::vec3 lightPos;
+    float specularStrength;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding;
+};
+static_assert(sizeof(PointLightData)==48, "PointLightData does not match std140 layout");
+
+// layout(std140) uniform LightData
+struct LightData{
+    PointLightData pointLights[MAX_POINT_LIGHTS];
+    int lightCount;
+    int padding[3];
+};
+static_assert(sizeof(LightData)==MAX_POINT_LIGHTS*48+16, "LightData does not match std140 layout");
+
+// Must match SHADOW_CASCADES and MAX_SHADOWED_POINT_LIGHTS in shadow.glsl
+const int SHADOW_CASCADES = 4;
+const int MAX_SHADOWED_POINT_LIGHTS = 2;
+
+// layout(std140) uniform ShadowData
+struct ShadowData{
+    // World space to the shadow map of each cascade
+    glm::mat4 cascadeViewProjection[SHADOW_CASCADES];
+    // View space depth where each cascade ends
+    glm::vec4 cascadeSplits;
+    // World space width of one texel in each cascade
+    glm::vec4 cascadeTexelSize;
+    // xyz points towards the sun
+    glm::vec4 sunDirection;
+    // rgb, a unused
+    glm::vec4 sunColor;
+    // xyz light position, w far plane of its cube map
+    glm::vec4 pointShadowPositionFar[MAX_SHADOWED_POINT_LIGHTS];
+    // Index of the light each cube map belongs to, -1 if unused
+    glm::ivec4 pointShadowLight;
+};
+static_assert(sizeof(ShadowData)==368, "ShadowData does not match std140 layout");
+
+// layout(std140) uniform ShadowPass
+// The light's matrix while a layer of a shadow map is drawn
+struct ShadowPassData{
+    glm::mat4 viewProjection;
+};
+static_assert(sizeof(ShadowPassData)==64, "ShadowPassData does not match std140 layout");
+
+class UniformBuffer{
+public:
+    // Constructor
+    UniformBuffer();
+    // Destructor
+    ~UniformBuffer();
+    // A uniform buffer owns an OpenGL buffer, so it cannot be copied
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    // Creates a buffer of 'size' bytes attached to a binding point
+    void Create(GLsizeiptr size, UniformBlockBinding binding);
+    // Replaces the contents of the buffer
+    void Update(const void* data, GLsizeiptr size);
+    // Attaches only part of the buffer to our binding point, so one
+    // buffer can hold a block for each of several draws.
+    // 'offset' must be a multiple of GetOffsetAlignment().
+    void BindRange(GLintptr offset, GLsizeiptr size);
+    // Smallest step between ranges given to BindRange. Needs a GL context.
+    static GLint GetOffsetAlignment();
+    // Deletes the buffer
+    void Destroy();
+    // Returns the buffer id
+    GLuint GetID() const { return m_id; }
+private:
+    GLuint m_id{0};
+    GLsizeiptr m_size{0};
+    GLuint m_binding{0};
+};
+
+#endif
@@ -0,0 +1,53 @@
+// ==================================================================
+// Clustered lighting, pulled in with #include "clustered.glsl"
+// Needs frame.glsl and lighting.glsl to be included first,
+// and shadow.glsl too when USE_SHADOWS is defined.
+
+// Three texels per light:
+//   0: position, radius
+//   1: color, ambientIntensity
+//   2: constant, linear, quadratic, specularStrength
+uniform samplerBuffer u_ClusterLights;
+// (offset, count) into u_ClusterIndices for each cluster
+uniform usamplerBuffer u_ClusterGrid;
+// The light indices for every cluster, one after the other
+uniform usamplerBuffer u_ClusterIndices;
+
+// Finds the cluster this fragment is in
+int FindCluster(vec3 fragPos){
+    float depth = -(view * vec4(fragPos,1.0)).z;
+    int slice = int(floor(log(max(depth,1e-4)) * clusterScaleBias.x + clusterScaleBias.y));
+    slice = clamp(slice, 0, clusterGridSize.z-1);
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterScaleBias.zw);
+    tile = clamp(tile, ivec2(0), clusterGridSize.xy-1);
+    return (slice*clusterGridSize.y + tile.y)*clusterGridSize.x + tile.x;
+}
+
+// Shades only the lights that were assigned to our cluster
+vec3 CalculateClusteredLighting(vec3 norm, vec3 fragPos, vec3 viewPos){
+    uvec2 range = texelFetch(u_ClusterGrid, FindCluster(fragPos)).xy;
+    vec3 result = vec3(0.0);
+    for(uint i=0u; i < range.y; i++){
+        int lightIndex = int(texelFetch(u_ClusterIndices, int(range.x + i)).r);
+        int index = lightIndex * 3;
+        vec4 positionRadius = texelFetch(u_ClusterLights, index+0);
+        vec4 colorAmbient   = texelFetch(u_ClusterLights, index+1);
+        vec4 attenuation    = texelFetch(u_ClusterLights, index+2);
+
+        PointLight light;
+        light.lightPos         = positionRadius.xyz;
+        light.lightColor       = colorAmbient.rgb;
+        light.ambientIntensity = colorAmbient.a;
+        light.constant         = attenuation.x;
+        light.linear           = attenuation.y;
+        light.quadratic        = attenuation.z;
+        light.specularStrength = attenuation.w;
+#ifdef USE_SHADOWS
+        result += CalculatePointLight(light, norm, fragPos, viewPos) * PointLightShadow(lightIndex, fragPos);
+#else
+        result += CalculatePointLight(light, norm, fragPos, viewPos);
+#endif
+    }
+    return result;
+}
+// ==================================================================
@@ -0,0 +1,53 @@
+// ==================================================================
+#version 330 core
+
+// Deferred lighting pass. Drawn as a full screen quad, every pixel
+// reads its surface back from the G-buffer and is lit through the
+// light clusters, exactly like the forward CLUSTERED_LIGHTING path.
+// With USE_SHADOWS the sun and the shadow maps are applied as well.
+
+// The final output color of each 'fragment' from our fragment shader.
+out vec4 FragColor;
+
+#include "frame.glsl"
+#include "lighting.glsl"
+#ifdef USE_SHADOWS
+#include "shadow.glsl"
+#endif
+#include "clustered.glsl"
+#include "octahedral.glsl"
+
+// Our G-buffer
+uniform sampler2D u_GAlbedo;
+uniform sampler2D u_GNormal;
+uniform sampler2D u_GDepth;
+// Takes a point from normalized device coordinates back to the world
+uniform mat4 u_InverseViewProjection;
+
+// Import our texture coordinates from vertex shader
+in vec2 v_texCoord;
+
+void main()
+{
+    float depth = texture(u_GDepth, v_texCoord).r;
+    // Nothing was drawn here, leave the clear color
+    if(depth >= 1.0){
+        discard;
+    }
+    // Rebuild the world position from depth
+    vec4 ndc = vec4(v_texCoord*2.0 - 1.0, depth*2.0 - 1.0, 1.0);
+    vec4 world = u_InverseViewProjection * ndc;
+    vec3 FragPos = world.xyz / world.w;
+
+    vec3 norm = OctahedralDecode(texture(u_GNormal, v_texCoord).xy);
+    vec3 diffuseColor = texture(u_GAlbedo, v_texCoord).rgb;
+
+	vec3 viewPos = vec3(0.0,0.0,0.0);
+    vec3 Lighting = CalculateClusteredLighting(norm, FragPos, viewPos);
+#ifdef USE_SHADOWS
+    Lighting += CalculateSunLight(norm, FragPos);
+#endif
+
+    FragColor = vec4(diffuseColor * Lighting,1.0);
+}
+// ==================================================================
@@ -1,34 +1,44 @@
 // ==================================================================
 #version 330 core
 
+#ifdef SHADOW_PASS
+// Shadow maps only store depth, which needs no fragment work
+void main()
+{
+}
+#else
+
+#ifdef GBUFFER_PASS
+// Deferred geometry pass, we only store the surface.
+// Lighting happens later in deferredFrag.glsl
+layout(location=0) out vec4 gAlbedo;
+layout(location=1) out vec2 gNormal;
+#include "octahedral.glsl"
+#else
 // The final output color of each 'fragment' from our fragment shader.
 out vec4 FragColor;
-
-// Our light source data structure
-struct PointLight{
-    vec3 lightColor;
-    vec3 lightPos;
-    float ambientIntensity;
-
-    float specularStrength;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-uniform PointLight pointLights[2];
-
-// Used for our specular highlights
-uniform mat4 view;
-
+#endif
+
+// PointLight, the LightData block and CalculatePointLight
+#include "lighting.glsl"
+#if defined(CLUSTERED_LIGHTING) || defined(USE_SHADOWS)
+#include "frame.glsl"
+#endif
+#ifdef USE_SHADOWS
+// The sun and our shadow maps
+#include "shadow.glsl"
+#endif
+#ifdef CLUSTERED_LIGHTING
+// Every light in the scene, sorted into clusters
+#include "clustered.glsl"
+#endif
 
 // Import our normal data
 in vec3 myNormal;
+#ifdef USE_NORMAL_MAP
+// Tangent space to world space, from the vertex shader
+in mat3 TBN;
+#endif
 // Import our texture coordinates from vertex shader
 in vec2 v_texCoord;
 // Import the fragment position
@@ -36,57 +46,57 @@ in vec3 FragPos;
 
 // If we have texture coordinates, they are stored in this sampler.
 uniform sampler2D u_DiffuseMap; 
+#ifdef USE_DETAIL_MAP
 // Load in an additional detail map
-//uniform sampler2D u_DetailMap; 
+uniform sampler2D u_DetailMap; 
+#endif
+#ifdef USE_NORMAL_MAP
+// Tangent space normals
+uniform sampler2D u_NormalMap;
+#endif
 
 void main()
 {
     // Compute the normal direction
+#ifdef USE_NORMAL_MAP
+    vec3 norm = normalize(TBN * (texture(u_NormalMap, v_texCoord).rgb * 2.0 - 1.0));
+#else
     vec3 norm = normalize(myNormal);
+#endif
     
     // Store our final texture color
     vec3 diffuseColor   = texture(u_DiffuseMap, v_texCoord).rgb;
-//    vec3 detailColor    = texture(u_DetailMap,  v_texCoord).rgb;
-
+#ifdef USE_DETAIL_MAP
+    vec3 detailColor    = texture(u_DetailMap,  v_texCoord).rgb;
+    // Detail maps are centered on 0.5, so they brighten and darken equally
+    diffuseColor        = diffuseColor * detailColor * 2.0;
+#endif
+
+#ifdef GBUFFER_PASS
+    gAlbedo = vec4(diffuseColor, 1.0);
+    gNormal = OctahedralEncode(norm);
+#else
 	// Store our final lighting computation
 	vec3 Lighting = vec3(0.0,0.0,0.0);
 
-	// TODO: (Optional) You should refactor this into a separate function :)
-	for(int i=0; i < 1; i++){
-		// (1) Compute ambient light
-		vec3 ambient = pointLights[i].ambientIntensity * pointLights[i].lightColor;
-
-		// (2) Compute diffuse light
-		// From our lights position and the fragment, we can get
-		// a vector indicating direction
-		// Note it is always good to 'normalize' values.
-		vec3 lightDir = normalize(pointLights[i].lightPos - FragPos);
-		// Now we can compute the diffuse light impact
-		float diffImpact = max(dot(norm, lightDir), 0.0);
-		vec3 diffuseLight = diffImpact * pointLights[i].lightColor;
-
-		// (3) Compute Specular lighting
-		vec3 viewPos = vec3(0.0,0.0,0.0);
-		vec3 viewDir = normalize(viewPos - FragPos);
-		vec3 reflectDir = reflect(-lightDir, norm);
-
-		float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-		vec3 specular = pointLights[i].specularStrength * spec * pointLights[i].lightColor;
-
-		// Calculate Attenuation here
-		// distance and lighting... 
-		float distance = length(pointLights[i].lightPos - FragPos);
-		float attenuation = 1.0 / (pointLights[i].constant + pointLights[i].linear * distance + pointLights[i].quadratic * (distance*distance));
-
-		ambient 		*= attenuation;
-		diffuseLight 	*= attenuation;
-		specular 		*= attenuation;
-
-
-		// Our final color is now based on the texture.
-		// That is set by the diffuseColor
-		Lighting += diffuseLight + ambient + specular;
+	vec3 viewPos = vec3(0.0,0.0,0.0);
+#ifdef CLUSTERED_LIGHTING
+	// Only the lights that reach our cluster
+	Lighting = CalculateClusteredLighting(norm, FragPos, viewPos);
+#else
+	// LIGHT_COUNT is a constant for this permutation, so the
+	// compiler can unroll this loop completely.
+	for(int i=0; i < LIGHT_COUNT; i++){
+#ifdef USE_SHADOWS
+		Lighting += CalculatePointLight(pointLights[i], norm, FragPos, viewPos) * PointLightShadow(i, FragPos);
+#else
+		Lighting += CalculatePointLight(pointLights[i], norm, FragPos, viewPos);
+#endif
 	}
+#endif
+#ifdef USE_SHADOWS
+	Lighting += CalculateSunLight(norm, FragPos);
+#endif
 
     // Final color + "how dark or light to make fragment"
     if(gl_FrontFacing){
@@ -95,5 +105,7 @@ void main()
         // Additionally color the back side the same color
          FragColor = vec4(diffuseColor * Lighting,1.0);
     }
+#endif
 }
+#endif // SHADOW_PASS
 
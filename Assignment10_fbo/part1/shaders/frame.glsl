@@ -0,0 +1,16 @@
+// ==================================================================
+// Camera data, pulled in with #include "frame.glsl"
+
+// Written once per frame by the renderer.
+// Must match 'FrameData' in UniformBuffer.hpp
+layout(std140) uniform FrameData{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    // x slice scale, y slice bias, zw tile size in pixels
+    vec4 clusterScaleBias;
+    // number of clusters in x, y, z
+    ivec4 clusterGridSize;
+};
+// ==================================================================
@@ -0,0 +1,61 @@
+// ==================================================================
+// Shared lighting code, pulled in with #include "lighting.glsl"
+
+// Must match MAX_POINT_LIGHTS in UniformBuffer.hpp
+#define MAX_POINT_LIGHTS 2
+
+// How many lights this permutation actually uses.
+// This is a compile time constant so the loop can be unrolled.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
+// Our light source data structure
+// (the floats fill the gaps std140 leaves after each vec3)
+struct PointLight{
+    vec3 lightColor;
+    float ambientIntensity;
+    vec3 lightPos;
+    float specularStrength;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// Light data, written once per frame by the renderer.
+// Must match 'LightData' in UniformBuffer.hpp
+layout(std140) uniform LightData{
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    int lightCount;
+};
+
+// Computes the ambient, diffuse and specular contribution of one light
+vec3 CalculatePointLight(PointLight light, vec3 norm, vec3 fragPos, vec3 viewPos){
+    // (1) Compute ambient light
+    vec3 ambient = light.ambientIntensity * light.lightColor;
+
+    // (2) Compute diffuse light
+    // From our lights position and the fragment, we can get
+    // a vector indicating direction
+    // Note it is always good to 'normalize' values.
+    vec3 lightDir = normalize(light.lightPos - fragPos);
+    // Now we can compute the diffuse light impact
+    float diffImpact = max(dot(norm, lightDir), 0.0);
+    vec3 diffuseLight = diffImpact * light.lightColor;
+
+    // (3) Compute Specular lighting
+    vec3 viewDir = normalize(viewPos - fragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = light.specularStrength * spec * light.lightColor;
+
+    // Calculate Attenuation here
+    // distance and lighting... 
+    float distance = length(light.lightPos - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance*distance));
+
+    return (ambient + diffuseLight + specular) * attenuation;
+}
+// ==================================================================
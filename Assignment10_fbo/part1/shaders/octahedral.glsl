@@ -0,0 +1,22 @@
+// ==================================================================
+// Octahedral normal encoding, pulled in with #include "octahedral.glsl"
+// A unit normal is folded onto an octahedron and flattened to two
+// values in [-1,1], so the G-buffer only needs two channels for it.
+
+vec2 OctahedralWrap(vec2 v){
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 OctahedralEncode(vec3 n){
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    return n.z >= 0.0 ? n.xy : OctahedralWrap(n.xy);
+}
+
+vec3 OctahedralDecode(vec2 e){
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+// ==================================================================
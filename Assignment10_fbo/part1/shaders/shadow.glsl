@@ -0,0 +1,86 @@
+// ==================================================================
+// Shadow maps and the sun, pulled in with #include "shadow.glsl"
+// Needs frame.glsl and lighting.glsl to be included first.
+
+// Must match SHADOW_CASCADES and MAX_SHADOWED_POINT_LIGHTS in UniformBuffer.hpp
+#define SHADOW_CASCADES 4
+#define MAX_SHADOWED_POINT_LIGHTS 2
+// Must match SHADOW_POINT_NEAR in ShadowMaps.hpp
+#define SHADOW_POINT_NEAR 0.5
+
+// Written once per frame by the renderer.
+// Must match 'ShadowData' in UniformBuffer.hpp
+layout(std140) uniform ShadowData{
+    mat4 cascadeViewProjection[SHADOW_CASCADES];
+    // View space depth where each cascade ends
+    vec4 cascadeSplits;
+    // World space width of one texel in each cascade
+    vec4 cascadeTexelSize;
+    // xyz points towards the sun
+    vec4 sunDirection;
+    vec4 sunColor;
+    // xyz light position, w far plane
+    vec4 pointShadowPositionFar[MAX_SHADOWED_POINT_LIGHTS];
+    // Index of the light each cube map belongs to, -1 if unused
+    ivec4 pointShadowLight;
+};
+
+// The hardware compares against the stored depth and
+// filters the result over four texels.
+uniform sampler2DArrayShadow u_CascadeShadowMap;
+uniform samplerCubeShadow u_PointShadowMap0;
+uniform samplerCubeShadow u_PointShadowMap1;
+
+// 1.0 when the sun reaches fragPos, 0.0 when it is in shadow
+float CascadeShadow(vec3 norm, vec3 fragPos){
+    float depth = -(view * vec4(fragPos,1.0)).z;
+    int cascade = 0;
+    while(cascade < SHADOW_CASCADES && depth > cascadeSplits[cascade]){
+        cascade++;
+    }
+    // Past the last cascade nothing is shadowed
+    if(cascade==SHADOW_CASCADES){
+        return 1.0;
+    }
+    // Pushing the point out along its normal keeps
+    // surfaces from shadowing themselves
+    vec3 offset = norm * (1.5 * cascadeTexelSize[cascade]);
+    vec4 position = cascadeViewProjection[cascade] * vec4(fragPos + offset, 1.0);
+    vec3 coords = position.xyz * 0.5 + 0.5;
+    return texture(u_CascadeShadowMap, vec4(coords.xy, float(cascade), coords.z));
+}
+
+// Light from the sun
+vec3 CalculateSunLight(vec3 norm, vec3 fragPos){
+    float diffImpact = max(dot(norm, sunDirection.xyz), 0.0);
+    if(diffImpact <= 0.0){
+        return vec3(0.0);
+    }
+    return sunColor.rgb * diffImpact * CascadeShadow(norm, fragPos);
+}
+
+// Looks up one cube map. Each face is a 90 degree perspective
+// view, so the depth stored is that projection's depth along
+// whichever axis the direction points along most.
+float PointShadow(samplerCubeShadow map, vec4 positionFar, vec3 fragPos){
+    vec3 direction = fragPos - positionFar.xyz;
+    vec3 absolute = abs(direction);
+    float z = max(absolute.x, max(absolute.y, absolute.z));
+    float n = SHADOW_POINT_NEAR;
+    float f = positionFar.w;
+    float ndc = (f+n)/(f-n) - (2.0*f*n)/((f-n)*z);
+    return texture(map, vec4(direction, ndc*0.5 + 0.5 - 0.0005));
+}
+
+// 1.0 when the light at 'lightIndex' reaches fragPos. Lights
+// without a cube map always do.
+float PointLightShadow(int lightIndex, vec3 fragPos){
+    if(lightIndex==pointShadowLight.x){
+        return PointShadow(u_PointShadowMap0, pointShadowPositionFar[0], fragPos);
+    }
+    if(lightIndex==pointShadowLight.y){
+        return PointShadow(u_PointShadowMap1, pointShadowPositionFar[1], fragPos);
+    }
+    return 1.0;
+}
+// ==================================================================
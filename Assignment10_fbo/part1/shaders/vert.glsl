@@ -9,14 +9,26 @@ layout(location=2)in vec2 texCoord; // Our third attribute - texture coordinates
 layout(location=3)in vec3 tangents; // Our third attribute - texture coordinates.
 layout(location=4)in vec3 bitangents; // Our third attribute - texture coordinates.
 
-// If we are applying our camera, then we need to add some uniforms.
+// The model matrix is the only uniform set for each object.
 // Note that the syntax nicely matches glm's mat4!
 uniform mat4 model; // Object space
-uniform mat4 view; // Object space
-uniform mat4 projection; // Object space
+
+// Camera data, written once per frame by the renderer.
+#include "frame.glsl"
+
+#ifdef SHADOW_PASS
+// The light's matrix for the shadow map layer being drawn
+layout(std140) uniform ShadowPass{
+    mat4 shadowViewProjection;
+};
+#endif
 
 // Export our normal data, and read it into our frag shader
 out vec3 myNormal;
+#ifdef USE_NORMAL_MAP
+// Tangent space to world space for our normal map
+out mat3 TBN;
+#endif
 // Export our Fragment Position computed in world space
 out vec3 FragPos;
 // If we have texture coordinates we can now use this as well
@@ -25,9 +37,20 @@ out vec2 v_texCoord;
 void main()
 {
 
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+#ifdef SHADOW_PASS
+    // Only depth is needed
+    gl_Position = shadowViewProjection * model * vec4(position, 1.0f);
+#else
+    gl_Position = viewProjection * model * vec4(position, 1.0f);
+#endif
 
     myNormal = normals;
+#ifdef USE_NORMAL_MAP
+    mat3 normalMatrix = mat3(model);
+    TBN = mat3(normalize(normalMatrix * tangents),
+               normalize(normalMatrix * bitangents),
+               normalize(normalMatrix * normals));
+#endif
     // Transform normal into world space
     FragPos = vec3(model* vec4(position,1.0f));
 
@@ -0,0 +1,255 @@
+#include "ClusteredLighting.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define CLUSTER_USE_SSE
+#endif
+
+// Contributions below this are treated as no light at all
+static const float LIGHT_CUTOFF = 1.0f/256.0f;
+
+ClusteredLighting::ClusteredLighting(){
+}
+
+ClusteredLighting::~ClusteredLighting(){
+    Destroy();
+}
+
+void ClusteredLighting::CreateTextureBuffer(TextureBuffer& tb, GLenum format){
+    glGenBuffers(1, &tb.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, tb.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &tb.texture);
+    glBindTexture(GL_TEXTURE_BUFFER, tb.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, tb.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::UploadTextureBuffer(const TextureBuffer& tb, const void* data, GLsizeiptr size){
+    glBindBuffer(GL_TEXTURE_BUFFER, tb.buffer);
+    // Orphan last frame's storage so we never wait on the GPU
+    glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(size,16), nullptr, GL_STREAM_DRAW);
+    if(size > 0){
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::Create(unsigned int screenWidth, unsigned int screenHeight){
+    Destroy();
+    m_screenWidth  = screenWidth;
+    m_screenHeight = screenHeight;
+    // Each light is three RGBA texels
+    CreateTextureBuffer(m_lightBuffer, GL_RGBA32F);
+    // (offset, count) per cluster
+    CreateTextureBuffer(m_gridBuffer, GL_RG32UI);
+    // Light indices, grouped by cluster
+    CreateTextureBuffer(m_indexBuffer, GL_R16UI);
+
+    m_minX.resize(CLUSTER_COUNT); m_minY.resize(CLUSTER_COUNT); m_minZ.resize(CLUSTER_COUNT);
+    m_maxX.resize(CLUSTER_COUNT); m_maxY.resize(CLUSTER_COUNT); m_maxZ.resize(CLUSTER_COUNT);
+    m_clusterCounts.resize(CLUSTER_COUNT);
+    m_clusterLights.resize(CLUSTER_COUNT*MAX_LIGHTS_PER_CLUSTER);
+    m_grid.resize(CLUSTER_COUNT*2);
+    // Force SetProjection to rebuild
+    m_projection = glm::mat4(0.0f);
+}
+
+void ClusteredLighting::Destroy(){
+    TextureBuffer* buffers[] = {&m_lightBuffer, &m_gridBuffer, &m_indexBuffer};
+    for(TextureBuffer* tb : buffers){
+        if(tb->texture!=0){
+            glDeleteTextures(1, &tb->texture);
+        }
+        if(tb->buffer!=0){
+            glDeleteBuffers(1, &tb->buffer);
+        }
+        *tb = TextureBuffer();
+    }
+}
+
+void ClusteredLighting::SetProjection(const glm::mat4& projection, float zNear, float zFar){
+    if(projection==m_projection && zNear==m_near && zFar==m_far){
+        return;
+    }
+    m_projection = projection;
+    m_near = zNear;
+    m_far  = zFar;
+
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    for(unsigned int z=0; z < CLUSTER_SLICES; ++z){
+        // Slices are spaced exponentially between near and far
+        float sliceNear = zNear*std::pow(zFar/zNear, (float)z/CLUSTER_SLICES);
+        float sliceFar  = zNear*std::pow(zFar/zNear, (float)(z+1)/CLUSTER_SLICES);
+        for(unsigned int y=0; y < CLUSTER_TILES_Y; ++y){
+            for(unsigned int x=0; x < CLUSTER_TILES_X; ++x){
+                glm::vec3 minimum( 1e30f);
+                glm::vec3 maximum(-1e30f);
+                // The four corners of our tile, on both depth planes
+                for(unsigned int corner=0; corner < 4; ++corner){
+                    float ndcX = -1.0f + 2.0f*(float)(x + (corner&1))/CLUSTER_TILES_X;
+                    float ndcY = -1.0f + 2.0f*(float)(y + (corner>>1))/CLUSTER_TILES_Y;
+                    glm::vec4 onNear = inverseProjection*glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                    glm::vec3 ray = glm::vec3(onNear)/onNear.w;
+                    // Slide along the ray to each depth plane (view space looks down -z)
+                    glm::vec3 a = ray*(sliceNear/-ray.z);
+                    glm::vec3 b = ray*(sliceFar/-ray.z);
+                    minimum = glm::min(minimum, glm::min(a,b));
+                    maximum = glm::max(maximum, glm::max(a,b));
+                }
+                unsigned int index = (z*CLUSTER_TILES_Y + y)*CLUSTER_TILES_X + x;
+                m_minX[index] = minimum.x; m_minY[index] = minimum.y; m_minZ[index] = minimum.z;
+                m_maxX[index] = maximum.x; m_maxY[index] = maximum.y; m_maxZ[index] = maximum.z;
+            }
+        }
+    }
+}
+
+glm::vec4 ClusteredLighting::GetScaleBias() const{
+    // slice = log(depth)*scale + bias
+    float logRatio = std::log(m_far/m_near);
+    float scale = (float)CLUSTER_SLICES/logRatio;
+    float bias  = -(float)CLUSTER_SLICES*std::log(m_near)/logRatio;
+    return glm::vec4(scale, bias,
+                     (float)m_screenWidth/CLUSTER_TILES_X,
+                     (float)m_screenHeight/CLUSTER_TILES_Y);
+}
+
+glm::ivec4 ClusteredLighting::GetGridSize() const{
+    return glm::ivec4(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, 0);
+}
+
+float ClusteredLighting::ComputeLightRadius(const PointLightData& light, float zFar){
+    // Solve constant + linear*d + quadratic*d^2 = brightness/cutoff for d
+    // At most ambient + full diffuse + full specular reach the surface
+    float brightness = std::max(light.lightColor.x, std::max(light.lightColor.y, light.lightColor.z));
+    brightness *= light.ambientIntensity + 1.0f + light.specularStrength;
+    float target = brightness/LIGHT_CUTOFF - light.constant;
+    if(target <= 0.0f){
+        return 0.0f;
+    }
+    if(light.quadratic > 0.0f){
+        float discriminant = light.linear*light.linear + 4.0f*light.quadratic*target;
+        return std::min(zFar, (-light.linear + std::sqrt(discriminant))/(2.0f*light.quadratic));
+    }
+    if(light.linear > 0.0f){
+        return std::min(zFar, target/light.linear);
+    }
+    // No falloff at all, the light reaches everything we can see
+    return zFar;
+}
+
+void ClusteredLighting::AssignLight(uint16_t light, const glm::vec3& center, float radius){
+    // Only the slices the sphere's depth range covers can be touched
+    float depthMin = -center.z - radius;
+    float depthMax = -center.z + radius;
+    if(depthMax < m_near || depthMin > m_far){
+        return;
+    }
+    glm::vec4 scaleBias = GetScaleBias();
+    int sliceMin = (int)std::floor(std::log(std::max(depthMin, m_near))*scaleBias.x + scaleBias.y);
+    int sliceMax = (int)std::floor(std::log(std::min(depthMax, m_far))*scaleBias.x + scaleBias.y);
+    sliceMin = std::max(0, std::min((int)CLUSTER_SLICES-1, sliceMin));
+    sliceMax = std::max(0, std::min((int)CLUSTER_SLICES-1, sliceMax));
+
+    const unsigned int perSlice = CLUSTER_TILES_X*CLUSTER_TILES_Y;
+    float radius2 = radius*radius;
+    unsigned int first = sliceMin*perSlice;
+    unsigned int last  = (sliceMax+1)*perSlice;
+
+    unsigned int i = first;
+#ifdef CLUSTER_USE_SSE
+    // Sphere vs box, four boxes at a time:
+    // distance^2 = sum over axes of max(min-c,0)^2 + max(c-max,0)^2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_set1_ps(center.x);
+    const __m128 cy = _mm_set1_ps(center.y);
+    const __m128 cz = _mm_set1_ps(center.z);
+    const __m128 r2 = _mm_set1_ps(radius2);
+    for(; i+4 <= last; i += 4){
+        __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[i]), cx), zero),
+                               _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(&m_maxX[i])), zero));
+        __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[i]), cy), zero),
+                               _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(&m_maxY[i])), zero));
+        __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minZ[i]), cz), zero),
+                               _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(&m_maxZ[i])), zero));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx), _mm_mul_ps(dy,dy)), _mm_mul_ps(dz,dz));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+        while(mask!=0){
+            int lane = 0;
+            while(((mask>>lane)&1)==0){
+                ++lane;
+            }
+            mask &= ~(1<<lane);
+            unsigned int cluster = i + lane;
+            if(m_clusterCounts[cluster] < MAX_LIGHTS_PER_CLUSTER){
+                m_clusterLights[cluster*MAX_LIGHTS_PER_CLUSTER + m_clusterCounts[cluster]++] = light;
+            }else{
+                ++m_dropped;
+            }
+        }
+    }
+#endif
+    // Whatever is left (or everything, without SSE)
+    for(; i < last; ++i){
+        float dx = std::max(m_minX[i]-center.x, 0.0f) + std::max(center.x-m_maxX[i], 0.0f);
+        float dy = std::max(m_minY[i]-center.y, 0.0f) + std::max(center.y-m_maxY[i], 0.0f);
+        float dz = std::max(m_minZ[i]-center.z, 0.0f) + std::max(center.z-m_maxZ[i], 0.0f);
+        if(dx*dx + dy*dy + dz*dz <= radius2){
+            if(m_clusterCounts[i] < MAX_LIGHTS_PER_CLUSTER){
+                m_clusterLights[i*MAX_LIGHTS_PER_CLUSTER + m_clusterCounts[i]++] = light;
+            }else{
+                ++m_dropped;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::Update(const std::vector<PointLightData>& lights, const glm::mat4& view){
+    std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0);
+    m_dropped = 0;
+    // Our indices are 16 bits
+    m_lightCount = std::min<size_t>(lights.size(), 65535);
+
+    // (1) Pack the lights for the shader and assign them to clusters
+    m_lightTexels.resize(m_lightCount*3);
+    for(unsigned int i=0; i < m_lightCount; ++i){
+        const PointLightData& light = lights[i];
+        float radius = ComputeLightRadius(light, m_far);
+        m_lightTexels[i*3+0] = glm::vec4(light.lightPos, radius);
+        m_lightTexels[i*3+1] = glm::vec4(light.lightColor, light.ambientIntensity);
+        m_lightTexels[i*3+2] = glm::vec4(light.constant, light.linear, light.quadratic, light.specularStrength);
+        if(radius > 0.0f){
+            glm::vec3 center = glm::vec3(view*glm::vec4(light.lightPos, 1.0f));
+            AssignLight((uint16_t)i, center, radius);
+        }
+    }
+
+    // (2) Compact the per cluster lists into one index list
+    m_indices.clear();
+    for(unsigned int c=0; c < CLUSTER_COUNT; ++c){
+        m_grid[c*2+0] = m_indices.size();
+        m_grid[c*2+1] = m_clusterCounts[c];
+        const uint16_t* begin = &m_clusterLights[c*MAX_LIGHTS_PER_CLUSTER];
+        m_indices.insert(m_indices.end(), begin, begin + m_clusterCounts[c]);
+    }
+
+    // (3) Upload
+    UploadTextureBuffer(m_lightBuffer, m_lightTexels.data(), m_lightTexels.size()*sizeof(glm::vec4));
+    UploadTextureBuffer(m_gridBuffer,  m_grid.data(),        m_grid.size()*sizeof(uint32_t));
+    UploadTextureBuffer(m_indexBuffer, m_indices.data(),     m_indices.size()*sizeof(uint16_t));
+}
+
+void ClusteredLighting::Bind() const{
+    glActiveTexture(GL_TEXTURE0+CLUSTER_LIGHT_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_lightBuffer.texture);
+    glActiveTexture(GL_TEXTURE0+CLUSTER_GRID_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_gridBuffer.texture);
+    glActiveTexture(GL_TEXTURE0+CLUSTER_INDEX_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_indexBuffer.texture);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -7,18 +7,17 @@
 
 #include "Framebuffer.hpp"
 #include "Shader.hpp"
+#include "ShaderManager.hpp"
 
 #include <glad/glad.h>
 
+#include <iostream>
+
 
 Framebuffer::Framebuffer(){
     // (1) ======= Setup shader
-    m_fboShader = std::make_shared<Shader>();
-    // Setup shaders for the Framebuffer Object
-    std::string fboVertexShader = m_fboShader->LoadShader("./shaders/fboVert.glsl");
-    std::string fboFragmentShader = m_fboShader->LoadShader("./shaders/fboFrag.glsl");
-    // Actually create our shader
-    m_fboShader->CreateShader(fboVertexShader,fboFragmentShader);       
+    // Every framebuffer shares the same screen quad shader
+    m_fboShader = ShaderManager::Instance().RequestShader("./shaders/fboVert.glsl","./shaders/fboFrag.glsl");
     // (2) ======= Setup quad to draw to
     // Setup the screen quad
     // x and y of 0.0 put the quad in the top left corner
@@ -29,6 +28,9 @@ Framebuffer::Framebuffer(){
 // Destructor
 Framebuffer::~Framebuffer(){
     glDeleteFramebuffers(1,&m_fbo_id); 
+    if(m_depthTexture!=0){
+        glDeleteTextures(1,&m_depthTexture);
+    }
     glDeleteVertexArrays(1,&m_quadVAO);
     glDeleteBuffers(1,&m_quadVBO);
 }
@@ -60,11 +62,100 @@ void Framebuffer::Create(int width, int height){
     // Deselect our buffers
     Unbind();
 }
+bool Framebuffer::CreateDepthArray(int size, int layers){
+    return CreateDepth(GL_TEXTURE_2D_ARRAY, size, layers);
+}
+
+bool Framebuffer::CreateDepthCube(int size){
+    return CreateDepth(GL_TEXTURE_CUBE_MAP, size, 6);
+}
+
+// Depth only, so there is no color texture or renderbuffer.
+// The depth texture is set up for hardware comparison, so a
+// sampler2DArrayShadow or samplerCubeShadow returns how lit a point
+// is, filtered over the nearest four texels.
+bool Framebuffer::CreateDepth(GLenum target, int size, int layers){
+    m_depthTarget = target;
+    m_depthSize = size;
+    m_depthLayers = layers;
+
+    glGenTextures(1, &m_depthTexture);
+    glBindTexture(target, m_depthTexture);
+    if(target==GL_TEXTURE_CUBE_MAP){
+        for(int face=0; face < 6; ++face){
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                         GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        }
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }else{
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0,
+                     GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(target, 0);
+
+    glGenFramebuffers(1, &m_fbo_id);
+    BindLayer(0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    Unbind();
+    if(status!=GL_FRAMEBUFFER_COMPLETE){
+        std::cout << "(FrameBuffer.cpp) ERROR, depth framebuffer is not complete: " << status << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::AttachDepthLayer(GLenum framebufferTarget, int layer){
+    if(m_depthTarget==GL_TEXTURE_CUBE_MAP){
+        glFramebufferTexture2D(framebufferTarget, GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_CUBE_MAP_POSITIVE_X+layer, m_depthTexture, 0);
+    }else{
+        glFramebufferTextureLayer(framebufferTarget, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, layer);
+    }
+    // There is no color to write or read
+    if(framebufferTarget==GL_READ_FRAMEBUFFER){
+        glReadBuffer(GL_NONE);
+    }else{
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+}
+
 // Select our framebuffer
 void Framebuffer::Bind(){
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
 }
 
+void Framebuffer::BindLayer(int layer){
+    if(layer < 0 || layer >= m_depthLayers){
+        std::cout << "(FrameBuffer.cpp) ERROR, no depth layer " << layer << "\n";
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_id);
+    AttachDepthLayer(GL_FRAMEBUFFER, layer);
+}
+
+// A blit is the one copy between depth textures OpenGL 3.3 has
+void Framebuffer::CopyDepthLayer(Framebuffer& source, int layer){
+    if(source.m_depthTarget!=m_depthTarget || source.m_depthSize!=m_depthSize ||
+       layer < 0 || layer >= m_depthLayers){
+        std::cout << "(FrameBuffer.cpp) ERROR, depth layers do not match\n";
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.m_fbo_id);
+    source.AttachDepthLayer(GL_READ_FRAMEBUFFER, layer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo_id);
+    AttachDepthLayer(GL_DRAW_FRAMEBUFFER, layer);
+    glBlitFramebuffer(0, 0, m_depthSize, m_depthSize, 0, 0, m_depthSize, m_depthSize,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 // Update our framebuffer once per frame for any
 // changes that may have occurred.
 void Framebuffer::Update(){
@@ -0,0 +1,109 @@
+#include "GBuffer.hpp"
+
+#include <iostream>
+
+GBuffer::GBuffer(){
+}
+
+GBuffer::~GBuffer(){
+    Destroy();
+}
+
+// Creates a texture we can render into and sample from
+static GLuint CreateTarget(int width, int height, GLint internalFormat, GLenum format, GLenum type){
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    // One texel per pixel, so there is nothing to filter
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+bool GBuffer::Create(int width, int height){
+    Destroy();
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+    m_albedo = CreateTarget(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedo, 0);
+    m_normal = CreateTarget(width, height, GL_RG16F, GL_RG, GL_FLOAT);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normal, 0);
+    // Depth is a texture (rather than a renderbuffer) so we can read it back
+    m_depth = CreateTarget(width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if(status!=GL_FRAMEBUFFER_COMPLETE){
+        std::cout << "(GBuffer.cpp) ERROR, G-buffer is not complete: " << status << "\n";
+        return false;
+    }
+
+    // Same layout as the Framebuffer's screen quad, so fboVert.glsl works
+    float quad[] = {
+        -1.0f,  1.0f,  0.0f, 1.0f, // x,y,s,t
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
+    glGenVertexArrays(1, &m_quadVAO);
+    glGenBuffers(1, &m_quadVBO);
+    glBindVertexArray(m_quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), &quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
+    glBindVertexArray(0);
+    return true;
+}
+
+void GBuffer::Bind(){
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    // Our fragment shader writes to both color targets
+    GLenum targets[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, targets);
+}
+
+void GBuffer::Unbind(){
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::BindTextures() const{
+    glActiveTexture(GL_TEXTURE0+GBUFFER_ALBEDO_SLOT);
+    glBindTexture(GL_TEXTURE_2D, m_albedo);
+    glActiveTexture(GL_TEXTURE0+GBUFFER_NORMAL_SLOT);
+    glBindTexture(GL_TEXTURE_2D, m_normal);
+    glActiveTexture(GL_TEXTURE0+GBUFFER_DEPTH_SLOT);
+    glBindTexture(GL_TEXTURE_2D, m_depth);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::DrawFullscreenQuad() const{
+    glBindVertexArray(m_quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void GBuffer::Destroy(){
+    if(m_fbo!=0){
+        glDeleteFramebuffers(1, &m_fbo);
+        glDeleteTextures(1, &m_albedo);
+        glDeleteTextures(1, &m_normal);
+        glDeleteTextures(1, &m_depth);
+        m_fbo = m_albedo = m_normal = m_depth = 0;
+    }
+    if(m_quadVAO!=0){
+        glDeleteVertexArrays(1, &m_quadVAO);
+        glDeleteBuffers(1, &m_quadVBO);
+        m_quadVAO = m_quadVBO = 0;
+    }
+}
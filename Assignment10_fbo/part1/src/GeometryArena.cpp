@@ -0,0 +1,267 @@
+#include "GeometryArena.hpp"
+
+#include <iostream>
+
+// How large each page is by default.
+// Objects larger than this get a page of their own.
+static const unsigned int PAGE_VERTEX_BYTES = 16*1024*1024;
+static const unsigned int PAGE_INDICES      = 4*1024*1024;
+
+// ============== FreeListAllocator ==============
+
+FreeListAllocator::FreeListAllocator(unsigned int capacity) : m_capacity(capacity){
+    // Initially everything is one big free range
+    if(capacity > 0){
+        m_freeRanges[0] = capacity;
+    }
+}
+
+unsigned int FreeListAllocator::Allocate(unsigned int size){
+    if(size==0){
+        return INVALID_OFFSET;
+    }
+    // First fit: take the lowest range that is large enough
+    for(auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it){
+        if(it->second >= size){
+            unsigned int offset = it->first;
+            unsigned int remaining = it->second - size;
+            m_freeRanges.erase(it);
+            // Keep whatever is left over as a smaller free range
+            if(remaining > 0){
+                m_freeRanges[offset+size] = remaining;
+            }
+            m_used += size;
+            return offset;
+        }
+    }
+    return INVALID_OFFSET;
+}
+
+void FreeListAllocator::Free(unsigned int offset, unsigned int size){
+    if(size==0 || offset==INVALID_OFFSET){
+        return;
+    }
+    m_used -= size;
+    auto next = m_freeRanges.lower_bound(offset);
+    // Merge with the range that follows us
+    if(next != m_freeRanges.end() && offset+size == next->first){
+        size += next->second;
+        next = m_freeRanges.erase(next);
+    }
+    // Merge with the range in front of us
+    if(next != m_freeRanges.begin()){
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == offset){
+            prev->second += size;
+            return;
+        }
+    }
+    m_freeRanges[offset] = size;
+}
+
+// ============== Vertex formats ==============
+
+unsigned int GetVertexFormatStride(VertexFormat format){
+    switch(format){
+        case VertexFormat::Position: return 3;
+        case VertexFormat::Texture:  return 5;
+        case VertexFormat::Normal:   return 14;
+        default: break;
+    }
+    return 0;
+}
+
+// Describes the attributes of a format to the currently bound VAO.
+// This is the same layout VertexBufferLayout sets up.
+static void SetupVertexAttributes(VertexFormat format){
+    GLsizei stride = sizeof(float)*GetVertexFormatStride(format);
+
+    // Every format starts with x,y,z
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,stride,(char*)0);
+
+    if(format==VertexFormat::Texture){
+        // s,t
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1,2,GL_FLOAT,GL_TRUE,stride,(char*)(sizeof(float)*3));
+    }else if(format==VertexFormat::Normal){
+        // normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,stride,(char*)(sizeof(float)*3));
+        // s,t
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,stride,(char*)(sizeof(float)*6));
+        // tangents
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,stride,(char*)(sizeof(float)*8));
+        // bi-tangents
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4,3,GL_FLOAT,GL_FALSE,stride,(char*)(sizeof(float)*11));
+    }
+}
+
+// ============== GeometryArena ==============
+
+GeometryArena::Page::Page(VertexFormat f, unsigned int maxVertices, unsigned int maxIndices) :
+                format(f), vertices(maxVertices), indices(maxIndices){
+}
+
+GeometryArena::GeometryArena(){
+}
+
+GeometryArena& GeometryArena::Instance(){
+    // Never deleted, our buffers are released in Destroy()
+    // while there is still an OpenGL context.
+    static GeometryArena* instance = new GeometryArena();
+    return *instance;
+}
+
+int GeometryArena::CreatePage(VertexFormat format, unsigned int vertexCount, unsigned int indexCount){
+    unsigned int stride = GetVertexFormatStride(format);
+    unsigned int maxVertices = PAGE_VERTEX_BYTES/(stride*sizeof(float));
+    unsigned int maxIndices  = PAGE_INDICES;
+    // Very large objects get a page of exactly their size
+    if(vertexCount > maxVertices){
+        maxVertices = vertexCount;
+    }
+    if(indexCount > maxIndices){
+        maxIndices = indexCount;
+    }
+
+    Page page(format,maxVertices,maxIndices);
+
+    glGenVertexArrays(1, &page.vao);
+    glBindVertexArray(page.vao);
+    // Reserve the storage up front, data is filled in by Allocate
+    glGenBuffers(1, &page.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxVertices*stride*sizeof(float), nullptr, GL_STATIC_DRAW);
+    SetupVertexAttributes(format);
+    // The index buffer binding is stored in the VAO
+    glGenBuffers(1, &page.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)maxIndices*sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+    m_boundVAO = page.vao;
+    ++m_vaoBindCount;
+
+    m_pages.push_back(page);
+    return m_pages.size()-1;
+}
+
+GeometryAllocation GeometryArena::Allocate(VertexFormat format, unsigned int vcount, unsigned int icount, float* vdata, unsigned int* idata){
+    static_assert(sizeof(unsigned int)==sizeof(GLuint),"Gluint not same size!");
+
+    GeometryAllocation result;
+    unsigned int stride = GetVertexFormatStride(format);
+    unsigned int vertexCount = vcount/stride;
+    if(vertexCount==0 || icount==0){
+        std::cout << "(GeometryArena.cpp) ERROR, tried to allocate empty geometry\n";
+        return result;
+    }
+
+    // Find the first page of this format with room for both
+    // the vertices and the indices.
+    unsigned int vertexOffset = FreeListAllocator::INVALID_OFFSET;
+    unsigned int indexOffset  = FreeListAllocator::INVALID_OFFSET;
+    int pageIndex = -1;
+    for(unsigned int i=0; i < m_pages.size(); ++i){
+        if(m_pages[i].format!=format){
+            continue;
+        }
+        vertexOffset = m_pages[i].vertices.Allocate(vertexCount);
+        if(vertexOffset==FreeListAllocator::INVALID_OFFSET){
+            continue;
+        }
+        indexOffset = m_pages[i].indices.Allocate(icount);
+        if(indexOffset==FreeListAllocator::INVALID_OFFSET){
+            m_pages[i].vertices.Free(vertexOffset,vertexCount);
+            continue;
+        }
+        pageIndex = i;
+        break;
+    }
+    // No room anywhere, so start a new page
+    if(pageIndex < 0){
+        pageIndex = CreatePage(format,vertexCount,icount);
+        vertexOffset = m_pages[pageIndex].vertices.Allocate(vertexCount);
+        indexOffset  = m_pages[pageIndex].indices.Allocate(icount);
+    }
+
+    Page& page = m_pages[pageIndex];
+    // Upload our data into the ranges we were given.
+    // The VAO is bound first so that binding the index buffer
+    // does not disturb some other VAO's state.
+    Bind(GeometryAllocation{pageIndex});
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    (GLintptr)vertexOffset*stride*sizeof(float),
+                    (GLsizeiptr)vertexCount*stride*sizeof(float),
+                    vdata);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                    (GLintptr)indexOffset*sizeof(GLuint),
+                    (GLsizeiptr)icount*sizeof(GLuint),
+                    idata);
+
+    result.page        = pageIndex;
+    result.baseVertex  = vertexOffset;
+    result.firstIndex  = indexOffset;
+    result.vertexCount = vertexCount;
+    result.indexCount  = icount;
+    return result;
+}
+
+void GeometryArena::Free(GeometryAllocation& allocation){
+    if(!allocation.IsValid() || allocation.page >= (int)m_pages.size()){
+        return;
+    }
+    Page& page = m_pages[allocation.page];
+    page.vertices.Free(allocation.baseVertex,allocation.vertexCount);
+    page.indices.Free(allocation.firstIndex,allocation.indexCount);
+    allocation = GeometryAllocation();
+}
+
+void GeometryArena::Bind(const GeometryAllocation& allocation){
+    if(!allocation.IsValid()){
+        return;
+    }
+    GLuint vao = m_pages[allocation.page].vao;
+    // Only talk to OpenGL when the page actually changes
+    if(vao!=m_boundVAO){
+        glBindVertexArray(vao);
+        m_boundVAO = vao;
+        ++m_vaoBindCount;
+    }
+}
+
+void GeometryArena::Draw(const GeometryAllocation& allocation){
+    if(!allocation.IsValid()){
+        return;
+    }
+    Bind(allocation);
+    glDrawElementsBaseVertex(GL_TRIANGLES,
+                             allocation.indexCount,     // The number of indices, not triangles.
+                             GL_UNSIGNED_INT,           // Make sure the data type matches
+                             (void*)(sizeof(GLuint)*(size_t)allocation.firstIndex), // Offset into the page
+                             allocation.baseVertex);    // Added to every index
+    ++m_drawCount;
+}
+
+void GeometryArena::InvalidateBindings(){
+    m_boundVAO = 0;
+}
+
+void GeometryArena::Destroy(){
+    for(unsigned int i=0; i < m_pages.size(); ++i){
+        glDeleteBuffers(1,&m_pages[i].vbo);
+        glDeleteBuffers(1,&m_pages[i].ibo);
+        glDeleteVertexArrays(1,&m_pages[i].vao);
+    }
+    m_pages.clear();
+    m_boundVAO = 0;
+}
+
+void GeometryArena::ResetStats(){
+    m_drawCount = 0;
+    m_vaoBindCount = 0;
+}
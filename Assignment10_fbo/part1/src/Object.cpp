@@ -7,7 +7,8 @@ Object::Object(){
 }
 
 Object::~Object(){
-    
+    // Give our space in the arena back
+    GeometryArena::Instance().Free(m_geometryAllocation);
 }
 
 // TODO: In the future it may be good to 
@@ -42,10 +43,11 @@ void Object::MakeTexturedQuad(std::string fileName){
         // This is a helper function to generate all of the geometry
         m_geometry.Gen();
 
-        // Create a buffer and set the stride of information
+        // Place our geometry in the shared arena
         // NOTE: How we are leveraging our data structure in order to very cleanly
         //       get information into and out of our data structure.
-        m_vertexBufferLayout.CreateNormalBufferLayout(m_geometry.GetBufferDataSize(),
+        m_geometryAllocation = GeometryArena::Instance().Allocate(VertexFormat::Normal,
+                                        m_geometry.GetBufferDataSize(),
                                         m_geometry.GetIndicesSize(),
                                         m_geometry.GetBufferDataPtr(),
                                         m_geometry.GetIndicesDataPtr());
@@ -60,7 +62,8 @@ void Object::MakeTexturedQuad(std::string fileName){
 // before we do any actual work with our object
 void Object::Bind(){
         // Make sure we are updating the correct 'buffers'
-        m_vertexBufferLayout.Bind();
+        // (Only rebinds if another page was selected)
+        GeometryArena::Instance().Bind(m_geometryAllocation);
         // Diffuse map is 0 by default, but it is good to set it explicitly
         m_textureDiffuse.Bind(0);
         // Detail map
@@ -72,10 +75,8 @@ void Object::Render(){
     // Call our helper function to just bind everything
     Bind();
 	//Render data
-    glDrawElements(GL_TRIANGLES,
-                   m_geometry.GetIndicesSize(), // The number of indices, not triangles.
-                   GL_UNSIGNED_INT,             // Make sure the data type matches
-                        nullptr);               // Offset pointer to the data. 
-                                                // nullptr because we are currently bound
+    // Our indices start at 'firstIndex' in the arena's index buffer
+    // and are offset by 'baseVertex' to find our vertices.
+    GeometryArena::Instance().Draw(m_geometryAllocation);
 }
 
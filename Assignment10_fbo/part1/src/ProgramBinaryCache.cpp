@@ -0,0 +1,225 @@
+#include "ProgramBinaryCache.hpp"
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // This works for Mac
+    #include <SDL.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Program binaries are core in OpenGL 4.1 (and ARB_get_program_binary),
+// which is newer than what our glad loader was generated for, so we
+// fetch these ourselves.
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+
+typedef void (APIENTRYP PFNGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+static PFNGETPROGRAMBINARYPROC  s_glGetProgramBinary  = nullptr;
+static PFNPROGRAMBINARYPROC     s_glProgramBinary     = nullptr;
+static PFNPROGRAMPARAMETERIPROC s_glProgramParameteri = nullptr;
+
+// Written at the front of every cache file
+static const char     CACHE_MAGIC[4] = {'G','L','P','B'};
+static const uint32_t CACHE_VERSION  = 1;
+
+// 64-bit FNV-1a
+static uint64_t HashString(const std::string& s){
+    uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : s){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(){
+}
+
+ProgramBinaryCache& ProgramBinaryCache::Instance(){
+    static ProgramBinaryCache* instance = new ProgramBinaryCache();
+    return *instance;
+}
+
+void ProgramBinaryCache::SetDirectory(const std::string& directory){
+    m_directory = directory;
+}
+
+void ProgramBinaryCache::SetEnabled(bool enabled){
+    m_enabled = enabled;
+}
+
+void ProgramBinaryCache::Initialize(){
+    if(m_initialized){
+        return;
+    }
+    m_initialized = true;
+
+    s_glGetProgramBinary  = (PFNGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+    s_glProgramBinary     = (PFNPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+    s_glProgramParameteri = (PFNPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+
+    // Some drivers export the functions but support zero formats
+    GLint formats = 0;
+    if(s_glGetProgramBinary && s_glProgramBinary && s_glProgramParameteri){
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        // Older drivers may not know the enum at all
+        while(glGetError()!=GL_NO_ERROR){}
+    }
+    m_supported = formats > 0;
+
+    const char* vendor   = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version  = (const char*)glGetString(GL_VERSION);
+    m_driver = std::string(vendor ? vendor : "") + "\n" +
+               std::string(renderer ? renderer : "") + "\n" +
+               std::string(version ? version : "");
+    m_driverHash = HashString(m_driver);
+
+    if(!m_supported){
+        std::cout << "(ProgramBinaryCache.cpp) Program binaries not supported by this driver, cache disabled\n";
+    }
+}
+
+bool ProgramBinaryCache::IsSupported(){
+    Initialize();
+    return m_supported;
+}
+
+std::string ProgramBinaryCache::GetPath(uint64_t sourceHash) const{
+    // Mixing the driver into the name means a new driver
+    // simply misses rather than loading a stale binary.
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)(sourceHash ^ m_driverHash));
+    return m_directory + "/" + name;
+}
+
+void ProgramBinaryCache::PrepareProgram(GLuint program){
+    if(!m_enabled || !IsSupported()){
+        return;
+    }
+    s_glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramBinaryCache::Load(uint64_t sourceHash, GLuint program){
+    if(!m_enabled || !IsSupported()){
+        return false;
+    }
+
+    std::ifstream file(GetPath(sourceHash), std::ios::binary);
+    if(!file.is_open()){
+        ++m_misses;
+        return false;
+    }
+
+    // Header: magic, version, driver string, format, binary length
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t driverLength = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)&driverLength, sizeof(driverLength));
+    if(!file || std::memcmp(magic, CACHE_MAGIC, sizeof(magic))!=0 ||
+       version!=CACHE_VERSION || driverLength!=m_driver.size()){
+        ++m_misses;
+        return false;
+    }
+    std::string driver(driverLength, '\0');
+    file.read(&driver[0], driverLength);
+    uint32_t format = 0;
+    uint32_t length = 0;
+    file.read((char*)&format, sizeof(format));
+    file.read((char*)&length, sizeof(length));
+    // The driver string guards against a hash collision in the file name
+    if(!file || driver!=m_driver || length==0){
+        ++m_misses;
+        return false;
+    }
+    std::vector<char> binary(length);
+    file.read(binary.data(), length);
+    if(!file){
+        ++m_misses;
+        return false;
+    }
+
+    s_glProgramBinary(program, format, binary.data(), length);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(linked!=GL_TRUE){
+        // The driver no longer likes this binary, compile from source instead
+        ++m_rejects;
+        ++m_misses;
+        file.close();
+        std::error_code error;
+        std::filesystem::remove(GetPath(sourceHash), error);
+        return false;
+    }
+    ++m_hits;
+    return true;
+}
+
+void ProgramBinaryCache::Store(uint64_t sourceHash, GLuint program){
+    if(!m_enabled || !IsSupported()){
+        return;
+    }
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(linked!=GL_TRUE || length<=0){
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    s_glGetProgramBinary(program, length, &written, &format, binary.data());
+    if(written<=0){
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if(error){
+        std::cout << "(ProgramBinaryCache.cpp) Could not create " << m_directory << "\n";
+        return;
+    }
+    // Write to a temporary file first so a crash never leaves a half written entry
+    std::string path = GetPath(sourceHash);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if(!file.is_open()){
+            return;
+        }
+        uint32_t driverLength = m_driver.size();
+        uint32_t binaryFormat = format;
+        uint32_t binaryLength = written;
+        file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        file.write((const char*)&CACHE_VERSION, sizeof(CACHE_VERSION));
+        file.write((const char*)&driverLength, sizeof(driverLength));
+        file.write(m_driver.data(), driverLength);
+        file.write((const char*)&binaryFormat, sizeof(binaryFormat));
+        file.write((const char*)&binaryLength, sizeof(binaryLength));
+        file.write(binary.data(), written);
+        if(!file){
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+}
+
+void ProgramBinaryCache::PrintStats() const{
+    std::cout << "(ProgramBinaryCache.cpp) hits: " << m_hits
+              << " misses: " << m_misses
+              << " rejected: " << m_rejects << "\n";
+}
@@ -1,4 +1,8 @@
 #include "Renderer.hpp"
+#include "GeometryArena.hpp"
+#include "ShaderManager.hpp"
+
+#include <algorithm>
 
 
 // Sets the height and width of our renderer
@@ -19,6 +23,42 @@ Renderer::Renderer(unsigned int w, unsigned int h){
     Framebuffer* newFramebuffer = new Framebuffer();
     newFramebuffer->Create(w,h);
     m_framebuffers.push_back(newFramebuffer);
+
+    // Per frame data lives in uniform buffers at fixed binding points
+    m_frameDataBuffer.Create(sizeof(FrameData), UniformBlockBinding::FrameData);
+    m_lightDataBuffer.Create(sizeof(LightData), UniformBlockBinding::LightData);
+    m_clusteredLighting.Create(w,h);
+    // A low sun, so the terrain casts long shadows
+    m_shadowMaps.Create(2048, 512);
+    m_shadowMaps.SetSun(glm::vec3(0.5f,0.4f,0.3f), glm::vec3(0.6f,0.55f,0.45f));
+
+    // The deferred path is only used when selected, but is
+    // cheap to have ready.
+    m_gbuffer.Create(w,h);
+    m_deferredShader = ShaderManager::Instance().RequestShader("./shaders/fboVert.glsl","./shaders/deferredFrag.glsl",{"USE_SHADOWS"});
+    glGenQueries(2, m_timerQueries);
+
+    // Our two default lights sit just in front of the camera
+    // (their positions are set every Update).
+    PointLightData light = {};
+    // Create a first 'light'
+    light.lightColor       = glm::vec3(1.0f,1.0f,1.0f);
+    light.ambientIntensity = 0.9f;
+    light.specularStrength = 0.5f;
+    light.constant         = 1.0f;
+    light.linear           = 0.003f;
+    light.quadratic        = 0.0f;
+    AddPointLight(light);
+    // Create a second light
+    light.lightColor       = glm::vec3(1.0f,0.0f,0.0f);
+    light.linear           = 0.09f;
+    light.quadratic        = 0.032f;
+    AddPointLight(light);
+}
+
+unsigned int Renderer::AddPointLight(const PointLightData& light){
+    m_pointLights.push_back(light);
+    return m_pointLights.size()-1;
 }
 
 // Sets the height and width of our renderer
@@ -31,6 +71,7 @@ Renderer::~Renderer(){
     for(int i=0; i < m_framebuffers.size(); i++){
         delete m_framebuffers[i];
     }
+    glDeleteQueries(2, m_timerQueries);
 }
 
 void Renderer::Update(){
@@ -39,7 +80,49 @@ void Renderer::Update(){
     // Then perspective
     // Then the near and far clipping plane.
     // Note I cannot see anything closer than 0.1f units from the screen.
-    m_projectionMatrix = glm::perspective(glm::radians(45.0f),((float)m_screenWidth)/((float)m_screenHeight),0.1f,512.0f);
+    const float zNear = 0.1f;
+    const float zFar  = 512.0f;
+    m_projectionMatrix = glm::perspective(glm::radians(45.0f),((float)m_screenWidth)/((float)m_screenHeight),zNear,zFar);
+    // Only rebuilds the cluster bounds if the projection changed
+    m_clusteredLighting.SetProjection(m_projectionMatrix, zNear, zFar);
+
+    // TODO: By default, we will only have one camera
+    Camera* camera = m_cameras[0];
+
+    // Everything every shader needs to know about the camera,
+    // sent once for the whole frame.
+    FrameData frameData;
+    frameData.view           = camera->GetWorldToViewmatrix();
+    frameData.projection     = m_projectionMatrix;
+    frameData.viewProjection = m_projectionMatrix * frameData.view;
+    m_viewProjection = frameData.viewProjection;
+    frameData.cameraPosition = glm::vec4(camera->GetEyeXPosition(),
+                                         camera->GetEyeYPosition(),
+                                         camera->GetEyeZPosition(), 1.0f);
+    frameData.clusterScaleBias = m_clusteredLighting.GetScaleBias();
+    frameData.clusterGridSize  = m_clusteredLighting.GetGridSize();
+    m_frameDataBuffer.Update(&frameData, sizeof(frameData));
+
+    // Our lights sit just in front of the camera
+    glm::vec3 lightPosition(camera->GetEyeXPosition() + camera->GetViewXDirection(),
+                            camera->GetEyeYPosition() + camera->GetViewYDirection(),
+                            camera->GetEyeZPosition() + camera->GetViewZDirection());
+    m_pointLights[0].lightPos = lightPosition;
+    m_pointLights[1].lightPos = lightPosition;
+
+    // Shaders without clustering only see the first few lights
+    LightData lightData = {};
+    lightData.lightCount = std::min<int>(m_pointLights.size(), MAX_POINT_LIGHTS);
+    for(int i=0; i < lightData.lightCount; ++i){
+        lightData.pointLights[i] = m_pointLights[i];
+    }
+    m_lightDataBuffer.Update(&lightData, sizeof(lightData));
+
+    // Everything else goes through the clusters
+    m_clusteredLighting.Update(m_pointLights, frameData.view);
+
+    // Only matrices here, the maps are drawn at the start of Render
+    m_shadowMaps.Update(frameData.view, m_projectionMatrix, m_pointLights);
 
     // Perform the update
     if(m_root!=nullptr){
@@ -54,6 +137,14 @@ void Renderer::Update(){
 // Setup our OpenGL State machine
 // Then render the scene
 void Renderer::Render(){
+    // Time the whole frame on the GPU so both paths can be compared
+    glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_frameCount%2]);
+    // Start compiling anything requested since last frame, objects
+    // skip drawing until their program is ready.
+    ShaderManager::Instance().SubmitPending();
+
+    // Our shadow maps, before anything samples them
+    m_shadowMaps.Render(m_root.get());
 
     // Setup our uniforms
     // In reality, only need to do this once for this
@@ -63,22 +154,6 @@ void Renderer::Render(){
     //       Assume for this implementation we only have at most
     //       One framebuffer
     m_framebuffers[0]->Update();
-    // Bind to our farmebuffer
-    m_framebuffers[0]->Bind();
-
-
-    // What we are doing, is telling opengl to create a depth(or Z-buffer) 
-    // for us that is stored every frame.
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D); 
-    // This is the background of the screen.
-    glViewport(0, 0, m_screenWidth, m_screenHeight);
-    glClearColor( 0.01f, 0.01f, 0.01f, 1.f );
-    // Clear color buffer and Depth Buffer
-    // Remember that the 'depth buffer' is our
-    // z-buffer that figures out how far away items are every frame
-    // and we have to do this every frame!
-    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
     // Nice way to debug your scene in wireframe!
     // TODO: Read this
@@ -96,10 +171,15 @@ void Renderer::Render(){
     }else{
         glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
     }
-    
-    // Now we render our objects from our scenegraph
-    if(m_root!=nullptr){
-        m_root->Draw();
+
+    // Our light clusters and shadow maps for shaders that use them
+    m_clusteredLighting.Bind();
+    m_shadowMaps.BindTextures();
+
+    if(m_renderPath==RenderPath::Deferred){
+        RenderDeferred();
+    }else{
+        RenderForward();
     }
 
     // Finish with our framebuffer
@@ -108,6 +188,7 @@ void Renderer::Render(){
     // We do not need depth since we are drawing a '2D'
     // image over our screen.
     glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
     // Clear everything away
     // Clear the screen color, and typically I do this
     // to something 'different' than our original as an
@@ -122,6 +203,89 @@ void Renderer::Render(){
     m_framebuffers[0]->DrawFBO();    
     // Unselect our shader and continue
     m_framebuffers[0]->m_fboShader->Unbind();
+
+    glEndQuery(GL_TIME_ELAPSED);
+    // Read the other query (last frame) if the GPU has finished it
+    ++m_frameCount;
+    if(m_frameCount > 1){
+        GLuint query = m_timerQueries[m_frameCount%2];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available){
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            m_gpuFrameTime = nanoseconds/1000000.0;
+        }
+    }
+}
+
+// Draws and lights every object in one go
+void Renderer::RenderForward(){
+    // Bind to our farmebuffer
+    m_framebuffers[0]->Bind();
+    // The screen quad from last frame bound its own VAO
+    GeometryArena::Instance().InvalidateBindings();
+
+    // What we are doing, is telling opengl to create a depth(or Z-buffer) 
+    // for us that is stored every frame.
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D); 
+    // This is the background of the screen.
+    glViewport(0, 0, m_screenWidth, m_screenHeight);
+    glClearColor( 0.01f, 0.01f, 0.01f, 1.f );
+    // Clear color buffer and Depth Buffer
+    // Remember that the 'depth buffer' is our
+    // z-buffer that figures out how far away items are every frame
+    // and we have to do this every frame!
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    
+    // Now we render our objects from our scenegraph
+    if(m_root!=nullptr){
+        m_root->Draw(RenderPass::Forward);
+    }
+}
+
+// Writes every object's surface into the G-buffer, then lights
+// each pixel once with a full screen pass.
+void Renderer::RenderDeferred(){
+    // (1) ======= Geometry pass
+    m_gbuffer.Bind();
+    GeometryArena::Instance().InvalidateBindings();
+    glEnable(GL_DEPTH_TEST);
+    glViewport(0, 0, m_screenWidth, m_screenHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    if(m_root!=nullptr){
+        m_root->Draw(RenderPass::GBuffer);
+    }
+
+    // (2) ======= Lighting pass, into the same framebuffer the forward path uses
+    m_framebuffers[0]->Bind();
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
+    // Pixels without geometry are discarded, so they keep this color
+    glClearColor( 0.01f, 0.01f, 0.01f, 1.f );
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+    m_deferredShader->Bind();
+    if(!m_uInverseViewProjection.IsValid()){
+        m_uInverseViewProjection = m_deferredShader->GetUniformHandle("u_InverseViewProjection");
+        m_deferredShader->SetUniform1i("u_GAlbedo",GBUFFER_ALBEDO_SLOT);
+        m_deferredShader->SetUniform1i("u_GNormal",GBUFFER_NORMAL_SLOT);
+        m_deferredShader->SetUniform1i("u_GDepth",GBUFFER_DEPTH_SLOT);
+        m_deferredShader->SetUniform1i("u_ClusterLights",CLUSTER_LIGHT_SLOT);
+        m_deferredShader->SetUniform1i("u_ClusterGrid",CLUSTER_GRID_SLOT);
+        m_deferredShader->SetUniform1i("u_ClusterIndices",CLUSTER_INDEX_SLOT);
+        m_deferredShader->SetUniform1i("u_CascadeShadowMap",SHADOW_CASCADE_SLOT);
+        m_deferredShader->SetUniform1i("u_PointShadowMap0",SHADOW_POINT_SLOT);
+        m_deferredShader->SetUniform1i("u_PointShadowMap1",SHADOW_POINT_SLOT+1);
+    }
+    glm::mat4 inverseViewProjection = glm::inverse(m_viewProjection);
+    m_deferredShader->SetUniformMatrix4fv(m_uInverseViewProjection, &inverseViewProjection[0][0]);
+    m_gbuffer.BindTextures();
+    m_gbuffer.DrawFullscreenQuad();
+    // Our quad VAO is now bound, not the arena's
+    GeometryArena::Instance().InvalidateBindings();
 }
 
 // Determines what the root is of the renderer, so the
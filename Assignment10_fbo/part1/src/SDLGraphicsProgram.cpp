@@ -4,11 +4,15 @@
 // Include the 'Renderer.hpp' which deteremines what
 // the graphics API is going to be for OpenGL
 #include "Renderer.hpp"
+#include "GeometryArena.hpp"
+#include "ProgramBinaryCache.hpp"
 
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <random>
+#include <cmath>
 
 // Initialization function
 // Returns a true or false value based on successful completion of setup.
@@ -70,6 +74,10 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h){
 
 // Proper shutdown of SDL and destroy initialized objects
 SDLGraphicsProgram::~SDLGraphicsProgram(){
+    // Release the shared geometry while our OpenGL context still exists
+    GeometryArena::Instance().Destroy();
+    // Let us know how well the shader cache did this run
+    ProgramBinaryCache::Instance().PrintStats();
     //Destroy window
 	SDL_DestroyWindow( m_window );
 	// Point m_window to NULL to ensure it points to nothing.
@@ -89,9 +97,58 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
     std::shared_ptr<Terrain> myTerrain = std::make_shared<Terrain>(512,512,"./assets/textures/terrain2.ppm");
     myTerrain->LoadTextures("./assets/textures/colormap.ppm","./assets/textures/detailmap.ppm");
 
+    // Scatter a few hundred small colored lights over the terrain.
+    // A fixed seed keeps the scene the same every run.
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> across(0.0f,512.0f);
+    std::uniform_real_distribution<float> height(5.0f,60.0f);
+    std::uniform_real_distribution<float> color(0.2f,1.0f);
+    for(int i=0; i < 512; ++i){
+        PointLightData light = {};
+        light.lightPos         = glm::vec3(across(random),height(random),across(random));
+        light.lightColor       = glm::vec3(color(random),color(random),color(random));
+        light.ambientIntensity = 0.0f;
+        light.specularStrength = 0.5f;
+        light.constant         = 1.0f;
+        light.linear           = 0.35f;
+        light.quadratic        = 0.44f;
+        renderer->AddPointLight(light);
+    }
+
+    // One bright light over the terrain casts shadows through a cube map.
+    // It never moves, so its static shadows are only drawn once.
+    PointLightData shadowLight = {};
+    shadowLight.lightPos         = glm::vec3(140.0f,90.0f,400.0f);
+    shadowLight.lightColor       = glm::vec3(1.0f,0.8f,0.5f);
+    shadowLight.ambientIntensity = 0.0f;
+    shadowLight.specularStrength = 0.5f;
+    shadowLight.constant         = 1.0f;
+    shadowLight.linear           = 0.01f;
+    shadowLight.quadratic        = 0.0005f;
+    renderer->GetShadowMaps().SetPointLight(0, renderer->AddPointLight(shadowLight));
+
     // Create a node for our terrain 
+    // The terrain is lit by every light through the light clusters
+    ShaderFeatures terrainFeatures;
+    terrainFeatures.clustered = true;
+    terrainFeatures.shadows   = true;
     std::shared_ptr<SceneNode> terrainNode;
-    terrainNode = std::make_shared<SceneNode>(myTerrain,"./shaders/vert.glsl","./shaders/frag.glsl");
+    terrainNode = std::make_shared<SceneNode>(myTerrain,"./shaders/vert.glsl","./shaders/frag.glsl",terrainFeatures);
+
+    // A few spinning panels under the light. They are the only dynamic
+    // shadow casters, so they are all that is redrawn each frame.
+    ShaderFeatures panelFeatures;
+    panelFeatures.shadows = true;
+    std::vector<SceneNode*> panelNodes;
+    for(int i=0; i < 4; ++i){
+        std::shared_ptr<Object> panel = std::make_shared<Object>();
+        panel->MakeTexturedQuad("./assets/textures/rock.ppm");
+        SceneNode* panelNode = new SceneNode(panel,"./shaders/vert.glsl","./shaders/frag.glsl",panelFeatures);
+        panelNode->SetShadowCaster(ShadowCaster::Dynamic);
+        terrainNode->AddChild(panelNode);
+        panelNodes.push_back(panelNode);
+    }
+    float panelAngle = 0.0f;
 
     // Set our SceneTree up
     renderer->setRoot(terrainNode);
@@ -123,6 +180,16 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
         // By default set the terrain node to the identity
         // matrix.
         terrainNode->GetLocalTransform().LoadIdentity();
+        // Our panels circle below the shadow casting light
+        panelAngle += 0.02f;
+        for(unsigned int i=0; i < panelNodes.size(); ++i){
+            float angle = panelAngle + i*1.5707963f;
+            Transform& world = panelNodes[i]->GetWorldTransform();
+            world.LoadIdentity();
+            world.Translate(140.0f + 25.0f*std::cos(angle), 70.0f, 400.0f + 25.0f*std::sin(angle));
+            world.Rotate(2.0f*angle, 0.0f, 1.0f, 0.0f);
+            world.Scale(6.0f, 6.0f, 6.0f);
+        }
         // Invoke(i.e. call) the callback function
         callback();
 
@@ -140,6 +207,16 @@ void SDLGraphicsProgram::SetLoopCallback(std::function<void(void)> callback){
                 int mouseY = e.motion.y;
                 renderer->GetCamera(0)->MouseLook(mouseX, mouseY);
             }
+            // 'g' switches between forward and deferred shading
+            if(e.type==SDL_KEYDOWN && e.key.keysym.sym==SDLK_g){
+                if(renderer->GetRenderPath()==RenderPath::Forward){
+                    renderer->SetRenderPath(RenderPath::Deferred);
+                    std::cout << "Render path: deferred (last frame " << renderer->GetGPUFrameTime() << " ms on the GPU)\n";
+                }else{
+                    renderer->SetRenderPath(RenderPath::Forward);
+                    std::cout << "Render path: forward (last frame " << renderer->GetGPUFrameTime() << " ms on the GPU)\n";
+                }
+            }
         } // End SDL_PollEvent loop.
 
         // Move left or right
@@ -1,24 +1,87 @@
 #include "SceneNode.hpp"
+#include "ShaderManager.hpp"
+#include "ClusteredLighting.hpp"
+#include "ShadowMaps.hpp"
 
 #include <string>
 #include <iostream>
 
 // The constructor
-SceneNode::SceneNode(std::shared_ptr<Object> ob, std::string vertShader, std::string fragShader){
+SceneNode::SceneNode(std::shared_ptr<Object> ob, std::string vertShader, std::string fragShader,
+                     const ShaderFeatures& features){
 	std::cout << "(SceneNode.cpp) Constructor called\n";
 	m_object = ob;
 
     // By default no parent.
     m_parent = nullptr;
 	
-    // Create shader
-    m_shader = std::make_shared<Shader>();
-	// Setup shaders for the node.
-	std::string vertexShader   = m_shader->LoadShader(vertShader);
-	std::string fragmentShader = m_shader->LoadShader(fragShader);
-
-	// Actually create our shader
-	m_shader->CreateShader(vertexShader,fragmentShader);       
+    // Nodes using the same shader files share one program,
+    // so only the first node pays for compiling and linking.
+    // The shader is only queued here, it is compiled along with
+    // every other queued shader at the start of the next frame.
+    m_vertShader = vertShader;
+    m_fragShader = fragShader;
+    m_passes[(int)RenderPass::Forward].features = features;
+    GetShader(RenderPass::Forward);
+
+    // The G-buffer pass only writes the surface, lighting is done later
+    ShaderFeatures gbufferFeatures = features;
+    gbufferFeatures.gbuffer    = true;
+    gbufferFeatures.clustered  = false;
+    gbufferFeatures.lightCount = 0;
+    m_passes[(int)RenderPass::GBuffer].features = gbufferFeatures;
+
+    // The shadow pass only needs positions, so every node using the
+    // same files shares one depth only shader.
+    ShaderFeatures shadowFeatures;
+    shadowFeatures.shadowPass = true;
+    shadowFeatures.lightCount = 0;
+    m_passes[(int)RenderPass::Shadow].features = shadowFeatures;
+}
+
+std::shared_ptr<Shader>& SceneNode::GetShader(RenderPass pass){
+    PassShader& passShader = m_passes[(int)pass];
+    if(passShader.shader==nullptr){
+        passShader.shader = ShaderManager::Instance().RequestShader(m_vertShader,m_fragShader,passShader.features);
+    }
+    return passShader.shader;
+}
+
+// Look up our uniforms once so Draw does not search by name.
+// This waits for the shader, so it is done the first time we
+// draw with it rather than in the constructor.
+void SceneNode::FindUniforms(PassShader& pass){
+    Shader& shader = *pass.shader;
+    pass.uniformsFound = true;
+    pass.model = shader.GetUniformHandle("model");
+
+    // Our texture slots never change, and uniforms are stored in the
+    // program, so these only need to be set once.
+    // Note that we set the value to 0, because we have bound
+    // our texture to slot 0.
+    shader.Bind();
+    // Depth only shaders sample nothing
+    if(pass.features.shadowPass){
+        return;
+    }
+    shader.SetUniform1i("u_DiffuseMap",0);  
+    // The other maps only exist in permutations that use them
+    if(pass.features.detailMap){
+        shader.SetUniform1i("u_DetailMap",1);  
+    }
+    if(pass.features.normalMap){
+        shader.SetUniform1i("u_NormalMap",2);
+    }
+    if(pass.features.clustered){
+        shader.SetUniform1i("u_ClusterLights",CLUSTER_LIGHT_SLOT);
+        shader.SetUniform1i("u_ClusterGrid",CLUSTER_GRID_SLOT);
+        shader.SetUniform1i("u_ClusterIndices",CLUSTER_INDEX_SLOT);
+    }
+    if(pass.features.shadows){
+        shader.SetUniform1i("u_CascadeShadowMap",SHADOW_CASCADE_SLOT);
+        shader.SetUniform1i("u_PointShadowMap0",SHADOW_POINT_SLOT);
+        shader.SetUniform1i("u_PointShadowMap1",SHADOW_POINT_SLOT+1);
+    }
 }
 
 // The destructor 
@@ -44,20 +107,51 @@ void SceneNode::AddChild(SceneNode* n){
 // Draw simply draws the current nodes
 // object and all of its children. This is done by calling directly
 // the objects draw method.
-void SceneNode::Draw(){
-	// Bind the shader for this node or series of nodes
-	m_shader->Bind();
+void SceneNode::Draw(RenderPass pass){
 	// Render our object
 	if(m_object!=nullptr){
-		// Render our object
-		m_object->Render();
+        DrawObject(pass);
 		// For any 'child nodes' also call the drawing routine.
 		for(int i =0; i < m_children.size(); ++i){
-			m_children[0]->Draw();
+			m_children[i]->Draw(pass);
 		}
 	}	
 }
 
+// Same traversal as Draw, but nodes casting other kinds of
+// shadows are skipped (their children may still cast).
+void SceneNode::DrawShadowCasters(ShadowCaster casters){
+	if(m_object!=nullptr){
+        if(m_shadowCaster==casters){
+            DrawObject(RenderPass::Shadow);
+        }
+		for(int i =0; i < m_children.size(); ++i){
+			m_children[i]->DrawShadowCasters(casters);
+		}
+	}	
+}
+
+void SceneNode::DrawObject(RenderPass pass){
+	// Bind the shader for this node or series of nodes
+    std::shared_ptr<Shader>& shader = GetShader(pass);
+    // Rather than stall the frame on the driver, an object whose
+    // program is still compiling is left out until it is ready.
+    // Shadow maps are cached, so they always wait.
+    if(pass!=RenderPass::Shadow && !shader->IsReady()){
+        return;
+    }
+	shader->Bind();
+    PassShader& passShader = m_passes[(int)pass];
+    if(!passShader.uniformsFound){
+        FindUniforms(passShader);
+    }
+    // Our program may be shared with other nodes, so our model
+    // matrix is set right before we draw.
+    shader->SetUniformMatrix4fv(passShader.model, &m_worldTransform.GetInternalMatrix()[0][0]);
+	// Render our object
+	m_object->Render();
+}
+
 // Update simply updates the current nodes
 // object. This is done by calling directly
 // the objects update method.
@@ -65,54 +159,13 @@ void SceneNode::Draw(){
 void SceneNode::Update(glm::mat4 projectionMatrix, Camera* camera){
     if(m_object!=nullptr){
         // TODO: Implement here!
+        // NOTE: Our program is shared with other nodes, and every Update
+        //       runs before any Draw. Anything that differs per node (like
+        //       the model matrix) must be set in Draw, not here.
     
-        m_object->Bind();
-    	// Now apply our shader 
-		m_shader->Bind();
-    	// Set the uniforms in our current shader
-
-        // For our object, we apply the texture in the following way
-        // Note that we set the value to 0, because we have bound
-        // our texture to slot 0.
-        m_shader->SetUniform1i("u_DiffuseMap",0);  
-        // TODO: This assumes every SceneNode is a 'Terrain' so this shader setup code
-        //       needs to be moved preferably to 'Object' or 'Terrain'
-        m_shader->SetUniform1i("u_DetailMap",1);  
-        // Set the MVP Matrix for our object
-        // Send it into our shader
-        m_shader->SetUniformMatrix4fv("model", &m_worldTransform.GetInternalMatrix()[0][0]);
-        m_shader->SetUniformMatrix4fv("view", &camera->GetWorldToViewmatrix()[0][0]);
-        m_shader->SetUniformMatrix4fv("projection", &projectionMatrix[0][0]);
-
-        // Create a 'light'
-        // Create a first 'light'
-        m_shader->SetUniform3f("pointLights[0].lightColor",1.0f,1.0f,1.0f);
-        m_shader->SetUniform3f("pointLights[0].lightPos",
-           camera->GetEyeXPosition() + camera->GetViewXDirection(),
-           camera->GetEyeYPosition() + camera->GetViewYDirection(),
-           camera->GetEyeZPosition() + camera->GetViewZDirection());
-        m_shader->SetUniform1f("pointLights[0].ambientIntensity",0.9f);
-        m_shader->SetUniform1f("pointLights[0].specularStrength",0.5f);
-        m_shader->SetUniform1f("pointLights[0].constant",1.0f);
-        m_shader->SetUniform1f("pointLights[0].linear",0.003f);
-        m_shader->SetUniform1f("pointLights[0].quadratic",0.0f);
-		
-		// Create a second light
-        m_shader->SetUniform3f("pointLights[1].lightColor",1.0f,0.0f,0.0f);
-        m_shader->SetUniform3f("pointLights[1].lightPos",
-           camera->GetEyeXPosition() + camera->GetViewXDirection(),
-           camera->GetEyeYPosition() + camera->GetViewYDirection(),
-           camera->GetEyeZPosition() + camera->GetViewZDirection());
-        m_shader->SetUniform1f("pointLights[1].ambientIntensity",0.9f);
-        m_shader->SetUniform1f("pointLights[1].specularStrength",0.5f);
-        m_shader->SetUniform1f("pointLights[1].constant",1.0f);
-        m_shader->SetUniform1f("pointLights[1].linear",0.09f);
-        m_shader->SetUniform1f("pointLights[1].quadratic",0.032f);
-
-	
 		// Iterate through all of the children
 		for(int i =0; i < m_children.size(); ++i){
-			m_children[0]->Update(projectionMatrix, camera);
+			m_children[i]->Update(projectionMatrix, camera);
 		}
 	}
 }
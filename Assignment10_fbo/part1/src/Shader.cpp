@@ -1,26 +1,63 @@
 #include "Shader.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "ShaderManager.hpp"
+#include "UniformBuffer.hpp"
 
 #include <iostream>
 #include <fstream>
 
+// From KHR_parallel_shader_compile, newer than our glad loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 // Constructor
 Shader::Shader(){}
 
 // Destructor
 Shader::~Shader(){
+    // Stages of a program that was never finished
+    if(m_vertexShaderID!=0){
+        glDeleteShader(m_vertexShaderID);
+    }
+    if(m_fragmentShaderID!=0){
+        glDeleteShader(m_fragmentShaderID);
+    }
 	// Deallocate Program
 	glDeleteProgram(m_shaderID);
+    if(s_boundProgram==m_shaderID){
+        s_boundProgram = 0;
+    }
 }
 
+GLuint Shader::s_boundProgram = 0;
+unsigned int Shader::s_programSwitches = 0;
+
 // Use our shader
-void Shader::Bind() const{
-	glUseProgram(m_shaderID);
+void Shader::Bind(){
+    if(m_state!=State::Ready){
+        EnsureReady();
+    }
+    if(s_boundProgram!=m_shaderID){
+	    glUseProgram(m_shaderID);
+        s_boundProgram = m_shaderID;
+        ++s_programSwitches;
+    }
 }
 
 
 // Turns off our shader
 void Shader::Unbind() const{
 	glUseProgram(0);
+    s_boundProgram = 0;
+}
+
+unsigned int Shader::GetProgramSwitchCount(){
+    return s_programSwitches;
+}
+
+void Shader::ResetStats(){
+    s_programSwitches = 0;
 }
 
 void Shader::Log(const char* system, const char* message){
@@ -51,51 +88,204 @@ std::string Shader::LoadShader(const std::string& fname){
 
 
 void Shader::CreateShader(const std::string& vertexShaderSource, const std::string& fragmentShaderSource){
+    BeginCreateShader(vertexShaderSource, fragmentShaderSource);
+    FinishCreateShader();
+}
 
+// Hands our sources to the driver. Nothing here asks for a result,
+// so a driver that compiles in the background is free to do so
+// while we submit the rest of our shaders.
+void Shader::BeginCreateShader(const std::string& vertexShaderSource, const std::string& fragmentShaderSource, uint64_t sourceHash){
     // Create a new program
     unsigned int program = glCreateProgram();
     // Compile our shaders
-    unsigned int myVertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    unsigned int myFragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+    m_vertexShaderID   = StartCompileShader(GL_VERTEX_SHADER, vertexShaderSource);
+    m_fragmentShaderID = StartCompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
     // Link our program
-    // These have been compiled already.
-    glAttachShader(program,myVertexShader);
-    glAttachShader(program,myFragmentShader);
+    glAttachShader(program,m_vertexShaderID);
+    glAttachShader(program,m_fragmentShaderID);
+    // Ask the driver to keep a binary we can cache
+    if(sourceHash!=0){
+        ProgramBinaryCache::Instance().PrepareProgram(program);
+    }
     // Link our programs that have been 'attached'
+    // (glValidateProgram is not called here, it checks the program
+    //  against the current GL state which is meaningless at load time)
     glLinkProgram(program);
-    glValidateProgram(program);
+
+    m_shaderID = program;
+    m_sourceHash = sourceHash;
+    m_state = State::Compiling;
+}
+
+void Shader::FinishCreateShader(){
+    if(m_state!=State::Compiling){
+        return;
+    }
+    // Asking for the link status waits for the driver if it is not done
+    if(!CheckLinkStatus(m_shaderID)){
+        // Find out which stage was at fault
+        CheckCompileStatus(GL_VERTEX_SHADER, m_vertexShaderID);
+        CheckCompileStatus(GL_FRAGMENT_SHADER, m_fragmentShaderID);
+        Log("CreateShader","ERROR, shader did not link! Were there compile errors in the shader?");
+    }else if(m_sourceHash!=0){
+        ProgramBinaryCache::Instance().Store(m_sourceHash, m_shaderID);
+    }
 
     // Once the shaders have been linked in, we can delete them.
-    glDetachShader(program,myVertexShader);
-    glDetachShader(program,myFragmentShader);
+    glDetachShader(m_shaderID,m_vertexShaderID);
+    glDetachShader(m_shaderID,m_fragmentShaderID);
 
-    glDeleteShader(myVertexShader);
-    glDeleteShader(myFragmentShader);
+    glDeleteShader(m_vertexShaderID);
+    glDeleteShader(m_fragmentShaderID);
+    m_vertexShaderID = 0;
+    m_fragmentShaderID = 0;
 
-    if(!CheckLinkStatus(program)){
-        Log("CreateShader","ERROR, shader did not link! Were there compile errors in the shader?");
+    m_state = State::Ready;
+    // Find all of our uniforms once, rather than every time we set one
+    ReflectUniforms();
+}
+
+bool Shader::IsReady() const{
+    if(m_state==State::Ready){
+        return true;
     }
+    if(m_state!=State::Compiling){
+        return false;
+    }
+    if(!ShaderManager::Instance().HasParallelCompile()){
+        return true;
+    }
+    GLint done = GL_FALSE;
+    glGetProgramiv(m_shaderID, GL_COMPLETION_STATUS_KHR, &done);
+    return done==GL_TRUE;
+}
 
+void Shader::EnsureReady(){
+    // Still waiting to be submitted, so send the whole batch now
+    if(m_state==State::Queued){
+        ShaderManager::Instance().SubmitPending();
+    }
+    if(m_state==State::Compiling){
+        FinishCreateShader();
+    }
+}
+
+bool Shader::CreateShaderFromCache(uint64_t sourceHash){
+    GLuint program = glCreateProgram();
+    if(!ProgramBinaryCache::Instance().Load(sourceHash, program)){
+        glDeleteProgram(program);
+        return false;
+    }
     m_shaderID = program;
+    m_state = State::Ready;
+    ReflectUniforms();
+    return true;
 }
 
+// Queries every active uniform in our program and stores
+// its location and type.
+void Shader::ReflectUniforms(){
+    m_uniforms.clear();
+    m_uniformLookup.clear();
+    m_reportedUniforms.clear();
+
+    // Attach our uniform blocks to their fixed binding points.
+    // This is part of the program, so it is done once here.
+    GLint blockCount = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    for(GLint i=0; i < blockCount; ++i){
+        GLchar blockName[256];
+        GLsizei blockNameLength = 0;
+        glGetActiveUniformBlockName(m_shaderID, i, sizeof(blockName), &blockNameLength, blockName);
+        int binding = GetUniformBlockBinding(std::string(blockName, blockNameLength));
+        if(binding < 0){
+            std::string message = " uniform block '" + std::string(blockName, blockNameLength) + "' has no binding point";
+            Log("ReflectUniforms", message.c_str());
+            continue;
+        }
+        glUniformBlockBinding(m_shaderID, i, binding);
+    }
 
-unsigned int Shader::CompileShader(unsigned int type, const std::string& source){
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    if(count <= 0){
+        return;
+    }
+
+    std::vector<GLchar> nameBuffer(maxLength+1);
+    for(GLint i=0; i < count; ++i){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_shaderID, i, nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Arrays are reported once as 'name[0]', so we also
+        // register 'name' and every element 'name[i]'.
+        std::string baseName = name;
+        if(size > 1 && baseName.size() > 3 && baseName.compare(baseName.size()-3,3,"[0]")==0){
+            baseName.erase(baseName.size()-3);
+        }
+        for(GLint element=0; element < size; ++element){
+            std::string elementName = (size > 1) ? baseName + "[" + std::to_string(element) + "]" : name;
+            GLint location = glGetUniformLocation(m_shaderID, elementName.c_str());
+            // Uniforms in uniform blocks have no location
+            if(location < 0){
+                continue;
+            }
+            m_uniformLookup[elementName] = m_uniforms.size();
+            if(element==0 && baseName!=elementName){
+                m_uniformLookup[baseName] = m_uniforms.size();
+            }
+            m_uniforms.push_back(UniformInfo{elementName, location, type});
+        }
+    }
+}
+
+UniformHandle Shader::GetUniformHandle(const std::string& name){
+    if(m_state!=State::Ready){
+        EnsureReady();
+    }
+    UniformHandle handle;
+    auto it = m_uniformLookup.find(name);
+    if(it != m_uniformLookup.end()){
+        handle.index = it->second;
+    }else if(m_reportedUniforms.insert(name).second){
+        // Only complain the first time we see a name
+        std::string message = " uniform '" + name + "' is not active in this shader (misspelled or optimized away?)";
+        Log("GetUniformHandle", message.c_str());
+    }
+    return handle;
+}
+
+GLenum Shader::GetUniformType(UniformHandle handle) const{
+    if(!handle.IsValid()){
+        return 0;
+    }
+    return m_uniforms[handle.index].type;
+}
+
+unsigned int Shader::GetUniformCount() const{
+    return m_uniforms.size();
+}
+
+
+unsigned int Shader::StartCompileShader(unsigned int type, const std::string& source){
   // Compile our shaders
   // id is the type of shader (Vertex, fragment, etc.)
-  unsigned int id;
-
-  if(type == GL_VERTEX_SHADER){
-    id = glCreateShader(GL_VERTEX_SHADER);
-  }else if(type == GL_FRAGMENT_SHADER){
-    id = glCreateShader(GL_FRAGMENT_SHADER);
-  }
+  unsigned int id = glCreateShader(type);
   const char* src = source.c_str();
   // The source of our shader
   glShaderSource(id, 1, &src, nullptr);
   // Now compile our shader
   glCompileShader(id);
+  return id;
+}
 
+bool Shader::CheckCompileStatus(unsigned int type, unsigned int id){
   // Retrieve the result of our compilation
   int result;
   // This code is returning any compilation errors that may have occurred!
@@ -114,12 +304,10 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
       }
       // Reclaim our memory
       delete[] errorMessages;
-      // Delete our broken shader
-      glDeleteShader(id);
-      return 0;
+      return false;
   }
 
-  return id;
+  return true;
 }
 
 // Check to see if linking was successful
@@ -153,27 +341,47 @@ GLuint Shader::GetID() const{
 void Shader::SetUniformMatrix4fv(const GLchar* name, const GLfloat* value){
     // Note that we are now 'looking' inside the shader for a particular
     // variable. This means the name has to exactly match!
-    GLint location = glGetUniformLocation(m_shaderID,name);
-
-    // Now update this information through our uniforms.
-    // glUniformMatrix4v means a 4x4 matrix of floats
-    glUniformMatrix4fv(location, 1, GL_FALSE, value);
+    SetUniformMatrix4fv(GetUniformHandle(name), value);
 }
 
 // Set our uniforms for our shader (Useful for a vec3).
 void Shader::SetUniform3f(const GLchar* name, float v0, float v1, float v2){
-    GLint location = glGetUniformLocation(m_shaderID,name);
-    glUniform3f(location, v0, v1, v2);
+    SetUniform3f(GetUniformHandle(name), v0, v1, v2);
 }
 
 // Sets 1 int value in our uniform (That is why the suffix is 1i).
 void Shader::SetUniform1i(const GLchar* name, int value){
-    GLint location = glGetUniformLocation(m_shaderID,name);
-    glUniform1i(location, value);
+    SetUniform1i(GetUniformHandle(name), value);
 }
 
 // Sets 1 float value in our uniform (That is why the suffix is 1f).
 void Shader::SetUniform1f(const GLchar* name, float value){
-    GLint location = glGetUniformLocation(m_shaderID,name);
-    glUniform1f(location, value);
+    SetUniform1f(GetUniformHandle(name), value);
+}
+
+// Handle versions, these go straight to OpenGL.
+// Invalid handles are ignored.
+void Shader::SetUniformMatrix4fv(UniformHandle handle, const GLfloat* value){
+    if(handle.IsValid()){
+        // glUniformMatrix4v means a 4x4 matrix of floats
+        glUniformMatrix4fv(m_uniforms[handle.index].location, 1, GL_FALSE, value);
+    }
+}
+
+void Shader::SetUniform3f(UniformHandle handle, float v0, float v1, float v2){
+    if(handle.IsValid()){
+        glUniform3f(m_uniforms[handle.index].location, v0, v1, v2);
+    }
+}
+
+void Shader::SetUniform1i(UniformHandle handle, int value){
+    if(handle.IsValid()){
+        glUniform1i(m_uniforms[handle.index].location, value);
+    }
+}
+
+void Shader::SetUniform1f(UniformHandle handle, float value){
+    if(handle.IsValid()){
+        glUniform1f(m_uniforms[handle.index].location, value);
+    }
 }
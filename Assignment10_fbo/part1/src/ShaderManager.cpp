@@ -0,0 +1,179 @@
+#include "ShaderManager.hpp"
+#include "ProgramBinaryCache.hpp"
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // This works for Mac
+    #include <SDL.h>
+#endif
+
+#include <iostream>
+#include <cstring>
+
+// KHR_parallel_shader_compile is newer than our glad loader
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+ShaderManager& ShaderManager::Instance(){
+    static ShaderManager* instance = new ShaderManager();
+    return *instance;
+}
+
+// 64-bit FNV-1a over every byte that goes into a program
+static uint64_t HashBytes(uint64_t hash, const std::string& bytes){
+    for(unsigned char c : bytes){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // Separate fields so "ab"+"c" and "a"+"bc" do not collide
+    hash ^= 0xFF;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+uint64_t ShaderManager::HashProgram(const std::string& vertex,
+                                    const std::string& fragment,
+                                    const std::vector<std::string>& defines){
+    uint64_t hash = 14695981039346656037ull;
+    hash = HashBytes(hash, vertex);
+    hash = HashBytes(hash, fragment);
+    for(const std::string& define : defines){
+        hash = HashBytes(hash, define);
+    }
+    return hash;
+}
+
+ShaderManager::ShaderSources ShaderManager::Preprocess(std::string vertPath, std::string fragPath, std::vector<std::string> defines){
+    ShaderSources result;
+    bool vertexValid   = ShaderPreprocessor::Process(vertPath, defines, result.vertex);
+    bool fragmentValid = ShaderPreprocessor::Process(fragPath, defines, result.fragment);
+    result.valid = vertexValid && fragmentValid;
+    // The final text is what the binary cache is keyed on, so an
+    // edited shader file never loads a stale binary.
+    result.hash = HashProgram(result.vertex, result.fragment, {});
+    return result;
+}
+
+std::shared_ptr<Shader> ShaderManager::RequestShader(const std::string& vertPath,
+                                                     const std::string& fragPath,
+                                                     const std::vector<std::string>& defines){
+    uint64_t key = HashProgram(vertPath, fragPath, defines);
+
+    auto it = m_shaders.find(key);
+    if(it != m_shaders.end()){
+        std::shared_ptr<Shader> existing = it->second.lock();
+        if(existing != nullptr){
+            ++m_hits;
+            return existing;
+        }
+    }
+
+    ++m_misses;
+    std::shared_ptr<Shader> shader = std::make_shared<Shader>();
+    shader->m_state = Shader::State::Queued;
+    // Reading files does not need OpenGL, so it happens on a worker thread
+    PendingShader pending;
+    pending.shader  = shader;
+    pending.key     = key;
+    pending.sources = std::async(std::launch::async, &ShaderManager::Preprocess, vertPath, fragPath, defines);
+    m_pending.push_back(std::move(pending));
+
+    m_shaders[key] = shader;
+    return shader;
+}
+
+std::shared_ptr<Shader> ShaderManager::RequestShader(const std::string& vertPath,
+                                                     const std::string& fragPath,
+                                                     const ShaderFeatures& features){
+    return RequestShader(vertPath, fragPath, features.GetDefines());
+}
+
+std::shared_ptr<Shader> ShaderManager::GetShader(const std::string& vertPath,
+                                                 const std::string& fragPath,
+                                                 const std::vector<std::string>& defines){
+    std::shared_ptr<Shader> shader = RequestShader(vertPath, fragPath, defines);
+    shader->EnsureReady();
+    return shader;
+}
+
+void ShaderManager::InitializeParallelCompile(){
+    if(m_parallelInitialized){
+        return;
+    }
+    m_parallelInitialized = true;
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    bool found = false;
+    for(GLint i=0; i < count && !found; ++i){
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(name && (std::strcmp(name,"GL_KHR_parallel_shader_compile")==0 ||
+                    std::strcmp(name,"GL_ARB_parallel_shader_compile")==0)){
+            found = true;
+        }
+    }
+    if(!found){
+        return;
+    }
+    PFNMAXSHADERCOMPILERTHREADSPROC maxThreads =
+        (PFNMAXSHADERCOMPILERTHREADSPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if(maxThreads==nullptr){
+        maxThreads = (PFNMAXSHADERCOMPILERTHREADSPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+    }
+    if(maxThreads!=nullptr){
+        // Let the driver pick how many threads to use
+        maxThreads(0xFFFFFFFF);
+    }
+    m_parallelCompile = true;
+}
+
+void ShaderManager::SubmitPending(){
+    if(m_pending.empty()){
+        return;
+    }
+    InitializeParallelCompile();
+
+    // Every file was being read at the same time, so this only
+    // waits as long as the slowest one.
+    std::vector<PendingShader> pending;
+    pending.swap(m_pending);
+    for(PendingShader& entry : pending){
+        ShaderSources sources = entry.sources.get();
+        // Never compile (or cache) a partial source. Forgetting the entry
+        // lets a later request try the files again once they are fixed.
+        if(!sources.valid){
+            std::cout << "(ShaderManager.cpp) ERROR, could not preprocess shader, it will not be created\n";
+            entry.shader->m_state = Shader::State::Failed;
+            auto it = m_shaders.find(entry.key);
+            if(it != m_shaders.end() && it->second.lock()==entry.shader){
+                m_shaders.erase(it);
+            }
+            continue;
+        }
+        // A previous run may have left us a linked binary
+        if(entry.shader->CreateShaderFromCache(sources.hash)){
+            continue;
+        }
+        entry.shader->BeginCreateShader(sources.vertex, sources.fragment, sources.hash);
+    }
+}
+
+void ShaderManager::Purge(){
+    for(auto it = m_shaders.begin(); it != m_shaders.end();){
+        if(it->second.expired()){
+            it = m_shaders.erase(it);
+        }else{
+            ++it;
+        }
+    }
+}
+
+unsigned int ShaderManager::GetProgramCount() const{
+    unsigned int count = 0;
+    for(auto& entry : m_shaders){
+        if(!entry.second.expired()){
+            ++count;
+        }
+    }
+    return count;
+}
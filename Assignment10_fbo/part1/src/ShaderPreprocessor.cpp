@@ -0,0 +1,119 @@
+#include "ShaderPreprocessor.hpp"
+#include "UniformBuffer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+// Includes nested deeper than this are most likely a cycle
+static const int MAX_INCLUDE_DEPTH = 16;
+
+std::vector<std::string> ShaderFeatures::GetDefines() const{
+    std::vector<std::string> defines;
+    int lights = std::max(0, std::min(lightCount, MAX_POINT_LIGHTS));
+    defines.push_back("LIGHT_COUNT " + std::to_string(lights));
+    if(normalMap){
+        defines.push_back("USE_NORMAL_MAP");
+    }
+    if(detailMap){
+        defines.push_back("USE_DETAIL_MAP");
+    }
+    if(clustered){
+        defines.push_back("CLUSTERED_LIGHTING");
+    }
+    if(gbuffer){
+        defines.push_back("GBUFFER_PASS");
+    }
+    if(shadowPass){
+        defines.push_back("SHADOW_PASS");
+    }
+    if(shadows){
+        defines.push_back("USE_SHADOWS");
+    }
+    return defines;
+}
+
+// Returns the directory part of a path, including the trailing '/'
+static std::string GetDirectory(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    if(slash==std::string::npos){
+        return "";
+    }
+    return path.substr(0, slash+1);
+}
+
+bool ShaderPreprocessor::Expand(const std::string& path, std::unordered_set<std::string>& included,
+                                std::string& output, int depth){
+    if(depth > MAX_INCLUDE_DEPTH){
+        std::cout << "(ShaderPreprocessor.cpp) ERROR, includes nested too deeply in " << path << "\n";
+        return false;
+    }
+    // Every file is included at most once
+    if(!included.insert(path).second){
+        return true;
+    }
+    std::ifstream file(path.c_str());
+    if(!file.is_open()){
+        std::cout << "(ShaderPreprocessor.cpp) ERROR, could not open " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file,line)){
+        // Strip carriage returns from files saved on Windows
+        if(!line.empty() && line.back()=='\r'){
+            line.pop_back();
+        }
+        size_t start = line.find_first_not_of(" \t");
+        if(start!=std::string::npos && line.compare(start, 8, "#include")==0){
+            size_t open  = line.find('"', start+8);
+            size_t close = (open==std::string::npos) ? open : line.find('"', open+1);
+            if(close==std::string::npos){
+                std::cout << "(ShaderPreprocessor.cpp) ERROR, bad #include in " << path << ": " << line << "\n";
+                return false;
+            }
+            std::string includePath = GetDirectory(path) + line.substr(open+1, close-open-1);
+            output += "// begin " + includePath + "\n";
+            if(!Expand(includePath, included, output, depth+1)){
+                return false;
+            }
+            output += "// end " + includePath + "\n";
+            continue;
+        }
+        output += line + '\n';
+    }
+    return true;
+}
+
+std::string ShaderPreprocessor::InjectDefines(const std::string& source, const std::vector<std::string>& defines){
+    if(defines.empty()){
+        return source;
+    }
+    std::string block;
+    for(const std::string& define : defines){
+        block += "#define " + define + "\n";
+    }
+    // GLSL requires #version to come first, so our defines go right after it
+    size_t versionLine = source.find("#version");
+    if(versionLine==std::string::npos){
+        return block + source;
+    }
+    size_t endOfLine = source.find('\n', versionLine);
+    if(endOfLine==std::string::npos){
+        return source + "\n" + block;
+    }
+    std::string result = source;
+    result.insert(endOfLine+1, block);
+    return result;
+}
+
+bool ShaderPreprocessor::Process(const std::string& path, const std::vector<std::string>& defines, std::string& output){
+    std::unordered_set<std::string> included;
+    std::string source;
+    if(!Expand(path, included, source, 0)){
+        output.clear();
+        return false;
+    }
+    output = InjectDefines(source, defines);
+    return true;
+}
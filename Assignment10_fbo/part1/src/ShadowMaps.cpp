@@ -0,0 +1,264 @@
+#include "ShadowMaps.hpp"
+#include "SceneNode.hpp"
+#include "GeometryArena.hpp"
+#include "ClusteredLighting.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// How much of the logarithmic split is blended with the uniform one
+static const float SHADOW_SPLIT_BLEND = 0.75f;
+// How far behind a cascade (towards the sun) casters are still drawn
+static const float SHADOW_CASTER_EXTENT = 256.0f;
+
+// The direction and up vector of each cube map face, in the order
+// of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards
+static const glm::vec3 CUBE_FACE_DIRECTIONS[6] = {
+    glm::vec3( 1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3( 0.0f, 1.0f, 0.0f), glm::vec3( 0.0f,-1.0f, 0.0f),
+    glm::vec3( 0.0f, 0.0f, 1.0f), glm::vec3( 0.0f, 0.0f,-1.0f)
+};
+static const glm::vec3 CUBE_FACE_UPS[6] = {
+    glm::vec3( 0.0f,-1.0f, 0.0f), glm::vec3( 0.0f,-1.0f, 0.0f),
+    glm::vec3( 0.0f, 0.0f, 1.0f), glm::vec3( 0.0f, 0.0f,-1.0f),
+    glm::vec3( 0.0f,-1.0f, 0.0f), glm::vec3( 0.0f,-1.0f, 0.0f)
+};
+
+ShadowMaps::ShadowMaps(){
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        m_pointLightIndex[i] = -1;
+    }
+}
+
+ShadowMaps::~ShadowMaps(){
+}
+
+void ShadowMaps::InitializeLayers(CachedMap& map, unsigned int layers, unsigned int firstPass){
+    map.matrices.assign(layers, glm::mat4(1.0f));
+    map.cachedMatrices.assign(layers, glm::mat4(1.0f));
+    map.cacheValid.assign(layers, false);
+    map.firstPass = firstPass;
+}
+
+bool ShadowMaps::Create(int cascadeSize, int cubeSize){
+    bool complete = true;
+    complete &= m_cascades.map.CreateDepthArray(cascadeSize, SHADOW_CASCADES);
+    complete &= m_cascades.cache.CreateDepthArray(cascadeSize, SHADOW_CASCADES);
+    InitializeLayers(m_cascades, SHADOW_CASCADES, 0);
+    m_cascades.active = true;
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        complete &= m_pointMaps[i].map.CreateDepthCube(cubeSize);
+        complete &= m_pointMaps[i].cache.CreateDepthCube(cubeSize);
+        InitializeLayers(m_pointMaps[i], 6, SHADOW_CASCADES + 6*i);
+    }
+    if(!complete){
+        std::cout << "(ShadowMaps.cpp) ERROR, could not create the shadow maps\n";
+        return false;
+    }
+
+    m_shadowDataBuffer.Create(sizeof(ShadowData), UniformBlockBinding::ShadowData);
+    // Every layer's matrix lives in one buffer, and the part
+    // for the layer being drawn is bound before drawing it.
+    GLint alignment = UniformBuffer::GetOffsetAlignment();
+    m_passStride = ((sizeof(ShadowPassData) + alignment - 1)/alignment)*alignment;
+    m_passData.assign(m_passStride*(SHADOW_CASCADES + 6*MAX_SHADOWED_POINT_LIGHTS), 0);
+    m_passBuffer.Create(m_passData.size(), UniformBlockBinding::ShadowPass);
+    return true;
+}
+
+void ShadowMaps::SetSun(const glm::vec3& direction, const glm::vec3& color){
+    // The cascades' matrices change with the direction,
+    // which is enough to redraw their caches.
+    m_sunDirection = glm::normalize(direction);
+    m_sunColor = color;
+}
+
+void ShadowMaps::SetPointLight(unsigned int slot, int lightIndex){
+    if(slot >= MAX_SHADOWED_POINT_LIGHTS){
+        std::cout << "(ShadowMaps.cpp) ERROR, there is no point light slot " << slot << "\n";
+        return;
+    }
+    if(m_pointLightIndex[slot]!=lightIndex){
+        m_pointLightIndex[slot] = lightIndex;
+        m_pointMaps[slot].cacheValid.assign(6, false);
+    }
+}
+
+void ShadowMaps::Invalidate(){
+    m_cascades.cacheValid.assign(m_cascades.cacheValid.size(), false);
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        m_pointMaps[i].cacheValid.assign(m_pointMaps[i].cacheValid.size(), false);
+    }
+}
+
+// Each cascade is fit around a sphere holding its slice of the view.
+// The sphere is worked out in view space from the projection alone,
+// so its size is exactly the same every frame, whichever way we look.
+void ShadowMaps::FitCascades(const glm::mat4& view, const glm::mat4& projection, ShadowData& data){
+    // Corners of the view frustum in view space, near plane first
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    glm::vec3 corners[8];
+    for(int i=0; i < 8; ++i){
+        glm::vec4 ndc((i&1) ? 1.0f : -1.0f, (i&2) ? 1.0f : -1.0f, (i&4) ? 1.0f : -1.0f, 1.0f);
+        glm::vec4 corner = inverseProjection * ndc;
+        corners[i] = glm::vec3(corner)/corner.w;
+    }
+    float zNear = -corners[0].z;
+    float zFar  = -corners[4].z;
+    float farthest = std::min(zFar, m_shadowDistance);
+
+    glm::mat4 inverseView = glm::inverse(view);
+    glm::vec3 up = std::abs(m_sunDirection.y) > 0.99f ? glm::vec3(0.0f,0.0f,1.0f) : glm::vec3(0.0f,1.0f,0.0f);
+    glm::mat4 sunView = glm::lookAt(glm::vec3(0.0f), -m_sunDirection, up);
+    int size = m_cascades.map.GetDepthSize();
+
+    float start = zNear;
+    for(int c=0; c < SHADOW_CASCADES; ++c){
+        // Blend of logarithmic and uniform splits
+        float t = (float)(c+1)/SHADOW_CASCADES;
+        float logSplit = zNear*std::pow(farthest/zNear, t);
+        float uniformSplit = zNear + (farthest-zNear)*t;
+        float end = SHADOW_SPLIT_BLEND*logSplit + (1.0f-SHADOW_SPLIT_BLEND)*uniformSplit;
+
+        // Depth grows linearly along each edge of the frustum
+        float a = (start-zNear)/(zFar-zNear);
+        float b = (end-zNear)/(zFar-zNear);
+        glm::vec3 slice[8];
+        glm::vec3 center(0.0f);
+        for(int i=0; i < 4; ++i){
+            slice[i]   = glm::mix(corners[i], corners[i+4], a);
+            slice[i+4] = glm::mix(corners[i], corners[i+4], b);
+            center += slice[i] + slice[i+4];
+        }
+        center /= 8.0f;
+        float radius = 0.0f;
+        for(int i=0; i < 8; ++i){
+            radius = std::max(radius, glm::length(slice[i]-center));
+        }
+
+        // Snapping moves the center by at most 0.18 of the padded
+        // radius, so padding by a quarter keeps the slice covered.
+        // The step is size/8 texels, so texels stay put as well.
+        float padded = radius*1.25f;
+        float step = padded*0.25f;
+        glm::vec3 sunCenter = glm::vec3(sunView * inverseView * glm::vec4(center,1.0f));
+        sunCenter = glm::floor(sunCenter/step + 0.5f)*step;
+        glm::mat4 sunProjection = glm::ortho(sunCenter.x-padded, sunCenter.x+padded,
+                                             sunCenter.y-padded, sunCenter.y+padded,
+                                             -(sunCenter.z+padded+SHADOW_CASTER_EXTENT),
+                                             -(sunCenter.z-padded));
+        m_cascades.matrices[c] = sunProjection*sunView;
+        data.cascadeViewProjection[c] = m_cascades.matrices[c];
+        data.cascadeSplits[c] = end;
+        data.cascadeTexelSize[c] = 2.0f*padded/size;
+        start = end;
+    }
+}
+
+void ShadowMaps::Update(const glm::mat4& view, const glm::mat4& projection,
+                        const std::vector<PointLightData>& lights){
+    if(m_cascades.map.GetDepthTexture()==0){
+        return;
+    }
+    ShadowData data = {};
+    FitCascades(view, projection, data);
+    data.sunDirection = glm::vec4(m_sunDirection, 0.0f);
+    data.sunColor = glm::vec4(m_sunColor, 0.0f);
+
+    int pointShadowLight[MAX_SHADOWED_POINT_LIGHTS];
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        CachedMap& map = m_pointMaps[i];
+        int index = m_pointLightIndex[i];
+        map.active = index >= 0 && index < (int)lights.size();
+        if(!map.active){
+            pointShadowLight[i] = -1;
+            continue;
+        }
+        pointShadowLight[i] = index;
+        // The cube map only needs to reach as far as the light does
+        const PointLightData& light = lights[index];
+        float farPlane = ClusteredLighting::ComputeLightRadius(light, m_shadowDistance);
+        farPlane = std::max(farPlane, 2.0f*SHADOW_POINT_NEAR);
+        glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_POINT_NEAR, farPlane);
+        for(int face=0; face < 6; ++face){
+            map.matrices[face] = faceProjection*glm::lookAt(light.lightPos,
+                                                            light.lightPos + CUBE_FACE_DIRECTIONS[face],
+                                                            CUBE_FACE_UPS[face]);
+        }
+        data.pointShadowPositionFar[i] = glm::vec4(light.lightPos, farPlane);
+    }
+    data.pointShadowLight = glm::ivec4(pointShadowLight[0], pointShadowLight[1], -1, -1);
+    m_shadowDataBuffer.Update(&data, sizeof(data));
+
+    // The matrix for every layer we might draw this frame
+    for(int c=0; c < SHADOW_CASCADES; ++c){
+        std::memcpy(&m_passData[(m_cascades.firstPass+c)*m_passStride], &m_cascades.matrices[c], sizeof(ShadowPassData));
+    }
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        for(int face=0; face < 6; ++face){
+            std::memcpy(&m_passData[(m_pointMaps[i].firstPass+face)*m_passStride], &m_pointMaps[i].matrices[face], sizeof(ShadowPassData));
+        }
+    }
+    m_passBuffer.Update(m_passData.data(), m_passData.size());
+}
+
+void ShadowMaps::RenderMap(CachedMap& map, SceneNode* root){
+    int size = map.map.GetDepthSize();
+    glViewport(0, 0, size, size);
+    for(unsigned int layer=0; layer < map.matrices.size(); ++layer){
+        m_passBuffer.BindRange((map.firstPass+layer)*m_passStride, sizeof(ShadowPassData));
+        // Static casters are only drawn when the light sees them differently
+        if(!map.cacheValid[layer] || map.cachedMatrices[layer]!=map.matrices[layer]){
+            map.cache.BindLayer(layer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            root->DrawShadowCasters(ShadowCaster::Static);
+            map.cachedMatrices[layer] = map.matrices[layer];
+            map.cacheValid[layer] = true;
+            ++m_staticLayersDrawn;
+        }
+        // Start from the static casters and add what moves
+        map.map.CopyDepthLayer(map.cache, layer);
+        map.map.BindLayer(layer);
+        root->DrawShadowCasters(ShadowCaster::Dynamic);
+        ++m_layersDrawn;
+    }
+}
+
+void ShadowMaps::Render(SceneNode* root){
+    m_layersDrawn = 0;
+    m_staticLayersDrawn = 0;
+    if(root==nullptr || m_cascades.map.GetDepthTexture()==0){
+        return;
+    }
+    // Whatever was drawn last may have left its own VAO bound
+    GeometryArena::Instance().InvalidateBindings();
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    // Slope scaled bias, steep surfaces need more
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    RenderMap(m_cascades, root);
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        if(m_pointMaps[i].active){
+            RenderMap(m_pointMaps[i], root);
+        }
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMaps::BindTextures() const{
+    glActiveTexture(GL_TEXTURE0+SHADOW_CASCADE_SLOT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_cascades.map.GetDepthTexture());
+    for(int i=0; i < MAX_SHADOWED_POINT_LIGHTS; ++i){
+        glActiveTexture(GL_TEXTURE0+SHADOW_POINT_SLOT+i);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_pointMaps[i].map.GetDepthTexture());
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
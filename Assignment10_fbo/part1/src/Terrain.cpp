@@ -82,8 +82,9 @@ void Terrain::Init(){
    // Finally generate a simple 'array of bytes' that contains
    // everything for our buffer to work with.
    m_geometry.Gen();  
-   // Create a buffer and set the stride of information
-   m_vertexBufferLayout.CreateNormalBufferLayout(m_geometry.GetBufferDataSize(),
+   // Place our geometry in the shared arena
+   m_geometryAllocation = GeometryArena::Instance().Allocate(VertexFormat::Normal,
+                                        m_geometry.GetBufferDataSize(),
                                         m_geometry.GetIndicesSize(),
                                         m_geometry.GetBufferDataPtr(),
                                         m_geometry.GetIndicesDataPtr());
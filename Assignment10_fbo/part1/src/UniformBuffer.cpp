@@ -0,0 +1,71 @@
+#include "UniformBuffer.hpp"
+
+#include <iostream>
+
+int GetUniformBlockBinding(const std::string& blockName){
+    if(blockName=="FrameData"){
+        return (int)UniformBlockBinding::FrameData;
+    }
+    if(blockName=="LightData"){
+        return (int)UniformBlockBinding::LightData;
+    }
+    if(blockName=="ShadowData"){
+        return (int)UniformBlockBinding::ShadowData;
+    }
+    if(blockName=="ShadowPass"){
+        return (int)UniformBlockBinding::ShadowPass;
+    }
+    return -1;
+}
+
+UniformBuffer::UniformBuffer(){
+}
+
+UniformBuffer::~UniformBuffer(){
+    Destroy();
+}
+
+void UniformBuffer::Create(GLsizeiptr size, UniformBlockBinding binding){
+    Destroy();
+    m_size = size;
+    m_binding = (GLuint)binding;
+    glGenBuffers(1, &m_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    // The buffer stays attached to its binding point, so every
+    // shader using this block sees it without any further work.
+    glBindBufferBase(GL_UNIFORM_BUFFER, (GLuint)binding, m_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::Update(const void* data, GLsizeiptr size){
+    if(m_id==0 || size > m_size){
+        std::cout << "(UniformBuffer.cpp) ERROR, update does not fit in buffer\n";
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::BindRange(GLintptr offset, GLsizeiptr size){
+    if(m_id==0 || offset+size > m_size){
+        std::cout << "(UniformBuffer.cpp) ERROR, range does not fit in buffer\n";
+        return;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, m_binding, m_id, offset, size);
+}
+
+GLint UniformBuffer::GetOffsetAlignment(){
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+void UniformBuffer::Destroy(){
+    if(m_id!=0){
+        glDeleteBuffers(1, &m_id);
+        m_id = 0;
+        m_size = 0;
+    }
+}
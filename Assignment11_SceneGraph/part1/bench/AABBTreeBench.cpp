@@ -0,0 +1,235 @@
+/** @file AABBTreeBench.cpp
+ *  @brief Times DynamicAABBTree queries against a linear scan.
+ *
+ *  For each proxy count, small random boxes are spread through a cube
+ *  that grows with the count, so every tree is about as crowded. Then
+ *  the tree is built, moved a little, and asked ray, frustum, sphere
+ *  and nearest neighbour queries. The same queries are answered by
+ *  testing every box, which both checks the tree's answers and shows
+ *  what the tree saves.
+ *
+ *  Build and run from part1 with: python3 bench/build.py
+ *  Usage: ./bench/bin/aabbtreebench [proxyCount...]   (default 100000 1000000)
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "DynamicAABBTree.hpp"
+#include "Bounds.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Queries timed against the tree, and how many of them the linear scan repeats
+static const unsigned int QUERIES      = 1000;
+static const unsigned int SCAN_QUERIES = 20;
+// Neighbours found by each nearest neighbour query
+static const unsigned int NEAREST_K    = 8;
+
+// Everything a query needs, made up front so only the query is timed
+struct QuerySet{
+    std::vector<glm::vec3> rayOrigins;
+    std::vector<glm::vec3> rayDirections;
+    std::vector<Frustum> frustums;
+    std::vector<glm::vec3> points;
+};
+
+// Microseconds since 'start'
+static double MicrosecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count();
+}
+
+// Prints one row of the table, times are per query
+static void Report(const char* name, double treeUs, double scanUs, double visits, bool correct){
+    std::cout << "  " << name << ": tree " << treeUs << " us, scan " << scanUs << " us ("
+              << scanUs/treeUs << "x), " << visits << " nodes visited"
+              << (correct ? "" : "  MISMATCH") << "\n";
+}
+
+// Returns false when any query disagreed with the linear scan
+static bool Run(unsigned int count){
+    std::mt19937 random(count);
+    std::uniform_real_distribution<float> unit(0.0f,1.0f);
+    // About one box per 1000 cubic units, whatever the count
+    float worldSize = 10.0f*std::cbrt((float)count);
+    float queryRadius = 20.0f;
+    auto randomPoint = [&](){
+        return glm::vec3(unit(random),unit(random),unit(random))*worldSize;
+    };
+
+    std::vector<AABB> boxes(count);
+    for(unsigned int i=0; i < count; ++i){
+        glm::vec3 center = randomPoint();
+        glm::vec3 extents = glm::vec3(0.5f)+glm::vec3(unit(random),unit(random),unit(random))*2.0f;
+        boxes[i].min = center-extents;
+        boxes[i].max = center+extents;
+    }
+
+    std::cout << count << " proxies\n";
+    DynamicAABBTree tree;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> proxies(count);
+    for(unsigned int i=0; i < count; ++i){
+        proxies[i] = tree.CreateProxy(boxes[i],nullptr);
+    }
+    std::cout << "  build: " << MicrosecondsSince(start)/1000.0 << " ms, height " << tree.GetHeight() << "\n";
+
+    // Every box takes a small step, some leave their fat box
+    start = std::chrono::steady_clock::now();
+    unsigned int reinserted = 0;
+    for(unsigned int i=0; i < count; ++i){
+        glm::vec3 step = (glm::vec3(unit(random),unit(random),unit(random))-0.5f)*0.3f;
+        boxes[i].min += step;
+        boxes[i].max += step;
+        reinserted += tree.MoveProxy(proxies[i],boxes[i],step) ? 1 : 0;
+    }
+    std::cout << "  move: " << MicrosecondsSince(start)/1000.0 << " ms, "
+              << reinserted << " reinserted\n";
+
+    QuerySet queries;
+    for(unsigned int q=0; q < QUERIES; ++q){
+        glm::vec3 origin = randomPoint();
+        glm::vec3 target = randomPoint();
+        queries.rayOrigins.push_back(origin);
+        queries.rayDirections.push_back(glm::normalize(target-origin));
+        // A camera looking at a random point, seeing about as far as the query radius times ten
+        glm::mat4 view = glm::lookAt(origin,target,glm::vec3(0.0f,1.0f,0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f),16.0f/9.0f,0.1f,queryRadius*10.0f);
+        Frustum frustum;
+        frustum.ExtractPlanes(projection*view);
+        queries.frustums.push_back(frustum);
+        queries.points.push_back(target);
+    }
+
+    bool allCorrect = true;
+    std::vector<int> results;
+    double visits = 0.0;
+
+    // Raycasts
+    std::vector<float> treeHits(QUERIES);
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < QUERIES; ++q){
+        treeHits[q] = -1.0f;
+        tree.Raycast(queries.rayOrigins[q],queries.rayDirections[q],worldSize*2.0f,&treeHits[q]);
+        visits += tree.GetLastQueryVisitCount();
+    }
+    double treeUs = MicrosecondsSince(start)/QUERIES;
+    bool correct = true;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < SCAN_QUERIES; ++q){
+        glm::vec3 inverseDirection = 1.0f/queries.rayDirections[q];
+        float best = worldSize*2.0f;
+        bool hit = false;
+        for(unsigned int i=0; i < count; ++i){
+            float distance;
+            if(boxes[i].IntersectRay(queries.rayOrigins[q],inverseDirection,best,distance)){
+                best = distance;
+                hit = true;
+            }
+        }
+        correct = correct && (hit ? std::abs(best-treeHits[q]) < 1e-3f : treeHits[q] < 0.0f);
+    }
+    Report("raycast",treeUs,MicrosecondsSince(start)/SCAN_QUERIES,visits/QUERIES,correct);
+    allCorrect = allCorrect && correct;
+
+    // Frustums
+    std::vector<unsigned int> treeCounts(QUERIES);
+    visits = 0.0;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < QUERIES; ++q){
+        results.clear();
+        tree.QueryFrustum(queries.frustums[q],results);
+        treeCounts[q] = results.size();
+        visits += tree.GetLastQueryVisitCount();
+    }
+    treeUs = MicrosecondsSince(start)/QUERIES;
+    correct = true;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < SCAN_QUERIES; ++q){
+        unsigned int found = 0;
+        for(unsigned int i=0; i < count; ++i){
+            found += queries.frustums[q].TestAABB(boxes[i])!=Containment::Outside ? 1 : 0;
+        }
+        correct = correct && found==treeCounts[q];
+    }
+    Report("frustum",treeUs,MicrosecondsSince(start)/SCAN_QUERIES,visits/QUERIES,correct);
+    allCorrect = allCorrect && correct;
+
+    // Spheres
+    visits = 0.0;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < QUERIES; ++q){
+        results.clear();
+        tree.QuerySphere(queries.points[q],queryRadius,results);
+        treeCounts[q] = results.size();
+        visits += tree.GetLastQueryVisitCount();
+    }
+    treeUs = MicrosecondsSince(start)/QUERIES;
+    correct = true;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < SCAN_QUERIES; ++q){
+        unsigned int found = 0;
+        for(unsigned int i=0; i < count; ++i){
+            found += boxes[i].DistanceSquared(queries.points[q]) <= queryRadius*queryRadius ? 1 : 0;
+        }
+        correct = correct && found==treeCounts[q];
+    }
+    Report("sphere",treeUs,MicrosecondsSince(start)/SCAN_QUERIES,visits/QUERIES,correct);
+    allCorrect = allCorrect && correct;
+
+    // Nearest neighbours, checked by the distance of the k-th one
+    std::vector<float> treeKth(QUERIES);
+    visits = 0.0;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < QUERIES; ++q){
+        results.clear();
+        tree.QueryNearest(queries.points[q],NEAREST_K,results);
+        treeKth[q] = results.empty() ? -1.0f : tree.GetTightAABB(results.back()).DistanceSquared(queries.points[q]);
+        visits += tree.GetLastQueryVisitCount();
+    }
+    treeUs = MicrosecondsSince(start)/QUERIES;
+    correct = true;
+    std::vector<float> distances(count);
+    start = std::chrono::steady_clock::now();
+    for(unsigned int q=0; q < SCAN_QUERIES; ++q){
+        for(unsigned int i=0; i < count; ++i){
+            distances[i] = boxes[i].DistanceSquared(queries.points[q]);
+        }
+        unsigned int k = std::min(NEAREST_K,count);
+        std::nth_element(distances.begin(),distances.begin()+(k-1),distances.end());
+        correct = correct && std::abs(distances[k-1]-treeKth[q]) < 1e-3f;
+    }
+    Report("nearest",treeUs,MicrosecondsSince(start)/SCAN_QUERIES,visits/QUERIES,correct);
+    allCorrect = allCorrect && correct;
+
+    return allCorrect;
+}
+
+int main(int argc, char** argv){
+    std::vector<unsigned int> counts;
+    for(int i=1; i < argc; ++i){
+        int count = std::atoi(argv[i]);
+        if(count <= 0){
+            std::cout << "Usage: ./bench/bin/aabbtreebench [proxyCount...]\n";
+            return 1;
+        }
+        counts.push_back(count);
+    }
+    if(counts.empty()){
+        counts.push_back(100000);
+        counts.push_back(1000000);
+    }
+    bool allCorrect = true;
+    for(unsigned int i=0; i < counts.size(); ++i){
+        allCorrect = Run(counts[i]) && allCorrect;
+    }
+    return allCorrect ? 0 : 1;
+}
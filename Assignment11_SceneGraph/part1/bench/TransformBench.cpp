@@ -0,0 +1,167 @@
+/** @file TransformBench.cpp
+ *  @brief Times world matrix updates of a large SceneNode tree.
+ *
+ *  Builds one tree of SceneNodes (without objects, so no OpenGL is
+ *  needed) where every node has the same number of children, and
+ *  recomputes every world matrix in each pass:
+ *
+ *      glm       - glm's 4x4 product, one node at a time over plain
+ *                  arrays in breadth first order (the reference)
+ *      SceneNode - SceneNode::Update after the root changed, following
+ *                  pointers from node to node
+ *      flat      - FlatSceneGraph::UpdateWorldMatrices, four nodes at
+ *                  a time with SSE over the same tree breadth first
+ *      flat+copy - FlatSceneGraph::Update, which also copies the local
+ *                  transforms in and the world transforms and bounds
+ *                  back out. This is what the Renderer does when the
+ *                  root moves, so it is the fair comparison with SceneNode.
+ *
+ *  Build and run from part1 with: python3 bench/build.py
+ *  Usage: ./bench/bin/transformbench [nodes] [childrenPerNode] [passes]
+ *         (default 1000000 100 10)
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "SceneNode.hpp"
+#include "FlatSceneGraph.hpp"
+#include "JobSystem.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Milliseconds per pass of 'update'
+template<typename F>
+static double Time(unsigned int passes, F update){
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned int i=0; i < passes; ++i){
+        update();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double,std::milli>(end-start).count()/passes;
+}
+
+// Largest difference between two matrices
+static float MaxError(const glm::mat4& a, const glm::mat4& b){
+    float error = 0.0f;
+    for(int j=0; j < 4; ++j){
+        for(int i=0; i < 4; ++i){
+            error = std::max(error,std::abs(a[j][i]-b[j][i]));
+        }
+    }
+    return error;
+}
+
+int main(int argc, char** argv){
+    unsigned int count    = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    unsigned int children = argc > 2 ? std::atoi(argv[2]) : 100;
+    unsigned int passes   = argc > 3 ? std::atoi(argv[3]) : 10;
+    if(count==0 || children==0 || passes==0 || count > Pool<SceneNode>::MAX_OBJECTS){
+        std::cout << "Usage: ./bench/bin/transformbench [nodes] [childrenPerNode] [passes]\n"
+                  << "       at most " << Pool<SceneNode>::MAX_OBJECTS << " nodes\n";
+        return 1;
+    }
+    JobSystem::Instance().Initialize();
+
+    // Node n's parent is (n-1)/children, so nodes are numbered breadth first
+    // and the tree is the same one FlatSceneGraph will build.
+    // Every node reports its construction, which we do not want a million of.
+    std::streambuf* output = std::cout.rdbuf(nullptr);
+    SceneNode::Reserve(count);
+    std::vector<SceneNode*> nodes(count);
+    std::vector<int> parents(count,-1);
+    std::vector<glm::mat4> locals(count);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+    for(unsigned int n=0; n < count; ++n){
+        NodeHandle handle = SceneNode::Create(nullptr);
+        nodes[n] = SceneNode::Get(handle);
+        Transform& local = nodes[n]->GetLocalTransform();
+        local.Translate(unit(random)*10.0f,unit(random)*10.0f,unit(random)*10.0f);
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(random),unit(random),unit(random))+0.01f);
+        local.Rotate(unit(random)*3.14f,axis.x,axis.y,axis.z);
+        float scale = 1.0f+0.5f*unit(random);
+        local.Scale(scale,scale,scale);
+        locals[n] = local.GetInternalMatrix();
+        if(n > 0){
+            parents[n] = (n-1)/children;
+            if((n-1)%children==0){
+                nodes[parents[n]]->ReserveChildren(children);
+            }
+            nodes[parents[n]]->AddChild(handle);
+        }
+    }
+    std::cout.rdbuf(output);
+    SceneNode* root = nodes[0];
+    unsigned int levels = 1;
+    for(unsigned int n=count-1; n > 0; n = parents[n]){
+        ++levels;
+    }
+    std::cout << count << " nodes, " << children << " children per node, "
+              << levels << " levels, " << passes << " passes, "
+              << JobSystem::Instance().GetThreadCount() << " threads\n";
+
+    std::vector<glm::mat4> reference(count);
+    double glmMs = Time(passes,[&](){
+        reference[0] = locals[0];
+        for(unsigned int n=1; n < count; ++n){
+            reference[n] = reference[parents[n]]*locals[n];
+        }
+    });
+    double sceneNodeMs = Time(passes,[&](){
+        // Touching the root's transform moves every node
+        root->MarkDirty();
+        root->Update();
+    });
+    // Every path must agree with glm
+    float sceneNodeError = 0.0f;
+    for(unsigned int n=0; n < count; ++n){
+        sceneNodeError = std::max(sceneNodeError,MaxError(nodes[n]->GetWorldTransform().GetInternalMatrix(),reference[n]));
+    }
+
+    FlatSceneGraph flat;
+    auto start = std::chrono::steady_clock::now();
+    flat.Build(root);
+    double buildMs = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+    if(!flat.GatherLocalTransforms()){
+        std::cout << "(TransformBench.cpp) ERROR, the flat view could not hold a local transform\n";
+        return 1;
+    }
+    double flatMs = Time(passes,[&](){
+        flat.UpdateWorldMatrices();
+    });
+    double flatCopyMs = Time(passes,[&](){
+        root->MarkDirty();
+        flat.Update();
+    });
+
+    // The flat view must hold the nodes in the same order we numbered
+    // them, and copy the same world transforms back out
+    float flatError = 0.0f;
+    bool sameOrder = flat.GetNodeCount()==count;
+    for(unsigned int n=0; n < count && sameOrder; ++n){
+        sameOrder = flat.GetNode(n)==nodes[n];
+        flatError = std::max(flatError,MaxError(flat.GetWorldMatrix(n),reference[n]));
+        flatError = std::max(flatError,MaxError(nodes[n]->GetWorldTransform().GetInternalMatrix(),reference[n]));
+    }
+
+    std::cout << "flat build: " << buildMs << " ms, once per change of the tree's shape\n";
+    std::cout << "glm:        " << glmMs << " ms per pass\n";
+    std::cout << "SceneNode:  " << sceneNodeMs << " ms per pass, max error " << sceneNodeError << "\n";
+    std::cout << "flat:       " << flatMs << " ms per pass (" << sceneNodeMs/flatMs << "x SceneNode), max error " << flatError << "\n";
+    std::cout << "flat+copy:  " << flatCopyMs << " ms per pass (" << sceneNodeMs/flatCopyMs << "x SceneNode)\n";
+    if(!sameOrder){
+        std::cout << "(TransformBench.cpp) ERROR, the flat view is not in breadth first order\n";
+    }
+
+    JobSystem::Instance().Shutdown();
+    return (sameOrder && sceneNodeError < 1e-2f && flatError < 1e-2f) ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+# Builds and runs the benchmarks. Run from part1 with: python3 bench/build.py
+# The executables go in bench/bin/, which git ignores.
+# Only the sources each benchmark needs are built. The transform benchmark uses
+# SceneNodes, which bring in Object and Shader, so it links SDL but never opens
+# a window or makes an OpenGL call.
+import os
+import platform
+import sys
+
+# (1)==================== COMMON CONFIGURATION OPTIONS ======================= #
+COMPILER="g++ -O2 -std=c++17"   # Benchmarks are only meaningful when optimized
+OUTPUT_DIR="./bench/bin/"
+# SceneNode and everything it uses
+SCENE_SOURCES=["./src/SceneNode.cpp", "./src/FlatSceneGraph.cpp", "./src/Transform.cpp",
+               "./src/JobSystem.cpp", "./src/Bounds.cpp", "./src/RenderQueue.cpp",
+               "./src/OcclusionCuller.cpp", "./src/Object.cpp", "./src/Shader.cpp",
+               "./src/Texture.cpp", "./src/Image.cpp", "./src/Geometry.cpp",
+               "./src/VertexBufferLayout.cpp", "./src/glad.cpp"]
+# Each benchmark and the sources from src/ it needs
+BENCHMARKS={
+    "transformbench": ["./bench/TransformBench.cpp"]+SCENE_SOURCES,
+    "aabbtreebench": ["./bench/AABBTreeBench.cpp", "./src/DynamicAABBTree.cpp", "./src/Bounds.cpp"],
+}
+# ======================= COMMON CONFIGURATION OPTIONS ======================= #
+
+# (2)=================== Platform specific configuration ===================== #
+ARGUMENTS=""
+INCLUDE_DIR=""
+LIBRARIES=""
+EXTENSION=""
+
+if platform.system()=="Linux":
+    ARGUMENTS="-D LINUX"
+    INCLUDE_DIR="-I ./include/ -I ./../../common/thirdparty/glm/"
+    LIBRARIES="-lSDL2 -ldl -lpthread"
+elif platform.system()=="Darwin":
+    ARGUMENTS="-D MAC"
+    INCLUDE_DIR="-I ./include/ -I/Library/Frameworks/SDL2.framework/Headers -I./../../common/thirdparty/old/glm"
+    LIBRARIES="-F/Library/Frameworks -framework SDL2"
+elif platform.system()=="Windows":
+    ARGUMENTS="-D MINGW -static-libgcc -static-libstdc++"
+    INCLUDE_DIR="-I./include/ -I./../../common/thirdparty/old/glm/"
+    EXTENSION=".exe"
+    LIBRARIES="-lmingw32 -lSDL2main -lSDL2"
+# (2)=================== Platform specific configuration ===================== #
+
+# (3)==================== Building and running ============================== #
+os.makedirs(OUTPUT_DIR, exist_ok=True)
+for name, sources in BENCHMARKS.items():
+    executable=OUTPUT_DIR+name+EXTENSION
+    compileString=COMPILER+" "+ARGUMENTS+" "+" ".join(sources)+" -o "+executable+" "+INCLUDE_DIR+" "+LIBRARIES
+    print(compileString)
+    if os.system(compileString)!=0:
+        sys.exit(1)
+    print("==================== "+name+" ====================")
+    os.system(executable)
+# (3)==================== Building and running ============================== #
@@ -0,0 +1,119 @@
+/** @file Animator.hpp
+ *  @brief Plays keyframe animation on scene nodes.
+ *
+ *  A track holds keyframes for the translation, rotation or scale of one
+ *  node. Every frame each track finds the two keys around the current
+ *  time (starting from where it was last frame, so this is usually one
+ *  comparison), and the pairs of keys are gathered into arrays, one per
+ *  component (structure of arrays). The blends are then done four tracks
+ *  at a time with SSE: lerp for translation and scale, slerp for
+ *  rotation.
+ *
+ *  Finally each animated node gets the new position, rotation and scale
+ *  of its local transform. Parts without a track keep the value the node
+ *  had when it was first animated. Only animated nodes are marked dirty.
+ *
+ *  @author Mike
+ *  @bug Nodes are assumed to have no shear, as their starting local
+ *       transform is split into translation, rotation and scale.
+ */
+#ifndef ANIMATOR_HPP
+#define ANIMATOR_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneNode.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+// Which part of a transform a track animates
+enum class TrackType : unsigned int{
+    Translation=0,
+    Rotation,
+    Scale
+};
+
+class Animator{
+public:
+    // Constructor
+    Animator();
+    // Adds a track. 'times' are in seconds and must increase.
+    // Returns the track's index, or -1 if the keys are unusable.
+    int AddTranslationTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::vec3>& values);
+    int AddRotationTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::quat>& values);
+    int AddScaleTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::vec3>& values);
+    // Removes every track
+    void Clear();
+    // Advances time and applies every track
+    void Update(float deltaSeconds);
+    // Jumps to a point in time. Applied on the next Update.
+    void SetTime(float seconds) { m_time = seconds; }
+    float GetTime() const { return m_time; }
+    // Looping tracks start over after their last key,
+    // otherwise they hold it
+    void SetLooping(bool looping) { m_looping = looping; }
+
+    // Statistics
+    unsigned int GetTrackCount() const { return m_tracks.size(); }
+    unsigned int GetNodeCount() const { return m_targets.size(); }
+    // Time the last Update took
+    double GetLastUpdateTime() const { return m_lastUpdateMs; }
+
+private:
+    struct Track{
+        // Keys are m_keyTimes/m_keyValues[firstKey, firstKey+keyCount)
+        uint32_t firstKey;
+        uint32_t keyCount;
+        // Key at or before the time of the last Update
+        uint32_t cursor;
+        // Index into m_targets
+        uint32_t target;
+        TrackType type;
+    };
+    // A node being animated and its current translation, rotation and scale
+    struct Target{
+        NodeHandle node;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+    // Pairs of keys to blend, one array per component
+    struct Batch{
+        std::vector<float> ax, ay, az, aw;
+        std::vector<float> bx, by, bz, bw;
+        std::vector<float> t;
+        std::vector<uint32_t> track;
+        unsigned int count{0};
+        // Starts a new frame with room for 'tracks' pairs
+        void Reset(unsigned int tracks);
+        void Add(uint32_t trackIndex, const glm::vec4& a, const glm::vec4& b, float alpha);
+        // Pads with empty entries up to a multiple of four
+        void Pad();
+    };
+    // Shared part of the Add*Track functions
+    int AddTrack(NodeHandle node, TrackType type, const std::vector<float>& times, const glm::vec4* values);
+    // Finds the key at or before 'time', starting from the track's cursor
+    uint32_t FindKey(Track& track, float time);
+    // out = a+(b-a)*t, four at a time
+    static void LerpBatch(Batch& batch);
+    // Spherical interpolation of normalized quaternions, four at a time
+    static void SlerpBatch(Batch& batch);
+    std::vector<Track> m_tracks;
+    std::vector<Target> m_targets;
+    // Handle value to index in m_targets
+    std::unordered_map<uint32_t, uint32_t> m_targetIndices;
+    // Every track's keys, back to back
+    std::vector<float> m_keyTimes;
+    std::vector<glm::vec4> m_keyValues;
+    // Rebuilt every Update
+    Batch m_lerp;
+    Batch m_slerp;
+    float m_time{0.0f};
+    bool m_looping{true};
+    double m_lastUpdateMs{0.0};
+};
+
+#endif
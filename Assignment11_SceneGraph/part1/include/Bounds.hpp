@@ -0,0 +1,86 @@
+/** @file Bounds.hpp
+ *  @brief Bounding volumes and a view frustum to test them against.
+ *
+ *  AABB and BoundingSphere describe the space an object (or a whole
+ *  subtree of the scene) occupies. Frustum holds the six planes of a
+ *  camera's view volume and tests boxes against them, four at a time
+ *  when SSE is available.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include "glm/glm.hpp"
+
+// An axis aligned bounding box.
+// A default constructed box is empty and contains nothing.
+struct AABB{
+    glm::vec3 min{ 1e30f, 1e30f, 1e30f};
+    glm::vec3 max{-1e30f,-1e30f,-1e30f};
+    // False for an empty box
+    bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    // Grows the box to contain a point
+    void Expand(const glm::vec3& point);
+    // Grows the box to contain another box
+    void Expand(const AABB& box);
+    glm::vec3 GetCenter() const { return (min+max)*0.5f; }
+    glm::vec3 GetExtents() const { return (max-min)*0.5f; }
+    // Returns the box around this box after it is transformed
+    AABB Transformed(const glm::mat4& m) const;
+    // True when 'box' is completely within this box
+    bool Contains(const AABB& box) const;
+    // True when the two boxes touch
+    bool Overlaps(const AABB& box) const;
+    // Squared distance from a point to the box (0 when inside)
+    float DistanceSquared(const glm::vec3& point) const;
+    // Used to judge how good a bounding volume hierarchy is
+    float GetSurfaceArea() const;
+    // Where a ray first enters the box, if it hits within
+    // [0,maxDistance]. 'inverseDirection' is 1/direction.
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection,
+                      float maxDistance, float& hitDistance) const;
+    // The box around two boxes
+    static AABB Union(const AABB& a, const AABB& b);
+};
+
+// A bounding sphere.
+// A negative radius means the sphere is empty.
+struct BoundingSphere{
+    glm::vec3 center{0.0f,0.0f,0.0f};
+    float radius{-1.0f};
+    bool IsValid() const { return radius >= 0.0f; }
+    // The sphere that just contains a box
+    static BoundingSphere FromAABB(const AABB& box);
+    // Grows the sphere to contain another sphere
+    void Expand(const BoundingSphere& sphere);
+    // Returns the sphere around this sphere after it is transformed
+    BoundingSphere Transformed(const glm::mat4& m) const;
+};
+
+// Where a volume is relative to a frustum
+enum class Containment{
+    Outside=0,
+    Intersecting,
+    Inside
+};
+
+// The six planes of a view volume, pointing inwards.
+// Each plane is (normal, distance) so that dot(normal,p)+distance >= 0
+// for points on the inside.
+struct Frustum{
+    enum Plane{ Left=0, Right, Bottom, Top, Near, Far, Count };
+    glm::vec4 planes[Count];
+    // Extracts the planes from a projection*view matrix
+    void ExtractPlanes(const glm::mat4& viewProjection);
+    // Tests a single box
+    Containment TestAABB(const AABB& box) const;
+    // Tests 'count' boxes, writing one result per box.
+    // Boxes are tested four at a time when SSE is available.
+    void TestAABBs(const AABB* const* boxes, unsigned int count, Containment* results) const;
+    // Tests a sphere
+    Containment TestSphere(const BoundingSphere& sphere) const;
+};
+
+#endif
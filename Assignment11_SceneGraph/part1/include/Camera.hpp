@@ -1,9 +1,17 @@
 /** @file Camera.hpp
  *  @brief Sets up an OpenGL camera.
- *  
+ *
  *  Sets up an OpenGL Camera. The camera is what
  *  sets up our 'view' matrix.
  *
+ *  The view, projection and view-projection matrices and the frustum
+ *  are worked out once after the camera changes and cached, so everyone
+ *  asking for them in a frame shares the same copies.
+ *
+ *  The projection can be jittered by a fraction of a pixel each frame
+ *  for temporal techniques (e.g. anti-aliasing). The frustum is always
+ *  built without the jitter so culling stays stable from frame to frame.
+ *
  *  @author Mike
  *  @bug No known bugs.
  */
@@ -12,13 +20,31 @@
 
 #include "glm/glm.hpp"
 
+#include "Bounds.hpp"
+
 class Camera{
 public:
 	// Constructor to create a camera
     Camera();
     // Return a 'view' matrix with our
     // camera transformation applied.
-    glm::mat4 GetWorldToViewmatrix() const;
+    const glm::mat4& GetWorldToViewmatrix() const;
+    // The projection, with the jitter applied
+    const glm::mat4& GetProjectionMatrix() const;
+    // Projection * view, with the jitter applied
+    const glm::mat4& GetViewProjectionMatrix() const;
+    // What the camera can see, without the jitter
+    const Frustum& GetFrustum() const;
+    // Sets up a perspective projection for a viewport
+    // of 'width' by 'height' pixels
+    void SetPerspective(float fovYRadians, unsigned int width, unsigned int height,
+                        float nearPlane, float farPlane);
+    // Shifts the projection by a fraction of a pixel
+    void SetJitter(float x, float y);
+    const glm::vec2& GetJitter() const { return m_jitter; }
+    // The i'th point of a Halton(2,3) sequence, centered on zero.
+    // Good jitter offsets, as they spread evenly over a pixel.
+    static glm::vec2 HaltonJitter(unsigned int index);
     // Move the camera around
     void MouseLook(int mouseX, int mouseY);
     void MoveForward(float speed);
@@ -29,19 +55,26 @@ public:
     void MoveDown(float speed);
     // Set the position for the camera
     void SetCameraEyePosition(float x, float y, float z);
-    // Returns the Camera X Position where the eye is 
-    float GetEyeXPosition();
-    // Returns the Camera Y Position where the eye is 
-    float GetEyeYPosition();
-    // Returns the Camera Z Position where the eye is 
-    float GetEyeZPosition();
+    // Turns the camera to face a point
+    void LookAt(float x, float y, float z);
+    // Where the eye is and which way it looks
+    const glm::vec3& GetEyePosition() const { return m_eyePosition; }
+    const glm::vec3& GetViewDirection() const { return m_viewDirection; }
+    // Returns the Camera X Position where the eye is
+    float GetEyeXPosition() const;
+    // Returns the Camera Y Position where the eye is
+    float GetEyeYPosition() const;
+    // Returns the Camera Z Position where the eye is
+    float GetEyeZPosition() const;
 	// Returns the X 'view' direction
-    float GetViewXDirection();
+    float GetViewXDirection() const;
     // Returns the Y 'view' direction
-    float GetViewYDirection();
+    float GetViewYDirection() const;
     // Returns the Z 'view' direction
-    float GetViewZDirection();
+    float GetViewZDirection() const;
 private:
+    // Rebuilds whatever is out of date
+    void UpdateMatrices() const;
 
     // Track the old mouse position
     glm::vec2 m_oldMousePosition;
@@ -54,6 +87,22 @@ private:
     // to 'rock' or 'rattle' the camera you might play
     // with modifying this value.
     glm::vec3 m_upVector;
+    // Perspective projection
+    float m_fovY;
+    unsigned int m_width;
+    unsigned int m_height;
+    float m_nearPlane;
+    float m_farPlane;
+    // Offset of the projection in pixels
+    glm::vec2 m_jitter{0.0f,0.0f};
+    // Cached results, rebuilt when the flags below are set
+    mutable glm::mat4 m_view;
+    mutable glm::mat4 m_unjitteredProjection;
+    mutable glm::mat4 m_projection;
+    mutable glm::mat4 m_viewProjection;
+    mutable Frustum m_frustum;
+    mutable bool m_viewDirty{true};
+    mutable bool m_projectionDirty{true};
 };
 
 
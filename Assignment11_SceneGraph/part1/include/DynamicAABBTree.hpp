@@ -0,0 +1,108 @@
+/** @file DynamicAABBTree.hpp
+ *  @brief A bounding volume hierarchy that objects can move around in.
+ *
+ *  Each object (a 'proxy') is a leaf holding a slightly enlarged
+ *  ('fat') copy of its box. Small movements that stay within the fat
+ *  box cost nothing, larger ones remove and reinsert the leaf. Leaves
+ *  are inserted next to the sibling that grows the tree's surface area
+ *  the least, and the tree is kept balanced with AVL style rotations.
+ *
+ *  Answers ray, frustum, box, sphere and nearest neighbour queries
+ *  without walking every object.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef DYNAMICAABBTREE_HPP
+#define DYNAMICAABBTREE_HPP
+
+#include <vector>
+
+#include "Bounds.hpp"
+
+#include "glm/glm.hpp"
+
+class DynamicAABBTree{
+public:
+    // An invalid proxy or node
+    static const int NULL_NODE = -1;
+    // Constructor
+    DynamicAABBTree();
+    // Adds an object with the given box. Returns its proxy id.
+    int CreateProxy(const AABB& box, void* userData);
+    // Removes an object
+    void DestroyProxy(int proxy);
+    // Updates an object's box. 'displacement' is how far it moved
+    // and is used to enlarge the box in that direction.
+    // Returns true when the tree actually had to change.
+    bool MoveProxy(int proxy, const AABB& box, const glm::vec3& displacement);
+    // Removes every object
+    void Clear();
+    // What was passed to CreateProxy
+    void* GetUserData(int proxy) const { return m_nodes[proxy].userData; }
+    // The enlarged box stored in the tree, and the actual box
+    const AABB& GetFatAABB(int proxy) const { return m_nodes[proxy].box; }
+    const AABB& GetTightAABB(int proxy) const { return m_nodes[proxy].tightBox; }
+
+    // Proxies whose boxes are at least partly inside the frustum
+    void QueryFrustum(const Frustum& frustum, std::vector<int>& results) const;
+    // Proxies whose boxes overlap 'box'
+    void QueryAABB(const AABB& box, std::vector<int>& results) const;
+    // Proxies whose boxes are within 'radius' of 'center'
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<int>& results) const;
+    // The closest proxy whose box the ray hits within 'maxDistance',
+    // or NULL_NODE. 'direction' does not need to be normalized, in which
+    // case distances are in multiples of its length.
+    int Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                float* hitDistance=nullptr) const;
+    // The (up to) k proxies closest to 'point', nearest first
+    void QueryNearest(const glm::vec3& point, unsigned int k, std::vector<int>& results) const;
+
+    // Statistics
+    unsigned int GetProxyCount() const { return m_proxyCount; }
+    // Height of the tree, a leaf has height 0
+    int GetHeight() const;
+    // Tree nodes visited by the last query
+    unsigned int GetLastQueryVisitCount() const { return m_lastVisitCount; }
+    // Checks the tree's links, boxes and heights. For debugging.
+    bool Validate() const;
+
+private:
+    struct TreeNode{
+        // Fat box for leaves, the union of both children otherwise
+        AABB box;
+        // The box the proxy was given (leaves only)
+        AABB tightBox;
+        void* userData{nullptr};
+        // Parent, or the next free node when on the free list
+        int parent{NULL_NODE};
+        int child1{NULL_NODE};
+        int child2{NULL_NODE};
+        // Leaves are 0, free nodes are -1
+        int height{-1};
+        bool IsLeaf() const { return child1==NULL_NODE; }
+    };
+    // Takes a node from the free list, growing the pool if needed
+    int AllocateNode();
+    // Returns a node to the free list
+    void FreeNode(int index);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    // Rotates the subtree at 'index' if it is unbalanced.
+    // Returns the new root of that subtree.
+    int Balance(int index);
+    // Walks from 'index' to the root fixing boxes and heights
+    void Refit(int index);
+    // Adds every leaf below 'index' to results
+    void CollectLeaves(int index, std::vector<int>& results) const;
+    // Recursive part of Validate
+    bool ValidateNode(int index) const;
+    // All nodes, used or free
+    std::vector<TreeNode> m_nodes;
+    int m_root{NULL_NODE};
+    int m_freeList{NULL_NODE};
+    unsigned int m_proxyCount{0};
+    mutable unsigned int m_lastVisitCount{0};
+};
+
+#endif
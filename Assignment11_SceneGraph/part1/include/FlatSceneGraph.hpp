@@ -0,0 +1,110 @@
+/** @file FlatSceneGraph.hpp
+ *  @brief A breadth first view of a SceneNode tree for recomputing every world matrix at once.
+ *
+ *  SceneNode::Update follows pointers from node to node, which is what
+ *  we want when a few nodes moved. When the whole tree has to be
+ *  recomputed (it was just loaded, or its root moved) the Renderer
+ *  uses this view instead. The nodes are stored breadth first in
+ *  parallel arrays of parent index, local matrix and world matrix. A
+ *  parent always comes before its children, so each level of the tree
+ *  is one pass over contiguous memory.
+ *
+ *  Matrices are kept in blocks of four nodes, with component c of the
+ *  four nodes next to each other (an array of structures of arrays),
+ *  so one SSE instruction works on four nodes. Only the first three
+ *  rows are stored, the last row of our transforms is (0,0,0,1). Each
+ *  level is padded to a multiple of four so a block never holds two
+ *  levels, and four siblings usually share one parent.
+ *
+ *  The view only holds pointers to the nodes, it has to be built again
+ *  whenever nodes are added, removed or moved to another parent
+ *  (see SceneNode::GetStructureVersion).
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef FLATSCENEGRAPH_HPP
+#define FLATSCENEGRAPH_HPP
+
+#include <vector>
+
+#include "SceneNode.hpp"
+
+#include "glm/glm.hpp"
+
+class FlatSceneGraph{
+public:
+    // Parent index of a node at the top of the view
+    static const int NO_PARENT = -1;
+    // Blocks of four nodes each job updates
+    static const unsigned int BLOCKS_PER_JOB = 256;
+    // Nodes each job finds the bounds of, or copies back out
+    static const unsigned int NODES_PER_JOB = 1024;
+    // Four nodes, component c of node k is c[c][k]. Components are the
+    // first three rows of each column, column by column.
+    struct alignas(16) MatrixBlock{
+        float c[12][4];
+    };
+
+    // Constructor
+    FlatSceneGraph();
+    // Rebuilds our arrays from 'root' and everything below it
+    void Build(SceneNode* root);
+    // Forgets every node
+    void Clear();
+    // Copies every local transform in from the SceneNodes.
+    // Returns false if one is not affine, our blocks cannot hold those.
+    bool GatherLocalTransforms();
+    // Computes every world matrix from the local matrices, a level at a time
+    void UpdateWorldMatrices();
+    // Does what SceneNode::Update does for the root and everything below
+    // it: copies the local transforms in, computes the world matrices,
+    // and hands them back to the nodes along with their new bounds.
+    // Nodes with an object are added to 'movedNodes'. Returns false if a
+    // local transform is not affine, the root is then left dirty and
+    // nothing is added to 'movedNodes', so use SceneNode::Update instead.
+    bool Update(std::vector<SceneNode*>* movedNodes=nullptr);
+
+    // The node the view was built from, and the structure it had then
+    SceneNode* GetRoot() const { return m_nodes.empty() ? nullptr : m_nodes[0]; }
+    unsigned int GetStructureVersion() const { return m_structureVersion; }
+    // Nodes in breadth first order, the root is node 0
+    unsigned int GetNodeCount() const { return m_nodes.size(); }
+    SceneNode* GetNode(unsigned int node) const { return m_nodes[node]; }
+    // A node's world matrix as of the last UpdateWorldMatrices
+    glm::mat4 GetWorldMatrix(unsigned int node) const;
+    // Nodes of depth d are [GetLevelStart(d), GetLevelStart(d+1))
+    unsigned int GetLevelCount() const { return m_levelStarts.size()-1; }
+    unsigned int GetLevelStart(unsigned int level) const { return m_levelStarts[level]; }
+
+private:
+    // Copies in the local transforms of the nodes in some blocks of a level.
+    // Returns false if one of them is not affine.
+    bool GatherLocals(unsigned int level, unsigned int firstBlock, unsigned int lastBlock);
+    // World matrices for some blocks of a level
+    void ComputeWorlds(unsigned int level, unsigned int firstBlock, unsigned int lastBlock);
+    // A node's subtree bounds, once its children's are known
+    void ComputeSubtreeBounds(unsigned int node);
+    // Parallel arrays, one entry per slot. Slots are nodes breadth first
+    // plus the padding at the end of each level.
+    std::vector<int> m_parents;
+    std::vector<MatrixBlock> m_localBlocks;
+    std::vector<MatrixBlock> m_worldBlocks;
+    // Slot of each node
+    std::vector<unsigned int> m_slots;
+    // The nodes, breadth first
+    std::vector<SceneNode*> m_nodes;
+    // The rest is per node as well
+    std::vector<Object*> m_objects;
+    // Children of node n are [m_firstChildren[n], m_firstChildren[n+1])
+    std::vector<unsigned int> m_firstChildren;
+    std::vector<AABB> m_subtreeBounds;
+    std::vector<BoundingSphere> m_subtreeSpheres;
+    // First node of each level, plus one past the last node
+    std::vector<unsigned int> m_levelStarts;
+    // First slot of each level, plus one past the last slot
+    std::vector<unsigned int> m_levelSlots;
+    unsigned int m_structureVersion{0};
+};
+
+#endif
@@ -12,6 +12,8 @@
 
 #include <vector>
 
+#include "Bounds.hpp"
+
 // Purpose of this class is to store vertice and triangle information
 class Geometry{
 public:
@@ -42,6 +44,12 @@ public:
 	unsigned int GetIndicesSize();
     // Retrieve the pointer to the indices
 	unsigned int* GetIndicesDataPtr();
+	// Computes the box around every vertex position
+	AABB ComputeBounds() const;
+	// Three floats per vertex position
+	const std::vector<float>& GetPositions() const { return m_vertexPositions; }
+	// Three indices per triangle
+	const std::vector<unsigned int>& GetIndices() const { return m_indices; }
 
 private:
 	// m_bufferData stores all of the vertexPositons, coordinates, normals, etc.
@@ -0,0 +1,93 @@
+/** @file JobSystem.hpp
+ *  @brief A small work-stealing job system.
+ *
+ *  Each worker thread (and the main thread) owns a deque of jobs.
+ *  A thread pushes and pops jobs at the back of its own deque, and
+ *  when it runs out of work it steals from the front of another
+ *  thread's deque. Waiting on a JobCounter does not block: the waiting
+ *  thread keeps running jobs until the counter reaches zero, so jobs
+ *  may safely spawn and wait on further jobs.
+ *
+ *  In deterministic mode no threads are started and every job runs
+ *  immediately, in the order it was submitted.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks how many jobs in a group are still running
+struct JobCounter{
+    std::atomic<int> pending{0};
+};
+
+class JobSystem{
+public:
+    // A unit of work
+    using Job = std::function<void()>;
+    // Singleton pattern for having one single job system
+    static JobSystem& Instance();
+    // Starts 'workerCount' threads in addition to the calling thread.
+    // 0 picks one less than the number of hardware threads.
+    // With 'deterministic' set no threads are started at all.
+    // Any previously started workers are stopped first.
+    void Initialize(unsigned int workerCount=0, bool deterministic=false);
+    // Waits for outstanding work and joins every worker
+    void Shutdown();
+    // Queues a job, incrementing 'counter' until the job finishes
+    void Run(const Job& job, JobCounter& counter);
+    // Runs jobs until 'counter' reaches zero
+    void Wait(JobCounter& counter);
+    // Calls fn(first,last) over [0,count) in chunks of at most
+    // 'grainSize', and returns once every chunk is done.
+    void ParallelFor(unsigned int count, unsigned int grainSize,
+                     const std::function<void(unsigned int, unsigned int)>& fn);
+    // Number of threads that run jobs, including the calling thread
+    unsigned int GetThreadCount() const { return m_queues.size(); }
+    // True when jobs run inline in submission order
+    bool IsDeterministic() const { return m_deterministic; }
+    // Statistics
+    unsigned int GetStealCount() const { return m_steals; }
+    void ResetStats();
+
+private:
+    // One deque of jobs per thread
+    struct WorkQueue{
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+    // Constructor is private because we should
+    // not be able to construct any other job systems.
+    JobSystem();
+    // Main loop of each worker thread
+    void WorkerLoop(unsigned int index);
+    // Runs one job from our own queue, or steals one.
+    // Returns false when no job was found.
+    bool RunOneJob(unsigned int index);
+    // Index of the queue the calling thread should use
+    unsigned int GetThreadIndex() const;
+    // One queue per thread, index 0 belongs to the main thread
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    // Idle workers sleep here until there is work
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    // Jobs queued but not yet started
+    std::atomic<int> m_queuedJobs{0};
+    std::atomic<bool> m_running{false};
+    bool m_deterministic{false};
+    // Jobs taken from some other thread's queue
+    std::atomic<unsigned int> m_steals{0};
+};
+
+#endif
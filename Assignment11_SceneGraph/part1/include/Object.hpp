@@ -39,6 +39,16 @@ public:
     void MakeTexturedQuad(std::string fileName);
     // How to draw the object
     virtual void Render();
+    // What Render binds, so a renderer can sort by it
+    GLuint GetVertexArrayID() const;
+    GLuint GetDiffuseTextureID() const;
+    // Number of indices Render draws
+    unsigned int GetIndexCount();
+    // The box around our geometry in object space.
+    // Computed the first time it is asked for.
+    const AABB& GetLocalBounds();
+    // The triangles the object is made of
+    const Geometry& GetGeometry() const { return m_geometry; }
 protected: // Classes that inherit from Object are intended to be overridden.
 
 	// Helper method for when we are ready to draw or update our object
@@ -49,6 +59,9 @@ protected: // Classes that inherit from Object are intended to be overridden.
     Texture m_textureDiffuse;
     // Store the objects Geometry
 	Geometry m_geometry;
+    // Cached bounds of m_geometry
+    AABB m_localBounds;
+    bool m_localBoundsComputed{false};
 };
 
 
@@ -1,7 +1,9 @@
 /** @file ObjectManager.hpp
  *  @brief Class to manage creation of objects 
  *  
- *  
+ *  Objects are created in a Pool for their type and referred to with
+ *  handles, so creating and destroying many objects does not fragment
+ *  the heap and using a destroyed object can be detected.
  *
  *  @author Mike
  *  @bug No known bugs.
@@ -9,15 +11,14 @@
 #ifndef OBJECTMANAGER_HPP
 #define OBJECTMANAGER_HPP
 
+#include <functional>
+#include <vector>
 
 #include "Object.hpp"
+#include "Pool.hpp"
 
-/*
 // Purpose:
-// This class sets up a full graphics program using SDL
-//
-//
-//
+// Owns every Object (and Object subclass) in our scene
 class ObjectManager{
 public:
     // Singleton pattern for having one single ObjectManager
@@ -26,26 +27,51 @@ public:
 
     // Destructor
     ~ObjectManager();
-    // Add a new object
-    void AddObject(Object*& o);
-    // Retrieve a reference to an object
-    Object& GetObject(unsigned int index);
-    // Deletes all of the objects
+    // Creates a new object of type T, for example Create<Sphere>()
+    template<typename T>
+    Handle<T> Create(){
+        return GetPool<T>().Create();
+    }
+    // Retrieve an object, nullptr if it has been destroyed
+    template<typename T>
+    T* GetObject(Handle<T> handle){
+        return GetPool<T>().Get(handle);
+    }
+    // Destroys an object. Returns false for a stale handle.
+    template<typename T>
+    bool RemoveObject(Handle<T> handle){
+        if(!GetPool<T>().Destroy(handle)){
+            std::cout << "(ObjectManager.hpp) ERROR, object was already removed\n";
+            return false;
+        }
+        return true;
+    }
+    // Makes room for 'count' objects of type T
+    template<typename T>
+    void Reserve(unsigned int count){
+        GetPool<T>().Reserve(count);
+    }
+    // Deletes all of the objects.
+    // Call while the OpenGL context is still around.
     void RemoveAll();
-    // Update all objects
-    void UpdateAll(unsigned int screenWidth, unsigned int screenHeight);
-    // Render All Objects
-    void RenderAll();
 
 private:
 	// Constructor is private because we should
     // not be able to construct any other managers,
     // this how we ensure only one is ever created
     ObjectManager();
-    // Objects in our scene 
-    std::vector<Object*> m_objects;
+    // One pool per type of object
+    template<typename T>
+    Pool<T>& GetPool(){
+        static Pool<T>* pool = nullptr;
+        if(pool==nullptr){
+            pool = new Pool<T>();
+            m_clearPools.push_back([]{ pool->Clear(); });
+        }
+        return *pool;
+    }
+    // Empties each pool that has been used
+    std::vector<std::function<void()>> m_clearPools;
 };
 
-*/
-
 #endif
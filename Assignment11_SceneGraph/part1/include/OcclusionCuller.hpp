@@ -0,0 +1,107 @@
+/** @file OcclusionCuller.hpp
+ *  @brief Hides objects that are behind large occluders, on the CPU.
+ *
+ *  A few big meshes (terrain, buildings) are rasterized each frame into
+ *  a small depth buffer. Instead of a depth per pixel, the screen is
+ *  split into 8x4 pixel tiles that each keep a coverage mask and two
+ *  depths: the farthest depth of a layer that covers the whole tile, and
+ *  a working layer that is still being filled in. Coverage is computed
+ *  four pixels at a time with SSE, and tile rows are rasterized on
+ *  different threads.
+ *
+ *  Bounding boxes are then tested against the tiles they cover. A box is
+ *  hidden when its nearest point is farther than every tile's depth.
+ *  Everything happens on the CPU, so there is no waiting on the GPU.
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef OCCLUSIONCULLER_HPP
+#define OCCLUSIONCULLER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.hpp"
+
+#include "glm/glm.hpp"
+
+class OcclusionCuller{
+public:
+    // Size of a tile in pixels, one bit of the coverage mask per pixel
+    static const unsigned int TILE_WIDTH = 8;
+    static const unsigned int TILE_HEIGHT = 4;
+    // Constructor
+    OcclusionCuller();
+    // Sets the resolution of the depth buffer. It is rounded up
+    // to a whole number of tiles.
+    void Resize(unsigned int width, unsigned int height);
+    // Starts a new frame seen through 'viewProjection'
+    void Begin(const glm::mat4& viewProjection);
+    // Adds an indexed triangle mesh to be rasterized.
+    // 'positions' holds three floats per vertex.
+    void AddOccluder(const float* positions, unsigned int vertexCount,
+                     const unsigned int* indices, unsigned int indexCount,
+                     const glm::mat4& model);
+    // Rasterizes every occluder added since Begin
+    void Rasterize();
+    // True when 'box' is completely hidden behind the occluders
+    bool IsOccluded(const AABB& box) const;
+
+    // Statistics
+    unsigned int GetWidth() const { return m_width; }
+    unsigned int GetHeight() const { return m_height; }
+    // Triangles added, and how many of those were rasterized
+    unsigned int GetTriangleCount() const { return m_indices.size()/3; }
+    unsigned int GetRasterizedTriangleCount() const { return m_rasterizedTriangles; }
+    // Time the last Rasterize call took
+    double GetLastRasterizeTime() const { return m_lastRasterizeMs; }
+    // Depth of the fully covered layer of a tile, 1 when nothing covers it
+    float GetTileDepth(unsigned int tileX, unsigned int tileY) const { return m_tileDepth[tileY*m_tilesX+tileX]; }
+
+private:
+    // A triangle ready to be rasterized
+    struct ScreenTriangle{
+        // Edge functions A*x+B*y+C, positive inside
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // Depth at any pixel is depth0+depthX*x+depthY*y
+        float depth0;
+        float depthX;
+        float depthY;
+        // Farthest vertex, the plane is clamped to this
+        float maxDepth;
+        // Tiles the triangle's bounding box touches
+        int tileMinX, tileMaxX, tileMinY, tileMaxY;
+        // False for triangles that are off screen, degenerate, or near clipped
+        bool valid;
+    };
+    // Builds the edge and depth equations of triangle 'index'
+    void SetupTriangle(unsigned int index);
+    // Rasterizes every triangle into tile rows [firstRow,lastRow)
+    void RasterizeRows(unsigned int firstRow, unsigned int lastRow);
+    // Which pixels of a tile a triangle covers, one bit per pixel
+    uint32_t ComputeCoverage(const ScreenTriangle& triangle, unsigned int tileX, unsigned int tileY) const;
+    // Merges a triangle's coverage and depth into a tile
+    void UpdateTile(unsigned int tile, uint32_t coverage, float depth);
+    // Resolution in pixels and tiles
+    unsigned int m_width{0};
+    unsigned int m_height{0};
+    unsigned int m_tilesX{0};
+    unsigned int m_tilesY{0};
+    glm::mat4 m_viewProjection;
+    // Occluder vertices in screen space (x,y in pixels, z is depth,
+    // w is the clip space w) and the triangles that use them
+    std::vector<glm::vec4> m_vertices;
+    std::vector<unsigned int> m_indices;
+    std::vector<ScreenTriangle> m_triangles;
+    // Per tile: the fully covered layer, and the working layer with its mask
+    std::vector<float> m_tileDepth;
+    std::vector<float> m_tileWorkingDepth;
+    std::vector<uint32_t> m_tileMask;
+    unsigned int m_rasterizedTriangles{0};
+    double m_lastRasterizeMs{0.0};
+};
+
+#endif
@@ -0,0 +1,101 @@
+/** @file OcclusionQueries.hpp
+ *  @brief Hides objects using the GPU's own depth buffer.
+ *
+ *  Each drawn node gets a GL_ANY_SAMPLES_PASSED query. Results are only
+ *  read once the GPU says they are available, so the CPU never waits;
+ *  until then a node keeps the visibility it had last time.
+ *
+ *  Nodes that were visible are drawn as usual, and only checked again
+ *  every few frames by wrapping their draw in a query. Nodes that were
+ *  hidden have their bounding box drawn into a query after everything
+ *  else, and are then drawn with conditional rendering so the GPU skips
+ *  them if the box turned out to be hidden (coherent hierarchical
+ *  culling, CHC++, applied to individual draws).
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef OCCLUSIONQUERIES_HPP
+#define OCCLUSIONQUERIES_HPP
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "RenderQueue.hpp"
+#include "Shader.hpp"
+#include "VertexBufferLayout.hpp"
+
+#include "glm/glm.hpp"
+
+// Counts from one frame of occlusion queries
+struct OcclusionQueryStats{
+    // Queries started this frame, around draws or bounding boxes
+    unsigned int queriesIssued{0};
+    // Results that were not ready yet. Instead of waiting we kept
+    // using the last known visibility.
+    unsigned int stallsAvoided{0};
+    // Draws left to the GPU to skip
+    unsigned int drawsConditional{0};
+    // Draws the GPU did skip, from results that came back this frame
+    unsigned int drawsSaved{0};
+};
+
+class OcclusionQueries{
+public:
+    // Visible nodes are checked again after about this many frames
+    static const unsigned int VISIBLE_QUERY_INTERVAL = 8;
+    // Constructor
+    OcclusionQueries();
+    // Destructor, deletes every query
+    ~OcclusionQueries();
+    // Reads back the results that are ready, never waiting for the rest
+    void BeginFrame();
+    // Gives draws in 'queue' the queries they need. Draws of nodes that were
+    // hidden are moved to 'hidden', to be drawn after IssueBoxQueries.
+    // Nodes within 'nearDistance' of 'eye' are always drawn, as their
+    // boxes could be cut by the near plane.
+    void Assign(RenderQueue& queue, RenderQueue& hidden, const glm::vec3& eye, float nearDistance);
+    // Draws the bounding boxes of hidden nodes into their queries.
+    // Call after the visible draws so the depth buffer is filled in.
+    void IssueBoxQueries(const glm::mat4& viewProjection);
+    // Forgets every node, for example when the scene changes
+    void Clear();
+    // Forgets one node, before it is destroyed
+    void Remove(const SceneNode* node);
+    // Statistics for the current frame
+    const OcclusionQueryStats& GetStats() const { return m_stats; }
+
+private:
+    // What we know about one node
+    struct NodeQuery{
+        GLuint query{0};
+        // Started, but the result has not been read yet
+        bool pending{false};
+        // The query was for our bounding box rather than our draw
+        bool boxQuery{false};
+        // Conditional draws that depend on the pending query
+        unsigned int conditionalDraws{0};
+        // Last known result, new nodes are assumed visible
+        bool visible{true};
+        // When a visible node is next checked
+        unsigned int nextQueryFrame{0};
+    };
+    // Marks a node's query as started
+    void Issue(const SceneNode* node, NodeQuery& state, bool boxQuery);
+    // Creates the box shader and vertices the first time they are needed
+    void CreateBoxResources();
+    std::unordered_map<const SceneNode*, NodeQuery> m_nodes;
+    // Nodes whose results have not been read yet
+    std::vector<const SceneNode*> m_pending;
+    // Nodes whose boxes are drawn this frame
+    std::vector<const SceneNode*> m_boxQueries;
+    // A unit cube and the shader that stretches it over a box
+    Shader* m_boxShader{nullptr};
+    VertexBufferLayout* m_box{nullptr};
+    unsigned int m_frame{0};
+    OcclusionQueryStats m_stats;
+};
+
+#endif
@@ -0,0 +1,178 @@
+/** @file Pool.hpp
+ *  @brief Slab storage for objects that are created and destroyed often.
+ *
+ *  A Pool hands out objects from fixed size slabs instead of calling new
+ *  for each one. Destroyed slots go on a free list and are reused, so
+ *  once enough slabs exist creating and destroying an object is O(1)
+ *  and never touches the heap. Objects never move, so pointers to live
+ *  objects stay valid.
+ *
+ *  Objects are referred to with a 32-bit Handle holding the slot's index
+ *  and a generation count. The generation changes whenever a slot is
+ *  reused, so a handle to a destroyed object is detected rather than
+ *  silently pointing at whatever took its place.
+ *
+ *  @author Mike
+ *  @bug A slot's generation wraps after 4095 reuses, so a handle that
+ *       old could be mistaken for a new one.
+ */
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <utility>
+#include <vector>
+
+// A reference to an object in a Pool<T>
+template<typename T>
+class Handle{
+public:
+    // Bits used for the slot index, the rest hold the generation
+    static const uint32_t INDEX_BITS = 20;
+    static const uint32_t GENERATION_BITS = 32-INDEX_BITS;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS)-1;
+    static const uint32_t GENERATION_MASK = (1u << GENERATION_BITS)-1;
+    // A null handle. Generation 0 is never used by a live object.
+    Handle() : m_value(0) {}
+    // Rebuilds a handle from GetValue()
+    explicit Handle(uint32_t value) : m_value(value) {}
+    Handle(uint32_t index, uint32_t generation)
+        : m_value((generation << INDEX_BITS) | (index & INDEX_MASK)) {}
+    uint32_t GetIndex() const { return m_value & INDEX_MASK; }
+    uint32_t GetGeneration() const { return m_value >> INDEX_BITS; }
+    uint32_t GetValue() const { return m_value; }
+    bool IsNull() const { return m_value==0; }
+    bool operator==(const Handle& other) const { return m_value==other.m_value; }
+    bool operator!=(const Handle& other) const { return m_value!=other.m_value; }
+private:
+    uint32_t m_value;
+};
+
+template<typename T, unsigned int SLAB_SIZE=256>
+class Pool{
+public:
+    // Most objects a pool can hold
+    static const uint32_t MAX_OBJECTS = Handle<T>::INDEX_MASK+1;
+    // Constructor
+    Pool() {}
+    // Destroys every live object and frees the slabs
+    ~Pool(){
+        Clear();
+        for(unsigned int i=0; i < m_slabs.size(); ++i){
+            delete[] m_slabs[i];
+        }
+    }
+    // Pools own their objects, so they cannot be copied
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    // Makes room for 'count' objects, so that creating
+    // that many never allocates.
+    void Reserve(unsigned int count){
+        m_slabs.reserve((count+SLAB_SIZE-1)/SLAB_SIZE);
+        while(m_capacity < count && m_capacity < MAX_OBJECTS){
+            AddSlab();
+        }
+    }
+    // Constructs an object in a free slot. Returns a null handle when full.
+    template<typename... Args>
+    Handle<T> Create(Args&&... args){
+        if(m_freeList==NO_SLOT){
+            if(m_capacity >= MAX_OBJECTS){
+                std::cout << "(Pool.hpp) ERROR, pool is full\n";
+                return Handle<T>();
+            }
+            AddSlab();
+        }
+        uint32_t index = m_freeList;
+        Slot& slot = GetSlot(index);
+        m_freeList = slot.nextFree;
+        new (slot.storage) T(std::forward<Args>(args)...);
+        slot.alive = true;
+        ++m_count;
+        return Handle<T>(index,slot.generation);
+    }
+    // Destroys the object a handle refers to.
+    // Returns false when the handle is null or stale.
+    bool Destroy(Handle<T> handle){
+        T* object = Get(handle);
+        if(object==nullptr){
+            return false;
+        }
+        uint32_t index = handle.GetIndex();
+        // The destructor may destroy other objects in this pool
+        object->~T();
+        Slot& slot = GetSlot(index);
+        slot.alive = false;
+        // Old handles no longer match this slot
+        slot.generation = (slot.generation+1) & Handle<T>::GENERATION_MASK;
+        if(slot.generation==0){
+            slot.generation = 1;
+        }
+        slot.nextFree = m_freeList;
+        m_freeList = index;
+        --m_count;
+        return true;
+    }
+    // The object a handle refers to, or nullptr when it is null or stale
+    T* Get(Handle<T> handle) const{
+        uint32_t index = handle.GetIndex();
+        if(handle.IsNull() || index >= m_capacity){
+            return nullptr;
+        }
+        Slot& slot = GetSlot(index);
+        if(!slot.alive || slot.generation!=handle.GetGeneration()){
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(slot.storage);
+    }
+    // True while the object a handle refers to is alive
+    bool IsValid(Handle<T> handle) const { return Get(handle)!=nullptr; }
+    // Destroys every live object. The slabs are kept.
+    void Clear(){
+        for(uint32_t index=0; index < m_capacity; ++index){
+            Slot& slot = GetSlot(index);
+            if(slot.alive){
+                Destroy(Handle<T>(index,slot.generation));
+            }
+        }
+    }
+    // Statistics
+    unsigned int GetCount() const { return m_count; }
+    unsigned int GetCapacity() const { return m_capacity; }
+
+private:
+    // End of the free list
+    static const uint32_t NO_SLOT = 0xFFFFFFFF;
+    // Storage for one object
+    struct Slot{
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t generation;
+        // Next free slot, only meaningful while on the free list
+        uint32_t nextFree;
+        bool alive;
+    };
+    Slot& GetSlot(uint32_t index) const { return m_slabs[index/SLAB_SIZE][index%SLAB_SIZE]; }
+    // Adds a slab and puts its slots on the free list, lowest index first
+    void AddSlab(){
+        Slot* slab = new Slot[SLAB_SIZE];
+        m_slabs.push_back(slab);
+        uint32_t first = m_capacity;
+        for(unsigned int i=SLAB_SIZE; i > 0; --i){
+            Slot& slot = slab[i-1];
+            slot.generation = 1;
+            slot.alive = false;
+            slot.nextFree = m_freeList;
+            m_freeList = first+i-1;
+        }
+        m_capacity += SLAB_SIZE;
+    }
+    std::vector<Slot*> m_slabs;
+    uint32_t m_freeList{NO_SLOT};
+    uint32_t m_capacity{0};
+    unsigned int m_count{0};
+};
+
+#endif
@@ -0,0 +1,110 @@
+/** @file RenderQueue.hpp
+ *  @brief A per-frame list of draws, sorted to minimize state changes.
+ *
+ *  Traversing the scene no longer draws anything. Instead each node
+ *  pushes a small DrawPacket along with a 64-bit sort key. Once the
+ *  traversal is done the keys are radix sorted and the packets are
+ *  submitted in that order, only binding a shader, texture or vertex
+ *  array when it differs from the previous packet.
+ *
+ *  Sort key layout (most significant bits first):
+ *      [63..60] pass
+ *      [59..48] shader
+ *      [47..36] texture
+ *      [35..24] vertex array
+ *      [23.. 0] depth (front to back, or back to front for transparent)
+ *
+ *  @author Mike
+ *  @bug No known bugs.
+ */
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Object.hpp"
+#include "Shader.hpp"
+
+#include "glm/glm.hpp"
+
+class SceneNode;
+
+// The uniforms that are the same for every draw in a frame.
+// The Renderer bumps 'version' whenever any of them change, so
+// a shader only receives them again when its copy is out of date.
+struct FrameUniforms{
+    glm::mat4 view{1.0f};
+    glm::mat4 projection{1.0f};
+    glm::vec3 lightPos{0.0f,0.0f,0.0f};
+    unsigned int version{1};
+};
+
+// Passes are drawn in this order
+enum class RenderPass : unsigned int{
+    Opaque=0,
+    Transparent=1
+};
+
+// Everything needed to issue one draw
+struct DrawPacket{
+    Shader* shader;
+    Object* object;
+    // Column major model matrix, must stay valid until Submit
+    const GLfloat* model;
+    // The node that pushed this draw, if any
+    const SceneNode* node{nullptr};
+    // An occlusion query to wrap the draw in, or 0.
+    // With 'conditional' set the draw is instead skipped by the GPU
+    // when the query found nothing visible.
+    GLuint query{0};
+    bool conditional{false};
+};
+
+class RenderQueue{
+public:
+    // Builds a sort key. 'depth' is the view distance scaled to [0,1].
+    static uint64_t MakeSortKey(RenderPass pass, GLuint shader, GLuint texture, GLuint vertexArray, float depth);
+    // Constructor
+    RenderQueue();
+    // Removes every packet, call at the start of each frame
+    void Clear();
+    // Adds a draw to the queue
+    void Push(uint64_t key, const DrawPacket& packet);
+    // Adds every packet of another queue, e.g. one filled by another thread
+    void Append(const RenderQueue& other);
+    // Packets in the order they were pushed
+    DrawPacket& GetPacket(unsigned int index) { return m_packets[index]; }
+    // Moves every packet marked conditional into another queue.
+    // Call before Sort.
+    void MoveConditionalPackets(RenderQueue& destination);
+    // Orders the packets by their keys
+    void Sort();
+    // Draws every packet in sorted order
+    void Submit(const FrameUniforms& frame);
+    // Statistics for the last Submit
+    unsigned int GetPacketCount() const { return m_items.size(); }
+    // Shader, texture and vertex array binds actually issued
+    unsigned int GetStateChanges() const { return m_stateChanges; }
+    // Binds skipped compared to binding everything for every draw
+    unsigned int GetStateChangesSaved() const { return m_stateChangesSaved; }
+
+private:
+    // What gets sorted, the key and where its packet lives
+    struct SortItem{
+        uint64_t key;
+        uint32_t index;
+    };
+    // Packets in the order they were pushed
+    std::vector<DrawPacket> m_packets;
+    // Keys and packet indices, sorted by Sort()
+    std::vector<SortItem> m_items;
+    // Second buffer for the radix sort
+    std::vector<SortItem> m_scratch;
+    unsigned int m_stateChanges{0};
+    unsigned int m_stateChangesSaved{0};
+};
+
+#endif
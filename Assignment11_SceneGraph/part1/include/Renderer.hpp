@@ -8,7 +8,10 @@
  *	possibly have multiple renderers (if we had multiple
  *	windows for example).
  *
- *	Each renderer thus has it's own camera.
+ *	Each renderer thus has it's own cameras. Each camera can be
+ *	drawn into one or more views (split screen, a minimap, a
+ *	framebuffer). The scene is updated once per frame for all views,
+ *	and the views are culled in parallel.
  *
  *  @author Mike
  *  @bug No known bugs.
@@ -21,7 +24,29 @@
 #include <vector>
 
 #include "SceneNode.hpp"
+#include "FlatSceneGraph.hpp"
 #include "Camera.hpp"
+#include "RenderQueue.hpp"
+#include "DynamicAABBTree.hpp"
+#include "OcclusionCuller.hpp"
+#include "OcclusionQueries.hpp"
+
+// A camera drawn into a rectangle of the window or of a framebuffer.
+// Views are drawn in the order they were added, so a picture in
+// picture view should come after the view it sits on top of.
+struct RenderView{
+    // Index of the camera in the renderer
+    unsigned int camera{0};
+    // Viewport in pixels, from the bottom left corner
+    int x{0};
+    int y{0};
+    unsigned int width{0};
+    unsigned int height{0};
+    // Framebuffer to draw into, 0 for the window
+    GLuint framebuffer{0};
+    // Views that are turned off are skipped entirely
+    bool enabled{true};
+};
 
 class Renderer{
 public:
@@ -37,6 +62,9 @@ public:
     // Sets the root of our renderer to some node to
     // draw an entire scene graph
     void setRoot(SceneNode* startingNode);
+    // Destroys a node and its children, first removing
+    // them from everything the renderer keeps track of.
+    void DestroyNode(NodeHandle handle);
     // Returns the camera at an index
     Camera*& GetCamera(unsigned int index){
         if(index > m_cameras.size()-1){
@@ -44,6 +72,44 @@ public:
         }
         return m_cameras[index];
     }
+    // Adds another camera and returns its index
+    unsigned int AddCamera();
+    unsigned int GetCameraCount() const { return m_cameras.size(); }
+    // Adds a view, and sets its camera's aspect ratio to match.
+    // Views of the same camera share its projection, so they must all
+    // have the same aspect ratio. Returns the view's index, or -1 if the
+    // camera does not exist or already has a view of another shape.
+    // View 0 covers the window and is made by the constructor.
+    int AddView(const RenderView& view);
+    RenderView& GetView(unsigned int index) { return m_views[index].view; }
+    unsigned int GetViewCount() const { return m_views.size(); }
+    // Size of the window
+    int GetScreenWidth() const { return m_screenWidth; }
+    int GetScreenHeight() const { return m_screenHeight; }
+    // The draws a view made last frame, useful for statistics
+    const RenderQueue& GetRenderQueue(unsigned int view=0) const { return m_views[m_views[view].source].queue; }
+    // How many nodes a view tested and culled last frame
+    const CullingStats& GetCullingStats(unsigned int view=0) const { return m_views[m_views[view].source].stats; }
+    // Returns the closest node under a pixel of the screen, or nullptr
+    SceneNode* Pick(int mouseX, int mouseY, float* distance=nullptr);
+    // Finds every node whose bounds are within 'radius' of 'center'
+    void QueryRadius(const glm::vec3& center, float radius, std::vector<SceneNode*>& results);
+    // Every node with an object, by world bounds
+    const DynamicAABBTree& GetSpatialIndex() const { return m_spatialIndex; }
+    // Nodes whose objects are big enough to hide others (terrain, buildings).
+    // Their triangles are rasterized on the CPU every frame, so keep them few.
+    void AddOccluder(SceneNode* node);
+    void RemoveOccluder(SceneNode* node);
+    // Turns occlusion culling on and off
+    void SetOcclusionCulling(bool enabled) { m_occlusionCulling = enabled; }
+    bool GetOcclusionCulling() const { return m_occlusionCulling; }
+    // The depth buffer from the last frame, useful for statistics
+    const OcclusionCuller& GetOcclusionCuller() const { return m_occlusionCuller; }
+    // Turns GPU occlusion queries on and off
+    void SetOcclusionQueries(bool enabled);
+    bool GetOcclusionQueries() const { return m_occlusionQueriesEnabled; }
+    // Queries issued and draws saved last frame
+    const OcclusionQueryStats& GetOcclusionQueryStats() const { return m_occlusionQueries.GetStats(); }
 
 // TODO: maybe write getter/setter methods
 protected:
@@ -51,8 +117,42 @@ protected:
     std::vector<Camera*> m_cameras;
     // Root scene node
     SceneNode* m_root;
-    // Store the projection matrix for our camera.
-    glm::mat4 m_projectionMatrix;
+    // Clipping planes of our projection
+    float m_nearPlane{0.1f};
+    float m_farPlane{512.0f};
+    // Everything a view needs for one frame
+    struct ViewState{
+        RenderView view;
+        // Camera and light state shared by every node in this view
+        FrameUniforms uniforms;
+        // Every draw for the current frame
+        RenderQueue queue;
+        CullingStats stats;
+        // The view whose draws this view uses. Views of the same
+        // camera see the same nodes, so only the first one culls.
+        unsigned int source{0};
+    };
+    std::vector<ViewState> m_views;
+    // Views that cull this frame
+    std::vector<unsigned int> m_cullViews;
+    // Every change of uniforms gets a new version
+    unsigned int m_uniformVersion{1};
+    // Kept in sync with the world bounds of our nodes
+    DynamicAABBTree m_spatialIndex;
+    // Nodes whose bounds changed in the last Update
+    std::vector<SceneNode*> m_movedNodes;
+    // Our tree breadth first, used when every node has to move
+    FlatSceneGraph m_flatScene;
+    // Hides whatever is behind our occluders. Occlusion
+    // culling and queries are only done for view 0.
+    OcclusionCuller m_occlusionCuller;
+    std::vector<SceneNode*> m_occluders;
+    bool m_occlusionCulling{true};
+    // Hides whatever the GPU found hidden in earlier frames
+    OcclusionQueries m_occlusionQueries;
+    // Draws of nodes that were hidden, drawn conditionally after the rest
+    RenderQueue m_hiddenQueue;
+    bool m_occlusionQueriesEnabled{false};
 
 private:
     // Screen dimension constants
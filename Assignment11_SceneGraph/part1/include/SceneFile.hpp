@@ -0,0 +1,110 @@
+/** @file SceneFile.hpp
+ *  @brief Loads a scene (hierarchy, transforms, assets) from disk.
+ *
+ *  Scenes are written by hand in a small text format and compiled into
+ *  a binary file. The binary file is memory mapped and used as is: every
+ *  section is a flat array at a fixed offset from the start of the file,
+ *  so nothing needs to be parsed or allocated per node, and the file can
+ *  be mapped at any address.
+ *
+ *  Nodes are stored breadth first, so a parent always comes before its
+ *  children and each level of the tree is one contiguous range.
+ *
+ *  Text format, one command per line ('#' starts a comment):
+ *
+ *      asset <name> <mesh> <texture or ->
+ *      node <name> <parent or -> <asset or -> [occluder]
+ *      translate <x> <y> <z>
+ *      rotate <degrees> <x> <y> <z>
+ *      scale <x> <y> <z>
+ *
+ *  translate, rotate and scale apply to the node declared last, in the
+ *  same order as the Transform class. Parents and assets must be
+ *  declared before they are used.
+ *
+ *  @author Mike
+ *  @bug The binary format is little endian only.
+ */
+#ifndef SCENEFILE_HPP
+#define SCENEFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "SceneNode.hpp"
+#include "Object.hpp"
+
+#include "glm/glm.hpp"
+
+class SceneFile{
+public:
+    // Parent of a root node
+    static const int32_t NO_PARENT = -1;
+    // Asset of a node without an object
+    static const uint32_t NO_ASSET = 0xFFFFFFFF;
+    // Per node flags
+    static const uint32_t FLAG_OCCLUDER = 1;
+    // Makes the object for an asset. Called once per asset by Instantiate.
+    // 'texture' is empty when the asset has none.
+    using AssetLoader = std::function<Object*(const char* mesh, const char* texture)>;
+
+    // Constructor
+    SceneFile();
+    // Destructor, unmaps the file
+    ~SceneFile();
+    // Compiles the text format into the binary format
+    static bool Compile(const std::string& textPath, const std::string& binaryPath);
+    // Maps a binary scene file. Only the header and section
+    // bounds are checked, nothing is read per node.
+    // When 'sourcePath' is given and that text has changed since the
+    // file was compiled from it, the file is not opened, so the caller
+    // knows to compile it again.
+    bool Open(const std::string& path, const std::string& sourcePath="");
+    // Unmaps the file
+    void Close();
+    bool IsOpen() const { return m_data!=nullptr; }
+
+    // These point straight into the mapped file
+    unsigned int GetNodeCount() const;
+    const int32_t* GetParents() const;
+    const glm::mat4* GetLocalMatrices() const;
+    const uint32_t* GetNodeAssets() const;
+    const uint32_t* GetNodeFlags() const;
+    const char* GetNodeName(unsigned int node) const;
+    // Levels of the tree, level i is nodes [start[i], start[i+1])
+    unsigned int GetLevelCount() const;
+    const uint32_t* GetLevelStarts() const;
+    unsigned int GetAssetCount() const;
+    const char* GetAssetMesh(unsigned int asset) const;
+    const char* GetAssetTexture(unsigned int asset) const;
+    // Index of the first node with a name, or -1
+    int FindNode(const char* name) const;
+
+    // Computes every node's world matrix in one pass, parents first.
+    // 'worlds' must hold GetNodeCount() matrices.
+    bool ComputeWorldMatrices(glm::mat4* worlds) const;
+    // Creates a SceneNode for every node in the file. handles[i] is the
+    // node made for node i. Scenes with several roots are placed under a
+    // new empty node. Returns the root, or a null handle on error.
+    NodeHandle Instantiate(const AssetLoader& loadAsset, std::vector<NodeHandle>& handles) const;
+
+private:
+    // Layout of the start of the file
+    struct Header;
+    const Header* GetHeader() const { return reinterpret_cast<const Header*>(m_data); }
+    // A section of the file as an array of T
+    template<typename T>
+    const T* GetSection(uint32_t offset) const { return reinterpret_cast<const T*>(m_data+offset); }
+    // The mapped file
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    void* m_file{nullptr};
+    void* m_mapping{nullptr};
+#endif
+};
+
+#endif
@@ -2,56 +2,171 @@
 #define SCENENODE_HPP
 /** @file SceneNode.hpp
  *  @brief SceneNode helps organize a large 3D graphics scene.
- *  
+ *
  *  SceneNode helps organize a large 3D graphics scene.
  *  The traversal of the tree takes place starting from
  *  a single SceneNode (typically called root).
  *
+ *  World transforms are cached in each node and only
+ *  recomputed for subtrees whose local transform changed.
+ *
  *  @author Mike
  *  @bug No known bugs.
  */
 
+#include <memory>
 #include <vector>
 
 #include "Object.hpp"
 #include "Transform.hpp"
 #include "Camera.hpp"
 #include "Shader.hpp"
+#include "RenderQueue.hpp"
+#include "Bounds.hpp"
+#include "OcclusionCuller.hpp"
+#include "Pool.hpp"
 
 #include "glm/vec3.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+// Counts from one frame of frustum culling
+struct CullingStats{
+    // Bounding boxes tested against the frustum
+    unsigned int nodesTested{0};
+    // Nodes skipped, including everything below a culled node
+    unsigned int nodesCulled{0};
+    // Nodes inside the frustum but hidden behind occluders
+    unsigned int nodesOccluded{0};
+};
+
+class SceneNode;
+// Refers to a SceneNode, and detects when the node has been destroyed
+using NodeHandle = Handle<SceneNode>;
+
 class SceneNode{
 public:
+    // Nodes with more children than this update them in parallel
+    static const unsigned int CHILDREN_PER_JOB = 32;
     // A SceneNode is created by taking
-    // a pointer to an object.
-    SceneNode(Object* ob);
-    // Our destructor takes care of destroying
-    // all of the children within the node.
-    // Now we do not have to manage deleting
-    // each individual object.
-    ~SceneNode();
+    // a pointer to an object. Nodes live in a pool,
+    // so creating one does not allocate.
+    static NodeHandle Create(Object* ob);
+    // Returns the node a handle refers to, or nullptr
+    // if it has been destroyed.
+    static SceneNode* Get(NodeHandle handle);
+    // Makes room for 'count' nodes up front
+    static void Reserve(unsigned int count);
+    // Number of nodes that exist
+    static unsigned int GetNodeCount();
+    // Changes whenever a node is added to or removed from a parent, or
+    // destroyed. Anything that keeps its own copy of the tree's shape
+    // (like FlatSceneGraph) compares this to know when to rebuild.
+    static unsigned int GetStructureVersion();
+    // Our own handle
+    NodeHandle GetHandle() const { return m_handle; }
     // Adds a child node to our current node.
-    void AddChild(SceneNode* n);
-    // Draws the current SceneNode
-    void Draw();
-    // Updates the current SceneNode
-    void Update(glm::mat4 projectionMatrix, Camera* camera);
-    // Returns the local transformation transform
+    void AddChild(NodeHandle child);
+    // Makes room for 'count' children. Unlike the nodes themselves our
+    // list of children is a std::vector that grows as children are
+    // added, so reserve it when the count is known up front.
+    void ReserveChildren(unsigned int count) { m_children.reserve(count); }
+    // Adds a draw for this node and any children inside of the
+    // frustum to a queue. 'view' and 'farPlane' are used to sort by distance.
+    // When 'occlusion' is given, anything hidden behind its occluders is skipped.
+    // Wide nodes cull groups of their children on the job system.
+    void Submit(RenderQueue& queue, const glm::mat4& view, float farPlane,
+                const Frustum& frustum, CullingStats& stats,
+                const OcclusionCuller* occlusion=nullptr);
+    // Updates the world transform of this node and any
+    // descendents whose transforms have changed.
+    // Nodes with an object whose bounds changed are added to 'movedNodes'.
+    void Update(std::vector<SceneNode*>* movedNodes=nullptr);
+    // Returns the local transform so that it can be modified.
     // Remember that local is local to an object, where it's center is the origin.
+    // Calling this marks the node as dirty.
     Transform& GetLocalTransform();
-    // Returns a SceneNode's world transform
-    Transform& GetWorldTransform();
-    // For now we have one shader per Node.
-    Shader m_shader;
-    
-    
+    // Returns the local transform without marking the node dirty
+    const Transform& GetLocalTransform() const;
+    // Replaces the local transform
+    void SetLocalTransform(const Transform& t);
+    // Returns a SceneNode's world transform as of the last Update
+    const Transform& GetWorldTransform() const;
+    // Flags this node's world transform for recomputation
+    void MarkDirty();
+    // True when our local transform changed since the last Update,
+    // so every node below us will move
+    bool IsDirty() const { return m_dirty; }
+    // Access to our parent and children
+    SceneNode* GetParent() const { return m_parent; }
+    unsigned int GetChildCount() const { return m_children.size(); }
+    SceneNode* GetChild(unsigned int index) const { return m_children[index]; }
+    // World space bounds of our object, as of the last Update
+    const AABB& GetWorldBounds() const { return m_worldBounds; }
+    const BoundingSphere& GetWorldSphere() const { return m_worldSphere; }
+    // World space bounds of our object and every descendent
+    const AABB& GetSubtreeBounds() const { return m_subtreeBounds; }
+    const BoundingSphere& GetSubtreeSphere() const { return m_subtreeSphere; }
+    // Number of nodes in this subtree, including us
+    unsigned int GetSubtreeNodeCount() const { return m_subtreeNodeCount; }
+    // The object stored in this node
+    Object* GetObject() const { return m_object; }
+    // Our proxy in the renderer's spatial index (-1 when not in one)
+    int GetProxy() const { return m_proxy; }
+    void SetProxy(int proxy) { m_proxy = proxy; }
+    // The shader this node is drawn with.
+    // By default every node shares the same one.
+    std::shared_ptr<Shader> m_shader;
+
+
     // NOTE: Protected members are accessible by anything
     // that we inherit from, as well as ?
 protected:
     // Parent
     SceneNode* m_parent;
 private:
+    // Only our pool creates and destroys nodes
+    friend class Pool<SceneNode>;
+    // Destroys a node and all of the children within it, after removing
+    // it from its parent. Renderers keep pointers to nodes (spatial index,
+    // occluders, occlusion queries), so everyone else destroys nodes
+    // through Renderer::DestroyNode, which forgets them first. SceneFile
+    // may destroy nodes it just made that no renderer has seen.
+    friend class Renderer;
+    friend class SceneFile;
+    // Does the work of Update for a whole tree at once
+    friend class FlatSceneGraph;
+    static void Destroy(NodeHandle handle);
+    SceneNode(Object* ob);
+    // Our destructor takes care of destroying
+    // all of the children within the node.
+    // Now we do not have to manage deleting
+    // each individual object.
+    ~SceneNode();
+    // Removes a child without destroying it
+    void RemoveChild(SceneNode* child);
+    // Recomputes our world transform if we (or a parent) changed,
+    // then visits any children that need it.
+    void UpdateWorldTransform(const Transform& parentWorld, bool parentChanged,
+                              std::vector<SceneNode*>* movedNodes);
+    // Submit for a node whose subtree already passed the frustum test.
+    // 'inside' means the whole subtree is inside and needs no more tests.
+    // 'parallel' is false once we are already inside a job.
+    void SubmitVisible(RenderQueue& queue, const glm::mat4& view, float farPlane,
+                       const Frustum& frustum, CullingStats& stats,
+                       const OcclusionCuller* occlusion, bool inside, bool parallel);
+    // SubmitVisible for children [first, last) whose subtrees might be visible
+    void SubmitChildren(unsigned int first, unsigned int last,
+                        RenderQueue& queue, const glm::mat4& view, float farPlane,
+                        const Frustum& frustum, CullingStats& stats,
+                        const OcclusionCuller* occlusion, bool inside, bool parallel);
+    // Recomputes our object's world bounds from our world transform
+    void UpdateWorldBounds(std::vector<SceneNode*>* movedNodes);
+    // Merges our bounds with our children's subtree bounds
+    void UpdateSubtreeBounds();
+    // Our slot in the pool
+    NodeHandle m_handle;
+    // Where we are in our parent's list of children
+    unsigned int m_indexInParent{0};
     // Children holds all a pointer to all of the descendents
     // of a particular SceneNode. A pointer is used because
     // we do not want to hold or make actual copies.
@@ -62,6 +177,19 @@ private:
     Transform m_localTransform;
     // We additionally can store the world transform
     Transform m_worldTransform;
+    // Our local transform changed since the last Update
+    bool m_dirty{true};
+    // Some descendent is dirty
+    bool m_childDirty{false};
+    // Our object's bounds in world space
+    AABB m_worldBounds;
+    BoundingSphere m_worldSphere;
+    // Bounds of everything from this node down
+    AABB m_subtreeBounds;
+    BoundingSphere m_subtreeSphere;
+    unsigned int m_subtreeNodeCount{1};
+    // Proxy id in a DynamicAABBTree
+    int m_proxy{-1};
 };
 
 #endif
@@ -37,9 +37,17 @@ public:
     GLuint GetID() const;
     // Set our uniforms for our shader.
     void SetUniformMatrix4fv(const GLchar* name, const GLfloat* value);
+    // Same, for a location that was looked up earlier
+    void SetUniformMatrix4fv(GLint location, const GLfloat* value);
 	void SetUniform3f(const GLchar* name, float v0, float v1, float v2);
     void SetUniform1i(const GLchar* name, int value);
     void SetUniform1f(const GLchar* name, float value);
+    // Location of the 'model' matrix, looked up once after linking
+    GLint GetModelLocation() const { return m_modelLocation; }
+    // The FrameUniforms version this program last received (see RenderQueue).
+    // Kept here so it goes away with the program.
+    unsigned int GetFrameVersion() const { return m_frameVersion; }
+    void SetFrameVersion(unsigned int version) { m_frameVersion = version; }
 
 private:
     // Compiles loaded shaders
@@ -53,6 +61,10 @@ private:
     void Log(const char* system, const char* message);
     // The unique shaderID
     GLuint m_shaderID;
+    // Set on every draw, so it is worth not looking up each time
+    GLint m_modelLocation{-1};
+    // 0 until the first FrameUniforms are sent
+    unsigned int m_frameVersion{0};
 };
 
 #endif
@@ -1,10 +1,18 @@
 /** @file Transform.hpp
  *  @brief Responsible for holding matrix operations in model, view, and projection space..
- *  
- *  More...
+ *
+ *  A transform is kept as a position, rotation and scale, and the 4x4
+ *  matrix is only built from them (and then cached) when someone asks
+ *  for it. Transforms that come from a matrix, such as the product of
+ *  two transforms, keep that matrix instead and split it into position,
+ *  rotation and scale only if those are asked for.
+ *
+ *  The last row of a transform made of moves, rotations and scales is
+ *  always (0,0,0,1), so products of them skip it (a 3x4 product).
  *
  *  @author Mike
- *  @bug No known bugs.
+ *  @bug Position, rotation and scale read from a sheared matrix
+ *       (a rotation after a non-uniform scale) are approximate.
  */
 #ifndef TRANSFORM_HPP
 #define TRANSFORM_HPP
@@ -12,6 +20,7 @@
 #include <glad/glad.h>
 #include "glm/vec3.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 // The purpose of this class is to store
 // transformations of 3D entities (cameras, objects, etc.)
@@ -31,32 +40,63 @@ public:
     // Perform rotation about an axis
     void Scale(float x, float y, float z);
     // Returns the transformation matrix
-    GLfloat* GetTransformMatrix();
+    const GLfloat* GetTransformMatrix() const;
     // Apply Transform
     // Takes in a transform and sets internal
     // matrix.
-    void ApplyTransform(Transform t);
-    // Returns the transformation matrix
-    glm::mat4 GetInternalMatrix() const;
+    void ApplyTransform(const Transform& t);
+    // Returns the transformation matrix, building it if needed
+    const glm::mat4& GetInternalMatrix() const;
+    // Replaces the transformation matrix
+    void SetInternalMatrix(const glm::mat4& matrix);
+
+    // Position, rotation and scale, applied in that order
+    const glm::vec3& GetPosition() const;
+    const glm::quat& GetRotation() const;
+    const glm::vec3& GetScale() const;
+    void SetPosition(const glm::vec3& position);
+    void SetRotation(const glm::quat& rotation);
+    void SetScale(const glm::vec3& scale);
+
+    // Stores lhs * rhs in this transform without any temporaries.
+    // Either side may be this transform.
+    void SetProduct(const Transform& lhs, const Transform& rhs);
+    // out = a * b for matrices whose last row is (0,0,0,1).
+    // 'out' may be 'a' or 'b'.
+    static void MultiplyAffine(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
 
     // Transform multiplication t1 *= t2 (t1 is multiplied and a new result stored)
 	Transform& operator*=(const Transform& t);
 	// Transform addition
 	Transform& operator+=(const Transform& t);
-	// Transform =
-	Transform& operator=(const Transform& t);
     // Multiplication operator overload
-    // Returns a new copy of the result of 
+    // Returns a new copy of the result of
     // t3 = t1 * t2. (Returned value is stored in 't3' which is returned)
     friend Transform operator*(const Transform& lhs, const Transform& rhs);
     // Addition operator overload
-    // Returns a new copy of the result of 
+    // Returns a new copy of the result of
     // t3 = t1 + t2. (Returned value is stored in 't3' which is returned)
     friend Transform operator+(const Transform& lhs, const Transform& rhs);
 
 private:
-    // Stores the actual transformation matrix
-    glm::mat4 m_modelTransformMatrix;
+    // Rebuilds the matrix from position, rotation and scale
+    void ComposeMatrix() const;
+    // Splits the matrix into position, rotation and scale
+    void DecomposeMatrix() const;
+    // Makes the matrix the source of truth, for changes
+    // position, rotation and scale cannot describe
+    void UseMatrix();
+    // Position, rotation and scale. Out of date while m_trsDirty.
+    mutable glm::vec3 m_position;
+    mutable glm::quat m_rotation;
+    mutable glm::vec3 m_scale;
+    // Stores the actual transformation matrix. Out of date while m_matrixDirty.
+    mutable glm::mat4 m_modelTransformMatrix;
+    // At most one of these is set
+    mutable bool m_matrixDirty;
+    mutable bool m_trsDirty;
+    // True when the last row is (0,0,0,1)
+    bool m_affine;
 };
 
 
@@ -25,6 +25,9 @@ public:
     void Bind();
     // Unbind our buffers
     void Unbind();
+    // Return the id of our vertex array object.
+    // The VAO also remembers our index buffer.
+    GLuint GetID() const;
 
     // Creates a vertex and index buffer object
     // Format is: x,y,z
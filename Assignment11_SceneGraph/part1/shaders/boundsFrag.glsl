@@ -0,0 +1,11 @@
+// ====================================================
+#version 330 core
+// Color writes are off while boxes are drawn,
+// only whether any samples pass matters.
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(1.0f);
+}
+// ==================================================================
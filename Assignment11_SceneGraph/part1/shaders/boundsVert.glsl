@@ -0,0 +1,15 @@
+// ==================================================================
+#version 330 core
+// Draws a bounding box for an occlusion query.
+// The unit cube's corners are stretched to the box's corners.
+layout(location=0)in vec3 position;
+
+uniform mat4 u_ViewProjection;
+uniform vec3 u_BoxMin;
+uniform vec3 u_BoxMax;
+
+void main()
+{
+    gl_Position = u_ViewProjection * vec4(mix(u_BoxMin, u_BoxMax, position), 1.0f);
+}
+// ==================================================================
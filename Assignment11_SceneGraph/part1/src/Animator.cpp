@@ -0,0 +1,327 @@
+#include "Animator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define ANIMATOR_USE_SSE
+#endif
+
+// Quaternions are stored as (x,y,z,w)
+static glm::vec4 ToVec4(const glm::quat& q){
+    return glm::vec4(q.x,q.y,q.z,q.w);
+}
+
+static glm::quat ToQuat(float x, float y, float z, float w){
+    return glm::quat(w,x,y,z);
+}
+
+void Animator::Batch::Reset(unsigned int tracks){
+    // Room for the padding too
+    unsigned int size = (tracks+3) & ~3u;
+    if(t.size() < size){
+        ax.resize(size); ay.resize(size); az.resize(size); aw.resize(size);
+        bx.resize(size); by.resize(size); bz.resize(size); bw.resize(size);
+        t.resize(size);
+        track.resize(size);
+    }
+    count = 0;
+}
+
+void Animator::Batch::Add(uint32_t trackIndex, const glm::vec4& a, const glm::vec4& b, float alpha){
+    ax[count] = a.x; ay[count] = a.y; az[count] = a.z; aw[count] = a.w;
+    bx[count] = b.x; by[count] = b.y; bz[count] = b.z; bw[count] = b.w;
+    t[count] = alpha;
+    track[count] = trackIndex;
+    ++count;
+}
+
+void Animator::Batch::Pad(){
+    // Identity quaternions, so the padding blends cleanly
+    for(unsigned int i=count; (i & 3)!=0; ++i){
+        ax[i] = ay[i] = az[i] = 0.0f; aw[i] = 1.0f;
+        bx[i] = by[i] = bz[i] = 0.0f; bw[i] = 1.0f;
+        t[i] = 0.0f;
+    }
+}
+
+Animator::Animator(){
+}
+
+int Animator::AddTranslationTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::vec3>& values){
+    if(values.size()!=times.size()){
+        std::cout << "(Animator.cpp) ERROR, a track needs one value per key\n";
+        return -1;
+    }
+    std::vector<glm::vec4> keys(values.size());
+    for(unsigned int i=0; i < values.size(); ++i){
+        keys[i] = glm::vec4(values[i],0.0f);
+    }
+    return AddTrack(node, TrackType::Translation, times, keys.data());
+}
+
+int Animator::AddRotationTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::quat>& values){
+    if(values.size()!=times.size()){
+        std::cout << "(Animator.cpp) ERROR, a track needs one value per key\n";
+        return -1;
+    }
+    std::vector<glm::vec4> keys(values.size());
+    for(unsigned int i=0; i < values.size(); ++i){
+        keys[i] = ToVec4(glm::normalize(values[i]));
+    }
+    return AddTrack(node, TrackType::Rotation, times, keys.data());
+}
+
+int Animator::AddScaleTrack(NodeHandle node, const std::vector<float>& times, const std::vector<glm::vec3>& values){
+    if(values.size()!=times.size()){
+        std::cout << "(Animator.cpp) ERROR, a track needs one value per key\n";
+        return -1;
+    }
+    std::vector<glm::vec4> keys(values.size());
+    for(unsigned int i=0; i < values.size(); ++i){
+        keys[i] = glm::vec4(values[i],0.0f);
+    }
+    return AddTrack(node, TrackType::Scale, times, keys.data());
+}
+
+int Animator::AddTrack(NodeHandle node, TrackType type, const std::vector<float>& times, const glm::vec4* values){
+    SceneNode* sceneNode = SceneNode::Get(node);
+    if(sceneNode==nullptr){
+        std::cout << "(Animator.cpp) ERROR, cannot animate a destroyed node\n";
+        return -1;
+    }
+    if(times.empty()){
+        std::cout << "(Animator.cpp) ERROR, a track needs at least one key\n";
+        return -1;
+    }
+    for(unsigned int i=1; i < times.size(); ++i){
+        if(!(times[i] > times[i-1])){
+            std::cout << "(Animator.cpp) ERROR, key times must increase\n";
+            return -1;
+        }
+    }
+
+    auto found = m_targetIndices.find(node.GetValue());
+    uint32_t target = 0;
+    if(found!=m_targetIndices.end()){
+        target = found->second;
+    }else{
+        // Parts without a track keep the node's current values
+        const SceneNode* constNode = sceneNode;
+        const Transform& local = constNode->GetLocalTransform();
+        Target entry;
+        entry.node = node;
+        entry.translation = local.GetPosition();
+        entry.rotation = local.GetRotation();
+        entry.scale = local.GetScale();
+        target = m_targets.size();
+        m_targets.push_back(entry);
+        m_targetIndices[node.GetValue()] = target;
+    }
+
+    Track track;
+    track.firstKey = m_keyTimes.size();
+    track.keyCount = times.size();
+    track.cursor = 0;
+    track.target = target;
+    track.type = type;
+    m_keyTimes.insert(m_keyTimes.end(), times.begin(), times.end());
+    m_keyValues.insert(m_keyValues.end(), values, values+times.size());
+    m_tracks.push_back(track);
+    return m_tracks.size()-1;
+}
+
+void Animator::Clear(){
+    m_tracks.clear();
+    m_targets.clear();
+    m_targetIndices.clear();
+    m_keyTimes.clear();
+    m_keyValues.clear();
+    m_time = 0.0f;
+}
+
+uint32_t Animator::FindKey(Track& track, float time){
+    const float* times = &m_keyTimes[track.firstKey];
+    uint32_t last = track.keyCount-1;
+    uint32_t cursor = track.cursor;
+    // Time moves forward a little each frame, so the answer is
+    // almost always the cursor or the key after it.
+    if(times[cursor] <= time){
+        if(cursor==last || time < times[cursor+1]){
+            return cursor;
+        }
+        if(cursor+1==last || time < times[cursor+2]){
+            track.cursor = cursor+1;
+            return cursor+1;
+        }
+    }
+    // Jumped (looped or SetTime), search the whole track
+    const float* after = std::upper_bound(times, times+track.keyCount, time);
+    track.cursor = (after==times) ? 0 : (uint32_t)(after-times-1);
+    return track.cursor;
+}
+
+void Animator::LerpBatch(Batch& batch){
+    unsigned int i = 0;
+#ifdef ANIMATOR_USE_SSE
+    // Pad() filled the batch up to a multiple of four
+    unsigned int padded = (batch.count+3) & ~3u;
+    for(; i < padded; i += 4){
+        __m128 t = _mm_loadu_ps(&batch.t[i]);
+        __m128 ax = _mm_loadu_ps(&batch.ax[i]);
+        __m128 ay = _mm_loadu_ps(&batch.ay[i]);
+        __m128 az = _mm_loadu_ps(&batch.az[i]);
+        ax = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&batch.bx[i]),ax),t));
+        ay = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&batch.by[i]),ay),t));
+        az = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&batch.bz[i]),az),t));
+        _mm_storeu_ps(&batch.ax[i], ax);
+        _mm_storeu_ps(&batch.ay[i], ay);
+        _mm_storeu_ps(&batch.az[i], az);
+    }
+#endif
+    for(; i < batch.count; ++i){
+        float t = batch.t[i];
+        batch.ax[i] += (batch.bx[i]-batch.ax[i])*t;
+        batch.ay[i] += (batch.by[i]-batch.ay[i])*t;
+        batch.az[i] += (batch.bz[i]-batch.az[i])*t;
+    }
+}
+
+// Slerp without acos or sin: a normalized lerp whose 't' is bent so the
+// rotation moves at an even speed, as described by Arseny Kapoulkine in
+// "Approximating slerp". Within about 0.001 of slerp for any angle.
+static float SlerpFactor(float t, float cosAngle){
+    float d = std::fabs(cosAngle);
+    float k = 0.931872f + d*(-1.25654f + d*0.331442f);
+    return t + t*(t-0.5f)*(t-1.0f)*k;
+}
+
+void Animator::SlerpBatch(Batch& batch){
+    unsigned int i = 0;
+#ifdef ANIMATOR_USE_SSE
+    // Pad() filled the batch up to a multiple of four
+    unsigned int padded = (batch.count+3) & ~3u;
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for(; i < padded; i += 4){
+        __m128 ax = _mm_loadu_ps(&batch.ax[i]);
+        __m128 ay = _mm_loadu_ps(&batch.ay[i]);
+        __m128 az = _mm_loadu_ps(&batch.az[i]);
+        __m128 aw = _mm_loadu_ps(&batch.aw[i]);
+        __m128 bx = _mm_loadu_ps(&batch.bx[i]);
+        __m128 by = _mm_loadu_ps(&batch.by[i]);
+        __m128 bz = _mm_loadu_ps(&batch.bz[i]);
+        __m128 bw = _mm_loadu_ps(&batch.bw[i]);
+        __m128 t = _mm_loadu_ps(&batch.t[i]);
+        __m128 cosAngle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax,bx),_mm_mul_ps(ay,by)),
+                                     _mm_add_ps(_mm_mul_ps(az,bz),_mm_mul_ps(aw,bw)));
+        // Take the short way round: flip b when the angle is over 90 degrees
+        __m128 flip = _mm_and_ps(cosAngle, signBit);
+        bx = _mm_xor_ps(bx, flip);
+        by = _mm_xor_ps(by, flip);
+        bz = _mm_xor_ps(bz, flip);
+        bw = _mm_xor_ps(bw, flip);
+        // Same as SlerpFactor
+        __m128 d = _mm_andnot_ps(signBit, cosAngle);
+        __m128 k = _mm_add_ps(_mm_set1_ps(0.931872f),
+                   _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.25654f), _mm_mul_ps(d,_mm_set1_ps(0.331442f)))));
+        __m128 bend = _mm_mul_ps(_mm_mul_ps(t,_mm_sub_ps(t,half)),_mm_sub_ps(t,one));
+        t = _mm_add_ps(t, _mm_mul_ps(bend,k));
+        __m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx,ax),t));
+        __m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by,ay),t));
+        __m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz,az),t));
+        __m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw,aw),t));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx,rx),_mm_mul_ps(ry,ry)),
+                                               _mm_add_ps(_mm_mul_ps(rz,rz),_mm_mul_ps(rw,rw))));
+        __m128 scale = _mm_div_ps(one, length);
+        _mm_storeu_ps(&batch.ax[i], _mm_mul_ps(rx,scale));
+        _mm_storeu_ps(&batch.ay[i], _mm_mul_ps(ry,scale));
+        _mm_storeu_ps(&batch.az[i], _mm_mul_ps(rz,scale));
+        _mm_storeu_ps(&batch.aw[i], _mm_mul_ps(rw,scale));
+    }
+#endif
+    for(; i < batch.count; ++i){
+        glm::vec4 a(batch.ax[i],batch.ay[i],batch.az[i],batch.aw[i]);
+        glm::vec4 b(batch.bx[i],batch.by[i],batch.bz[i],batch.bw[i]);
+        float cosAngle = glm::dot(a,b);
+        if(cosAngle < 0.0f){
+            b = -b;
+        }
+        glm::vec4 r = glm::normalize(a + (b-a)*SlerpFactor(batch.t[i],cosAngle));
+        batch.ax[i] = r.x; batch.ay[i] = r.y; batch.az[i] = r.z; batch.aw[i] = r.w;
+    }
+}
+
+void Animator::Update(float deltaSeconds){
+    auto start = std::chrono::steady_clock::now();
+    m_time += deltaSeconds;
+    m_lerp.Reset(m_tracks.size());
+    m_slerp.Reset(m_tracks.size());
+
+    // Find the keys on either side of the current time
+    for(uint32_t i=0; i < m_tracks.size(); ++i){
+        Track& track = m_tracks[i];
+        const float* times = &m_keyTimes[track.firstKey];
+        const glm::vec4* values = &m_keyValues[track.firstKey];
+        float first = times[0];
+        float last = times[track.keyCount-1];
+        float time = m_time;
+        if(m_looping && last > first){
+            time = first + std::fmod(time-first, last-first);
+            if(time < first){
+                time += last-first;
+            }
+        }
+        time = std::min(std::max(time,first),last);
+        uint32_t key = FindKey(track, time);
+        uint32_t next = std::min(key+1, track.keyCount-1);
+        float alpha = 0.0f;
+        if(next!=key){
+            alpha = (time-times[key])/(times[next]-times[key]);
+        }
+        Batch& batch = (track.type==TrackType::Rotation) ? m_slerp : m_lerp;
+        batch.Add(i, values[key], values[next], alpha);
+    }
+
+    // Blend every pair at once
+    m_lerp.Pad();
+    m_slerp.Pad();
+    LerpBatch(m_lerp);
+    SlerpBatch(m_slerp);
+
+    // Hand the results back to their nodes
+    for(unsigned int i=0; i < m_lerp.count; ++i){
+        const Track& track = m_tracks[m_lerp.track[i]];
+        glm::vec3 value(m_lerp.ax[i],m_lerp.ay[i],m_lerp.az[i]);
+        if(track.type==TrackType::Translation){
+            m_targets[track.target].translation = value;
+        }else{
+            m_targets[track.target].scale = value;
+        }
+    }
+    for(unsigned int i=0; i < m_slerp.count; ++i){
+        const Track& track = m_tracks[m_slerp.track[i]];
+        m_targets[track.target].rotation = ToQuat(m_slerp.ax[i],m_slerp.ay[i],m_slerp.az[i],m_slerp.aw[i]);
+    }
+
+    // Hand each animated node its new local transform. This marks only
+    // them (and the path to the root) dirty, and their matrices are
+    // built when Update needs them.
+    for(unsigned int i=0; i < m_targets.size(); ++i){
+        const Target& target = m_targets[i];
+        SceneNode* node = SceneNode::Get(target.node);
+        if(node==nullptr){
+            // Destroyed while being animated
+            continue;
+        }
+        Transform& local = node->GetLocalTransform();
+        local.SetPosition(target.translation);
+        local.SetRotation(target.rotation);
+        local.SetScale(target.scale);
+    }
+    m_lastUpdateMs = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
@@ -0,0 +1,254 @@
+#include "Bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define BOUNDS_USE_SSE
+#endif
+
+// ============== AABB ==============
+
+void AABB::Expand(const glm::vec3& point){
+    min = glm::min(min,point);
+    max = glm::max(max,point);
+}
+
+void AABB::Expand(const AABB& box){
+    if(!box.IsValid()){
+        return;
+    }
+    min = glm::min(min,box.min);
+    max = glm::max(max,box.max);
+}
+
+// Transforms the center, and grows the extents by the absolute
+// value of the rotation/scale part (Arvo's method).
+AABB AABB::Transformed(const glm::mat4& m) const{
+    if(!IsValid()){
+        return AABB();
+    }
+    glm::vec3 center = glm::vec3(m * glm::vec4(GetCenter(),1.0f));
+    glm::vec3 extents = GetExtents();
+    glm::vec3 newExtents = glm::abs(glm::vec3(m[0]))*extents.x +
+                           glm::abs(glm::vec3(m[1]))*extents.y +
+                           glm::abs(glm::vec3(m[2]))*extents.z;
+    AABB result;
+    result.min = center-newExtents;
+    result.max = center+newExtents;
+    return result;
+}
+
+bool AABB::Contains(const AABB& box) const{
+    return min.x <= box.min.x && min.y <= box.min.y && min.z <= box.min.z &&
+           max.x >= box.max.x && max.y >= box.max.y && max.z >= box.max.z;
+}
+
+bool AABB::Overlaps(const AABB& box) const{
+    return min.x <= box.max.x && max.x >= box.min.x &&
+           min.y <= box.max.y && max.y >= box.min.y &&
+           min.z <= box.max.z && max.z >= box.min.z;
+}
+
+float AABB::DistanceSquared(const glm::vec3& point) const{
+    glm::vec3 closest = glm::clamp(point,min,max);
+    glm::vec3 offset = point-closest;
+    return glm::dot(offset,offset);
+}
+
+float AABB::GetSurfaceArea() const{
+    if(!IsValid()){
+        return 0.0f;
+    }
+    glm::vec3 size = max-min;
+    return 2.0f*(size.x*size.y + size.y*size.z + size.z*size.x);
+}
+
+// Slab test: the ray is inside the box where it is
+// between all three pairs of planes at once.
+bool AABB::IntersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection,
+                        float maxDistance, float& hitDistance) const{
+    glm::vec3 t0 = (min-origin)*inverseDirection;
+    glm::vec3 t1 = (max-origin)*inverseDirection;
+    glm::vec3 tNear = glm::min(t0,t1);
+    glm::vec3 tFar = glm::max(t0,t1);
+    float enter = std::max(std::max(tNear.x,tNear.y),std::max(tNear.z,0.0f));
+    float exit = std::min(std::min(tFar.x,tFar.y),std::min(tFar.z,maxDistance));
+    if(enter > exit){
+        return false;
+    }
+    hitDistance = enter;
+    return true;
+}
+
+AABB AABB::Union(const AABB& a, const AABB& b){
+    AABB result = a;
+    result.Expand(b);
+    return result;
+}
+
+// ============== BoundingSphere ==============
+
+BoundingSphere BoundingSphere::FromAABB(const AABB& box){
+    BoundingSphere result;
+    if(box.IsValid()){
+        result.center = box.GetCenter();
+        result.radius = glm::length(box.GetExtents());
+    }
+    return result;
+}
+
+void BoundingSphere::Expand(const BoundingSphere& sphere){
+    if(!sphere.IsValid()){
+        return;
+    }
+    if(!IsValid()){
+        *this = sphere;
+        return;
+    }
+    glm::vec3 offset = sphere.center-center;
+    float distance = glm::length(offset);
+    // One sphere already holds the other
+    if(distance+sphere.radius <= radius){
+        return;
+    }
+    if(distance+radius <= sphere.radius){
+        *this = sphere;
+        return;
+    }
+    // The new sphere touches the far sides of both
+    float newRadius = (distance+radius+sphere.radius)*0.5f;
+    center += offset*((newRadius-radius)/distance);
+    radius = newRadius;
+}
+
+BoundingSphere BoundingSphere::Transformed(const glm::mat4& m) const{
+    if(!IsValid()){
+        return BoundingSphere();
+    }
+    BoundingSphere result;
+    result.center = glm::vec3(m * glm::vec4(center,1.0f));
+    // Non-uniform scale stretches the sphere by the largest axis
+    float scale = std::max(glm::length(glm::vec3(m[0])),
+                  std::max(glm::length(glm::vec3(m[1])),glm::length(glm::vec3(m[2]))));
+    result.radius = radius*scale;
+    return result;
+}
+
+// ============== Frustum ==============
+
+// Gribb and Hartmann: each plane is the last row of the matrix
+// plus or minus one of the other rows.
+void Frustum::ExtractPlanes(const glm::mat4& m){
+    // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0],m[1][0],m[2][0],m[3][0]);
+    glm::vec4 row1(m[0][1],m[1][1],m[2][1],m[3][1]);
+    glm::vec4 row2(m[0][2],m[1][2],m[2][2],m[3][2]);
+    glm::vec4 row3(m[0][3],m[1][3],m[2][3],m[3][3]);
+    planes[Left]   = row3+row0;
+    planes[Right]  = row3-row0;
+    planes[Bottom] = row3+row1;
+    planes[Top]    = row3-row1;
+    planes[Near]   = row3+row2;
+    planes[Far]    = row3-row2;
+    // Normalize so distances are in world units
+    for(int i=0; i < Count; ++i){
+        float length = glm::length(glm::vec3(planes[i]));
+        if(length > 0.0f){
+            planes[i] /= length;
+        }
+    }
+}
+
+Containment Frustum::TestAABB(const AABB& box) const{
+    if(!box.IsValid()){
+        return Containment::Outside;
+    }
+    glm::vec3 center = box.GetCenter();
+    glm::vec3 extents = box.GetExtents();
+    Containment result = Containment::Inside;
+    for(int i=0; i < Count; ++i){
+        glm::vec3 normal(planes[i]);
+        // Signed distance of the center, and how far the box reaches towards the plane
+        float distance = glm::dot(normal,center)+planes[i].w;
+        float radius = glm::dot(glm::abs(normal),extents);
+        if(distance < -radius){
+            return Containment::Outside;
+        }
+        if(distance < radius){
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+void Frustum::TestAABBs(const AABB* const* boxes, unsigned int count, Containment* results) const{
+    unsigned int i=0;
+#ifdef BOUNDS_USE_SSE
+    for(; i+4 <= count; i+=4){
+        // Gather four boxes into center/extent lanes
+        alignas(16) float cx[4], cy[4], cz[4], ex[4], ey[4], ez[4];
+        int invalidMask = 0;
+        for(int j=0; j < 4; ++j){
+            const AABB& box = *boxes[i+j];
+            if(!box.IsValid()){
+                invalidMask |= 1 << j;
+            }
+            glm::vec3 center = box.GetCenter();
+            glm::vec3 extents = box.GetExtents();
+            cx[j] = center.x;  cy[j] = center.y;  cz[j] = center.z;
+            ex[j] = extents.x; ey[j] = extents.y; ez[j] = extents.z;
+        }
+        __m128 centerX = _mm_load_ps(cx), centerY = _mm_load_ps(cy), centerZ = _mm_load_ps(cz);
+        __m128 extentX = _mm_load_ps(ex), extentY = _mm_load_ps(ey), extentZ = _mm_load_ps(ez);
+        __m128 outside = _mm_setzero_ps();
+        __m128 intersecting = _mm_setzero_ps();
+        for(int p=0; p < Count; ++p){
+            const glm::vec4& plane = planes[p];
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x),centerX),
+                                                    _mm_mul_ps(_mm_set1_ps(plane.y),centerY)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z),centerZ),
+                                                    _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)),extentX),
+                                                  _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)),extentY)),
+                                       _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)),extentZ));
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(),radius);
+            outside = _mm_or_ps(outside,_mm_cmplt_ps(distance,negativeRadius));
+            intersecting = _mm_or_ps(intersecting,_mm_cmplt_ps(distance,radius));
+        }
+        int outsideMask = _mm_movemask_ps(outside) | invalidMask;
+        int intersectingMask = _mm_movemask_ps(intersecting);
+        for(int j=0; j < 4; ++j){
+            if(outsideMask & (1 << j)){
+                results[i+j] = Containment::Outside;
+            }else if(intersectingMask & (1 << j)){
+                results[i+j] = Containment::Intersecting;
+            }else{
+                results[i+j] = Containment::Inside;
+            }
+        }
+    }
+#endif
+    // Whatever is left (or everything, without SSE)
+    for(; i < count; ++i){
+        results[i] = TestAABB(*boxes[i]);
+    }
+}
+
+Containment Frustum::TestSphere(const BoundingSphere& sphere) const{
+    if(!sphere.IsValid()){
+        return Containment::Outside;
+    }
+    Containment result = Containment::Inside;
+    for(int i=0; i < Count; ++i){
+        float distance = glm::dot(glm::vec3(planes[i]),sphere.center)+planes[i].w;
+        if(distance < -sphere.radius){
+            return Containment::Outside;
+        }
+        if(distance < sphere.radius){
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
@@ -12,38 +12,45 @@ void Camera::MouseLook(int mouseX, int mouseY){
     glm::vec2 mouseDelta = 0.01f*(newMousePosition-m_oldMousePosition);
 
     m_viewDirection = glm::mat3(glm::rotate(-mouseDelta.x, m_upVector)) * m_viewDirection;
-    
-    // Update our old position after we have made changes 
+    m_viewDirty = true;
+
+    // Update our old position after we have made changes
     m_oldMousePosition = newMousePosition;
 }
 
-// OPTIONAL TODO: 
+// OPTIONAL TODO:
 //               The camera could really be improved by
 //               updating the eye position along the m_viewDirection.
 //               Think about how you can do this for a better camera!
 
 void Camera::MoveForward(float speed){
     m_eyePosition.z -= speed;
+    m_viewDirty = true;
 }
 
 void Camera::MoveBackward(float speed){
     m_eyePosition.z += speed;
+    m_viewDirty = true;
 }
 
 void Camera::MoveLeft(float speed){
     m_eyePosition.x -= speed;
+    m_viewDirty = true;
 }
 
 void Camera::MoveRight(float speed){
     m_eyePosition.x += speed;
+    m_viewDirty = true;
 }
 
 void Camera::MoveUp(float speed){
     m_eyePosition.y += speed;
+    m_viewDirty = true;
 }
 
 void Camera::MoveDown(float speed){
     m_eyePosition.y -= speed;
+    m_viewDirty = true;
 }
 
 // Set the position for the camera
@@ -51,29 +58,38 @@ void Camera::SetCameraEyePosition(float x, float y, float z){
     m_eyePosition.x = x;
     m_eyePosition.y = y;
     m_eyePosition.z = z;
+    m_viewDirty = true;
+}
+
+void Camera::LookAt(float x, float y, float z){
+    glm::vec3 direction = glm::vec3(x,y,z)-m_eyePosition;
+    if(glm::length(direction) > 0.0f){
+        m_viewDirection = glm::normalize(direction);
+        m_viewDirty = true;
+    }
 }
 
-float Camera::GetEyeXPosition(){
+float Camera::GetEyeXPosition() const{
     return m_eyePosition.x;
 }
 
-float Camera::GetEyeYPosition(){
+float Camera::GetEyeYPosition() const{
     return m_eyePosition.y;
 }
 
-float Camera::GetEyeZPosition(){
+float Camera::GetEyeZPosition() const{
     return m_eyePosition.z;
 }
 
-float Camera::GetViewXDirection(){
+float Camera::GetViewXDirection() const{
     return m_viewDirection.x;
 }
 
-float Camera::GetViewYDirection(){
+float Camera::GetViewYDirection() const{
     return m_viewDirection.y;
 }
 
-float Camera::GetViewZDirection(){
+float Camera::GetViewZDirection() const{
     return m_viewDirection.z;
 }
 
@@ -87,12 +103,86 @@ Camera::Camera(){
     m_viewDirection = glm::vec3(0.0f,0.0f, -1.0f);
 	// For now--our upVector always points up along the y-axis
     m_upVector = glm::vec3(0.0f, 1.0f, 0.0f);
-}
-
-glm::mat4 Camera::GetWorldToViewmatrix() const{
-    // Think about the second argument and why that is
-    // setup as it is.
-    return glm::lookAt( m_eyePosition,
-                        m_eyePosition + m_viewDirection,
-                        m_upVector);
+    // A square viewport until told otherwise
+    SetPerspective(glm::radians(45.0f), 1, 1, 0.1f, 512.0f);
+}
+
+void Camera::SetPerspective(float fovYRadians, unsigned int width, unsigned int height,
+                            float nearPlane, float farPlane){
+    m_fovY = fovYRadians;
+    m_width = width > 0 ? width : 1;
+    m_height = height > 0 ? height : 1;
+    m_nearPlane = nearPlane;
+    m_farPlane = farPlane;
+    m_projectionDirty = true;
+}
+
+void Camera::SetJitter(float x, float y){
+    if(x!=m_jitter.x || y!=m_jitter.y){
+        m_jitter = glm::vec2(x,y);
+        m_projectionDirty = true;
+    }
+}
+
+// Radical inverse in base 2 and 3
+glm::vec2 Camera::HaltonJitter(unsigned int index){
+    // Index 0 would always be (0,0)
+    ++index;
+    glm::vec2 result(0.0f,0.0f);
+    const unsigned int bases[2] = {2,3};
+    for(int axis=0; axis < 2; ++axis){
+        float fraction = 1.0f;
+        for(unsigned int i=index; i > 0; i /= bases[axis]){
+            fraction /= bases[axis];
+            result[axis] += fraction*(i % bases[axis]);
+        }
+    }
+    return result-glm::vec2(0.5f,0.5f);
+}
+
+void Camera::UpdateMatrices() const{
+    if(!m_viewDirty && !m_projectionDirty){
+        return;
+    }
+    if(m_viewDirty){
+        // Think about the second argument and why that is
+        // setup as it is.
+        m_view = glm::lookAt( m_eyePosition,
+                              m_eyePosition + m_viewDirection,
+                              m_upVector);
+    }
+    if(m_projectionDirty){
+        m_unjitteredProjection = glm::perspective(m_fovY,((float)m_width)/((float)m_height),m_nearPlane,m_farPlane);
+        // A pixel is 2/width wide after the divide by w. The third column
+        // is multiplied by view z, which is -w, so subtracting there moves
+        // every point by the same amount on screen.
+        m_projection = m_unjitteredProjection;
+        m_projection[2][0] -= 2.0f*m_jitter.x/m_width;
+        m_projection[2][1] -= 2.0f*m_jitter.y/m_height;
+    }
+    // Culling ignores the jitter
+    m_frustum.ExtractPlanes(m_unjitteredProjection * m_view);
+    m_viewProjection = m_projection * m_view;
+    m_viewDirty = false;
+    m_projectionDirty = false;
+}
+
+const glm::mat4& Camera::GetWorldToViewmatrix() const{
+    UpdateMatrices();
+    return m_view;
+}
+
+const glm::mat4& Camera::GetProjectionMatrix() const{
+    UpdateMatrices();
+    return m_projection;
+}
+
+const glm::mat4& Camera::GetViewProjectionMatrix() const{
+    UpdateMatrices();
+    return m_viewProjection;
+}
+
+const Frustum& Camera::GetFrustum() const{
+    UpdateMatrices();
+    return m_frustum;
 }
@@ -0,0 +1,469 @@
+#include "DynamicAABBTree.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <utility>
+
+// How much every leaf box is enlarged on each side
+static const float FAT_MARGIN = 0.1f;
+// How far ahead (in multiples of the last movement) to enlarge moving boxes
+static const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+DynamicAABBTree::DynamicAABBTree(){
+}
+
+void DynamicAABBTree::Clear(){
+    m_nodes.clear();
+    m_root = NULL_NODE;
+    m_freeList = NULL_NODE;
+    m_proxyCount = 0;
+}
+
+int DynamicAABBTree::AllocateNode(){
+    if(m_freeList==NULL_NODE){
+        m_nodes.push_back(TreeNode());
+        m_nodes.back().height = 0;
+        return m_nodes.size()-1;
+    }
+    int index = m_freeList;
+    m_freeList = m_nodes[index].parent;
+    m_nodes[index] = TreeNode();
+    m_nodes[index].height = 0;
+    return index;
+}
+
+void DynamicAABBTree::FreeNode(int index){
+    m_nodes[index].parent = m_freeList;
+    m_nodes[index].height = -1;
+    m_nodes[index].userData = nullptr;
+    m_freeList = index;
+}
+
+int DynamicAABBTree::CreateProxy(const AABB& box, void* userData){
+    int proxy = AllocateNode();
+    TreeNode& node = m_nodes[proxy];
+    node.tightBox = box;
+    node.box = box;
+    node.box.min -= glm::vec3(FAT_MARGIN);
+    node.box.max += glm::vec3(FAT_MARGIN);
+    node.userData = userData;
+    InsertLeaf(proxy);
+    ++m_proxyCount;
+    return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int proxy){
+    if(proxy < 0 || proxy >= (int)m_nodes.size() || !m_nodes[proxy].IsLeaf() || m_nodes[proxy].height < 0){
+        std::cout << "(DynamicAABBTree.cpp) ERROR, invalid proxy " << proxy << "\n";
+        return;
+    }
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --m_proxyCount;
+}
+
+bool DynamicAABBTree::MoveProxy(int proxy, const AABB& box, const glm::vec3& displacement){
+    TreeNode& node = m_nodes[proxy];
+    node.tightBox = box;
+    // Still within our fat box, so the tree does not change
+    if(node.box.Contains(box)){
+        return false;
+    }
+    RemoveLeaf(proxy);
+    // Enlarge by the margin, and further in the direction of travel
+    AABB fat = box;
+    fat.min -= glm::vec3(FAT_MARGIN);
+    fat.max += glm::vec3(FAT_MARGIN);
+    glm::vec3 predicted = displacement*DISPLACEMENT_MULTIPLIER;
+    fat.min += glm::min(predicted,glm::vec3(0.0f));
+    fat.max += glm::max(predicted,glm::vec3(0.0f));
+    m_nodes[proxy].box = fat;
+    InsertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::InsertLeaf(int leaf){
+    if(m_root==NULL_NODE){
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down towards the sibling that is cheapest to pair with,
+    // where cost is the surface area added to the tree.
+    AABB leafBox = m_nodes[leaf].box;
+    int index = m_root;
+    while(!m_nodes[index].IsLeaf()){
+        const TreeNode& node = m_nodes[index];
+        int child1 = node.child1;
+        int child2 = node.child2;
+        float area = node.box.GetSurfaceArea();
+        float combinedArea = AABB::Union(node.box,leafBox).GetSurfaceArea();
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2.0f*combinedArea;
+        // Every ancestor grows by this much if we go further down
+        float inheritanceCost = 2.0f*(combinedArea-area);
+
+        float cost1 = AABB::Union(leafBox,m_nodes[child1].box).GetSurfaceArea() + inheritanceCost;
+        if(!m_nodes[child1].IsLeaf()){
+            cost1 -= m_nodes[child1].box.GetSurfaceArea();
+        }
+        float cost2 = AABB::Union(leafBox,m_nodes[child2].box).GetSurfaceArea() + inheritanceCost;
+        if(!m_nodes[child2].IsLeaf()){
+            cost2 -= m_nodes[child2].box.GetSurfaceArea();
+        }
+        if(cost < cost1 && cost < cost2){
+            break;
+        }
+        index = cost1 < cost2 ? child1 : child2;
+    }
+    int sibling = index;
+
+    // Make a new parent for the sibling and the leaf
+    int oldParent = m_nodes[sibling].parent;
+    int newParent = AllocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].box = AABB::Union(leafBox,m_nodes[sibling].box);
+    m_nodes[newParent].height = m_nodes[sibling].height+1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+    if(oldParent!=NULL_NODE){
+        if(m_nodes[oldParent].child1==sibling){
+            m_nodes[oldParent].child1 = newParent;
+        }else{
+            m_nodes[oldParent].child2 = newParent;
+        }
+    }else{
+        m_root = newParent;
+    }
+
+    Refit(m_nodes[leaf].parent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int leaf){
+    if(leaf==m_root){
+        m_root = NULL_NODE;
+        return;
+    }
+    int parent = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].child1==leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    // Our sibling takes our parent's place
+    if(grandParent!=NULL_NODE){
+        if(m_nodes[grandParent].child1==parent){
+            m_nodes[grandParent].child1 = sibling;
+        }else{
+            m_nodes[grandParent].child2 = sibling;
+        }
+        m_nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+        Refit(grandParent);
+    }else{
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+    }
+    m_nodes[leaf].parent = NULL_NODE;
+}
+
+void DynamicAABBTree::Refit(int index){
+    while(index!=NULL_NODE){
+        index = Balance(index);
+        int child1 = m_nodes[index].child1;
+        int child2 = m_nodes[index].child2;
+        m_nodes[index].height = 1+std::max(m_nodes[child1].height,m_nodes[child2].height);
+        m_nodes[index].box = AABB::Union(m_nodes[child1].box,m_nodes[child2].box);
+        index = m_nodes[index].parent;
+    }
+}
+
+// If one child is more than one level taller than the other,
+// the taller child is rotated up into A's place.
+int DynamicAABBTree::Balance(int iA){
+    TreeNode* A = &m_nodes[iA];
+    if(A->IsLeaf() || A->height < 2){
+        return iA;
+    }
+    int iB = A->child1;
+    int iC = A->child2;
+    TreeNode* B = &m_nodes[iB];
+    TreeNode* C = &m_nodes[iC];
+    int balance = C->height - B->height;
+
+    // Rotate C up
+    if(balance > 1){
+        int iF = C->child1;
+        int iG = C->child2;
+        TreeNode* F = &m_nodes[iF];
+        TreeNode* G = &m_nodes[iG];
+
+        C->child1 = iA;
+        C->parent = A->parent;
+        A->parent = iC;
+        if(C->parent!=NULL_NODE){
+            if(m_nodes[C->parent].child1==iA){
+                m_nodes[C->parent].child1 = iC;
+            }else{
+                m_nodes[C->parent].child2 = iC;
+            }
+        }else{
+            m_root = iC;
+        }
+        // The taller of C's children stays with C
+        if(F->height > G->height){
+            C->child2 = iF;
+            A->child2 = iG;
+            G->parent = iA;
+            A->box = AABB::Union(B->box,G->box);
+            C->box = AABB::Union(A->box,F->box);
+            A->height = 1+std::max(B->height,G->height);
+            C->height = 1+std::max(A->height,F->height);
+        }else{
+            C->child2 = iG;
+            A->child2 = iF;
+            F->parent = iA;
+            A->box = AABB::Union(B->box,F->box);
+            C->box = AABB::Union(A->box,G->box);
+            A->height = 1+std::max(B->height,F->height);
+            C->height = 1+std::max(A->height,G->height);
+        }
+        return iC;
+    }
+
+    // Rotate B up
+    if(balance < -1){
+        int iD = B->child1;
+        int iE = B->child2;
+        TreeNode* D = &m_nodes[iD];
+        TreeNode* E = &m_nodes[iE];
+
+        B->child1 = iA;
+        B->parent = A->parent;
+        A->parent = iB;
+        if(B->parent!=NULL_NODE){
+            if(m_nodes[B->parent].child1==iA){
+                m_nodes[B->parent].child1 = iB;
+            }else{
+                m_nodes[B->parent].child2 = iB;
+            }
+        }else{
+            m_root = iB;
+        }
+        // The taller of B's children stays with B
+        if(D->height > E->height){
+            B->child2 = iD;
+            A->child1 = iE;
+            E->parent = iA;
+            A->box = AABB::Union(C->box,E->box);
+            B->box = AABB::Union(A->box,D->box);
+            A->height = 1+std::max(C->height,E->height);
+            B->height = 1+std::max(A->height,D->height);
+        }else{
+            B->child2 = iE;
+            A->child1 = iD;
+            D->parent = iA;
+            A->box = AABB::Union(C->box,D->box);
+            B->box = AABB::Union(A->box,E->box);
+            A->height = 1+std::max(C->height,D->height);
+            B->height = 1+std::max(A->height,E->height);
+        }
+        return iB;
+    }
+    return iA;
+}
+
+int DynamicAABBTree::GetHeight() const{
+    return m_root==NULL_NODE ? 0 : m_nodes[m_root].height;
+}
+
+void DynamicAABBTree::CollectLeaves(int index, std::vector<int>& results) const{
+    std::vector<int> stack;
+    stack.push_back(index);
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        if(node.IsLeaf()){
+            results.push_back(current);
+        }else{
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void DynamicAABBTree::QueryFrustum(const Frustum& frustum, std::vector<int>& results) const{
+    m_lastVisitCount = 0;
+    if(m_root==NULL_NODE){
+        return;
+    }
+    std::vector<int> stack;
+    stack.push_back(m_root);
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        if(node.IsLeaf()){
+            if(frustum.TestAABB(node.tightBox)!=Containment::Outside){
+                results.push_back(current);
+            }
+            continue;
+        }
+        Containment containment = frustum.TestAABB(node.box);
+        if(containment==Containment::Inside){
+            // Everything below is visible, no more tests needed
+            --m_lastVisitCount;
+            CollectLeaves(current,results);
+        }else if(containment==Containment::Intersecting){
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void DynamicAABBTree::QueryAABB(const AABB& box, std::vector<int>& results) const{
+    m_lastVisitCount = 0;
+    if(m_root==NULL_NODE){
+        return;
+    }
+    std::vector<int> stack;
+    stack.push_back(m_root);
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        if(node.IsLeaf()){
+            if(node.tightBox.Overlaps(box)){
+                results.push_back(current);
+            }
+        }else if(node.box.Overlaps(box)){
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void DynamicAABBTree::QuerySphere(const glm::vec3& center, float radius, std::vector<int>& results) const{
+    m_lastVisitCount = 0;
+    if(m_root==NULL_NODE){
+        return;
+    }
+    float radiusSquared = radius*radius;
+    std::vector<int> stack;
+    stack.push_back(m_root);
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        if(node.IsLeaf()){
+            if(node.tightBox.DistanceSquared(center) <= radiusSquared){
+                results.push_back(current);
+            }
+        }else if(node.box.DistanceSquared(center) <= radiusSquared){
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+int DynamicAABBTree::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                             float* hitDistance) const{
+    m_lastVisitCount = 0;
+    int closest = NULL_NODE;
+    if(m_root==NULL_NODE){
+        return closest;
+    }
+    glm::vec3 inverseDirection = 1.0f/direction;
+    // Anything further than our best hit so far can be skipped
+    float best = maxDistance;
+    std::vector<int> stack;
+    stack.push_back(m_root);
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        float distance;
+        if(node.IsLeaf()){
+            if(node.tightBox.IntersectRay(origin,inverseDirection,best,distance)){
+                best = distance;
+                closest = current;
+            }
+        }else if(node.box.IntersectRay(origin,inverseDirection,best,distance)){
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+    if(closest!=NULL_NODE && hitDistance!=nullptr){
+        *hitDistance = best;
+    }
+    return closest;
+}
+
+// Best first search: always expand whichever node could be closest.
+// A leaf that comes off the queue is nearer than anything left.
+void DynamicAABBTree::QueryNearest(const glm::vec3& point, unsigned int k, std::vector<int>& results) const{
+    m_lastVisitCount = 0;
+    if(m_root==NULL_NODE || k==0){
+        return;
+    }
+    typedef std::pair<float,int> Entry;
+    std::priority_queue<Entry,std::vector<Entry>,std::greater<Entry>> pending;
+    pending.push(Entry(m_nodes[m_root].box.DistanceSquared(point),m_root));
+    unsigned int found = 0;
+    while(!pending.empty() && found < k){
+        int current = pending.top().second;
+        pending.pop();
+        ++m_lastVisitCount;
+        const TreeNode& node = m_nodes[current];
+        if(node.IsLeaf()){
+            // Leaves are queued by their actual box, see below
+            results.push_back(current);
+            ++found;
+            continue;
+        }
+        int children[2] = {node.child1,node.child2};
+        for(int i=0; i < 2; ++i){
+            const TreeNode& child = m_nodes[children[i]];
+            const AABB& box = child.IsLeaf() ? child.tightBox : child.box;
+            pending.push(Entry(box.DistanceSquared(point),children[i]));
+        }
+    }
+}
+
+bool DynamicAABBTree::ValidateNode(int index) const{
+    const TreeNode& node = m_nodes[index];
+    if(node.IsLeaf()){
+        return node.height==0 && node.box.Contains(node.tightBox);
+    }
+    const TreeNode& child1 = m_nodes[node.child1];
+    const TreeNode& child2 = m_nodes[node.child2];
+    if(child1.parent!=index || child2.parent!=index){
+        std::cout << "(DynamicAABBTree.cpp) ERROR, bad parent link at " << index << "\n";
+        return false;
+    }
+    if(node.height!=1+std::max(child1.height,child2.height)){
+        std::cout << "(DynamicAABBTree.cpp) ERROR, bad height at " << index << "\n";
+        return false;
+    }
+    if(!node.box.Contains(child1.box) || !node.box.Contains(child2.box)){
+        std::cout << "(DynamicAABBTree.cpp) ERROR, box does not hold children at " << index << "\n";
+        return false;
+    }
+    return ValidateNode(node.child1) && ValidateNode(node.child2);
+}
+
+bool DynamicAABBTree::Validate() const{
+    if(m_root==NULL_NODE){
+        return m_proxyCount==0;
+    }
+    return m_nodes[m_root].parent==NULL_NODE && ValidateNode(m_root);
+}
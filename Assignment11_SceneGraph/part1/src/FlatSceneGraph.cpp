@@ -0,0 +1,314 @@
+#include "FlatSceneGraph.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define FLAT_USE_SSE
+#endif
+
+using MatrixBlock = FlatSceneGraph::MatrixBlock;
+
+// Guards the list of moved nodes when nodes are copied out in parallel
+static std::mutex s_movedNodesMutex;
+
+// Copies a matrix into lane k of a block
+static void StoreLane(MatrixBlock& block, unsigned int k, const glm::mat4& m){
+    for(int j=0; j < 4; ++j){
+        for(int i=0; i < 3; ++i){
+            block.c[j*3+i][k] = m[j][i];
+        }
+    }
+}
+
+// Reads lane k of a block back into a matrix
+static glm::mat4 LoadLane(const MatrixBlock& block, unsigned int k){
+    glm::mat4 m(1.0f);
+    for(int j=0; j < 4; ++j){
+        for(int i=0; i < 3; ++i){
+            m[j][i] = block.c[j*3+i][k];
+        }
+    }
+    return m;
+}
+
+// worlds[n] = worlds[parents[n]] * locals[n] for the slots of blocks
+// [firstBlock, lastBlock). Parents must be in earlier blocks.
+static void MultiplyBlocks(const int* parents, const MatrixBlock* locals, MatrixBlock* worlds,
+                           unsigned int firstBlock, unsigned int lastBlock){
+#ifdef FLAT_USE_SSE
+    // Parent components, one lane per node
+    __m128 p[12];
+    int lastParent = -1;
+    for(unsigned int b=firstBlock; b < lastBlock; ++b){
+        const int* blockParents = parents+4*b;
+        if(blockParents[0]==blockParents[3]){
+            // Siblings (the usual case) share one parent, which
+            // often is the same as the last block's
+            if(blockParents[0]!=lastParent){
+                lastParent = blockParents[0];
+                const MatrixBlock& parent = worlds[lastParent/4];
+                for(int c=0; c < 12; ++c){
+                    p[c] = _mm_set1_ps(parent.c[c][lastParent%4]);
+                }
+            }
+        }else{
+            lastParent = -1;
+            const float* p0 = &worlds[blockParents[0]/4].c[0][blockParents[0]%4];
+            const float* p1 = &worlds[blockParents[1]/4].c[0][blockParents[1]%4];
+            const float* p2 = &worlds[blockParents[2]/4].c[0][blockParents[2]%4];
+            const float* p3 = &worlds[blockParents[3]/4].c[0][blockParents[3]%4];
+            for(int c=0; c < 12; ++c){
+                p[c] = _mm_setr_ps(p0[4*c],p1[4*c],p2[4*c],p3[4*c]);
+            }
+        }
+        const MatrixBlock& local = locals[b];
+        MatrixBlock& world = worlds[b];
+        for(int j=0; j < 4; ++j){
+            __m128 x = _mm_load_ps(local.c[j*3]);
+            __m128 y = _mm_load_ps(local.c[j*3+1]);
+            __m128 z = _mm_load_ps(local.c[j*3+2]);
+            for(int i=0; i < 3; ++i){
+                __m128 r = _mm_mul_ps(p[i],x);
+                r = _mm_add_ps(r,_mm_mul_ps(p[3+i],y));
+                r = _mm_add_ps(r,_mm_mul_ps(p[6+i],z));
+                if(j==3){
+                    r = _mm_add_ps(r,p[9+i]);
+                }
+                _mm_store_ps(world.c[j*3+i],r);
+            }
+        }
+    }
+#else
+    for(unsigned int b=firstBlock; b < lastBlock; ++b){
+        for(unsigned int k=0; k < 4; ++k){
+            int parent = parents[4*b+k];
+            const MatrixBlock& pb = worlds[parent/4];
+            unsigned int pk = parent%4;
+            for(int j=0; j < 4; ++j){
+                for(int i=0; i < 3; ++i){
+                    float r = pb.c[i][pk]*locals[b].c[j*3][k]
+                            + pb.c[3+i][pk]*locals[b].c[j*3+1][k]
+                            + pb.c[6+i][pk]*locals[b].c[j*3+2][k];
+                    if(j==3){
+                        r += pb.c[9+i][pk];
+                    }
+                    worlds[b].c[j*3+i][k] = r;
+                }
+            }
+        }
+    }
+#endif
+}
+
+FlatSceneGraph::FlatSceneGraph(){
+    Clear();
+}
+
+void FlatSceneGraph::Clear(){
+    m_parents.clear();
+    m_localBlocks.clear();
+    m_worldBlocks.clear();
+    m_slots.clear();
+    m_nodes.clear();
+    m_objects.clear();
+    m_firstChildren.clear();
+    m_subtreeBounds.clear();
+    m_subtreeSpheres.clear();
+    m_levelStarts.assign(1,0);
+    m_levelSlots.assign(1,0);
+}
+
+void FlatSceneGraph::Build(SceneNode* root){
+    Clear();
+    if(root==nullptr){
+        return;
+    }
+    m_structureVersion = SceneNode::GetStructureVersion();
+    unsigned int count = root->GetSubtreeNodeCount();
+    m_nodes.reserve(count);
+    m_slots.reserve(count);
+    m_firstChildren.reserve(count+1);
+    // Node index of each node's parent, only needed while building
+    std::vector<int> parentNodes(1,NO_PARENT);
+    parentNodes.reserve(count);
+    m_nodes.push_back(root);
+    m_levelStarts.clear();
+    m_levelSlots.clear();
+    // Each pass gives the current level its slots and queues the next level
+    unsigned int levelFirst = 0;
+    while(levelFirst < m_nodes.size()){
+        unsigned int levelLast = m_nodes.size();
+        m_levelStarts.push_back(levelFirst);
+        m_levelSlots.push_back(m_parents.size());
+        for(unsigned int n=levelFirst; n < levelLast; ++n){
+            int parent = parentNodes[n];
+            m_slots.push_back(m_parents.size());
+            m_parents.push_back(parent==NO_PARENT ? parent : (int)m_slots[parent]);
+        }
+        // Padding shares the last node's parent, so it never splits a run of siblings
+        while(m_parents.size()%4!=0){
+            m_parents.push_back(m_parents.back());
+        }
+        // Children of a node end up next to each other in the next level
+        for(unsigned int n=levelFirst; n < levelLast; ++n){
+            SceneNode* node = m_nodes[n];
+            m_firstChildren.push_back(m_nodes.size());
+            for(unsigned int i=0; i < node->GetChildCount(); ++i){
+                m_nodes.push_back(node->GetChild(i));
+                parentNodes.push_back(n);
+            }
+        }
+        levelFirst = levelLast;
+    }
+    m_firstChildren.push_back(m_nodes.size());
+    m_levelStarts.push_back(m_nodes.size());
+    m_levelSlots.push_back(m_parents.size());
+    m_objects.resize(m_nodes.size());
+    for(unsigned int n=0; n < m_nodes.size(); ++n){
+        m_objects[n] = m_nodes[n]->m_object;
+    }
+    m_subtreeBounds.resize(m_nodes.size());
+    m_subtreeSpheres.resize(m_nodes.size());
+    m_localBlocks.resize(m_parents.size()/4);
+    m_worldBlocks.resize(m_parents.size()/4);
+}
+
+bool FlatSceneGraph::GatherLocals(unsigned int level, unsigned int firstBlock, unsigned int lastBlock){
+    // Within a level nodes and slots line up, the padding is at the end
+    unsigned int firstNode = m_levelStarts[level] + (4*firstBlock - m_levelSlots[level]);
+    unsigned int lastNode = std::min(m_levelStarts[level+1], m_levelStarts[level] + (4*lastBlock - m_levelSlots[level]));
+    for(unsigned int n=firstNode; n < lastNode; ++n){
+        const SceneNode* node = m_nodes[n];
+        glm::mat4 local = node->m_localTransform.GetInternalMatrix();
+        // The top of the view may have a parent outside of it,
+        // which SceneNode::Update would start from as well
+        if(n==0 && node->m_parent!=nullptr){
+            local = node->m_parent->m_worldTransform.GetInternalMatrix() * local;
+        }
+        if(local[0][3]!=0.0f || local[1][3]!=0.0f || local[2][3]!=0.0f || local[3][3]!=1.0f){
+            return false;
+        }
+        unsigned int slot = m_slots[n];
+        StoreLane(m_localBlocks[slot/4], slot%4, local);
+    }
+    return true;
+}
+
+void FlatSceneGraph::ComputeWorlds(unsigned int level, unsigned int firstBlock, unsigned int lastBlock){
+    if(level==0){
+        // The top level has no parent in the view
+        for(unsigned int b=firstBlock; b < lastBlock; ++b){
+            m_worldBlocks[b] = m_localBlocks[b];
+        }
+        return;
+    }
+    MultiplyBlocks(m_parents.data(), m_localBlocks.data(), m_worldBlocks.data(), firstBlock, lastBlock);
+}
+
+void FlatSceneGraph::ComputeSubtreeBounds(unsigned int node){
+    // The same merge as SceneNode::UpdateSubtreeBounds, in the same order
+    AABB bounds;
+    BoundingSphere sphere;
+    Object* object = m_objects[node];
+    if(object!=nullptr){
+        const AABB& localBounds = object->GetLocalBounds();
+        glm::mat4 world = GetWorldMatrix(node);
+        bounds = localBounds.Transformed(world);
+        sphere = BoundingSphere::FromAABB(localBounds).Transformed(world);
+    }
+    for(unsigned int c=m_firstChildren[node]; c < m_firstChildren[node+1]; ++c){
+        bounds.Expand(m_subtreeBounds[c]);
+        sphere.Expand(m_subtreeSpheres[c]);
+    }
+    m_subtreeBounds[node] = bounds;
+    m_subtreeSpheres[node] = sphere;
+}
+
+bool FlatSceneGraph::GatherLocalTransforms(){
+    std::atomic<bool> affine{true};
+    for(unsigned int level=0; level < GetLevelCount(); ++level){
+        unsigned int firstBlock = m_levelSlots[level]/4;
+        JobSystem::Instance().ParallelFor(m_levelSlots[level+1]/4-firstBlock, BLOCKS_PER_JOB,
+            [this,level,firstBlock,&affine](unsigned int first, unsigned int last){
+                if(!GatherLocals(level, firstBlock+first, firstBlock+last)){
+                    affine = false;
+                }
+            });
+    }
+    return affine;
+}
+
+void FlatSceneGraph::UpdateWorldMatrices(){
+    // Every level only reads the one before it, so the blocks
+    // within a level can be split between jobs.
+    for(unsigned int level=0; level < GetLevelCount(); ++level){
+        unsigned int firstBlock = m_levelSlots[level]/4;
+        JobSystem::Instance().ParallelFor(m_levelSlots[level+1]/4-firstBlock, BLOCKS_PER_JOB,
+            [this,level,firstBlock](unsigned int first, unsigned int last){
+                ComputeWorlds(level, firstBlock+first, firstBlock+last);
+            });
+    }
+}
+
+bool FlatSceneGraph::Update(std::vector<SceneNode*>* movedNodes){
+    if(m_nodes.empty()){
+        return true;
+    }
+    // (1) Local transforms in and world matrices, top down. Nodes are
+    // only read, so giving up part way leaves every node as it was.
+    std::atomic<bool> affine{true};
+    for(unsigned int level=0; level < GetLevelCount() && affine; ++level){
+        unsigned int firstBlock = m_levelSlots[level]/4;
+        JobSystem::Instance().ParallelFor(m_levelSlots[level+1]/4-firstBlock, BLOCKS_PER_JOB,
+            [this,level,firstBlock,&affine](unsigned int first, unsigned int last){
+                if(!GatherLocals(level, firstBlock+first, firstBlock+last)){
+                    affine = false;
+                    return;
+                }
+                ComputeWorlds(level, firstBlock+first, firstBlock+last);
+            });
+    }
+    if(!affine){
+        return false;
+    }
+    // (2) Subtree bounds, deepest level first so every child is
+    // ready before its parent. This only touches our own arrays.
+    for(unsigned int level=GetLevelCount(); level-- > 0;){
+        unsigned int levelFirst = m_levelStarts[level];
+        JobSystem::Instance().ParallelFor(m_levelStarts[level+1]-levelFirst, NODES_PER_JOB,
+            [this,levelFirst](unsigned int first, unsigned int last){
+                for(unsigned int n=levelFirst+first; n < levelFirst+last; ++n){
+                    ComputeSubtreeBounds(n);
+                }
+            });
+    }
+    // (3) Everything back out to the nodes, in any order
+    JobSystem::Instance().ParallelFor(m_nodes.size(), NODES_PER_JOB,
+        [this,movedNodes](unsigned int first, unsigned int last){
+            // Each group collects its own list, then adds it in one go
+            std::vector<SceneNode*> moved;
+            for(unsigned int n=first; n < last; ++n){
+                SceneNode* node = m_nodes[n];
+                node->m_worldTransform.SetInternalMatrix(GetWorldMatrix(n));
+                node->m_dirty = false;
+                node->m_childDirty = false;
+                node->UpdateWorldBounds(movedNodes!=nullptr ? &moved : nullptr);
+                node->m_subtreeBounds = m_subtreeBounds[n];
+                node->m_subtreeSphere = m_subtreeSpheres[n];
+            }
+            if(!moved.empty()){
+                std::lock_guard<std::mutex> lock(s_movedNodesMutex);
+                movedNodes->insert(movedNodes->end(),moved.begin(),moved.end());
+            }
+        });
+    return true;
+}
+
+glm::mat4 FlatSceneGraph::GetWorldMatrix(unsigned int node) const{
+    unsigned int slot = m_slots[node];
+    return LoadLane(m_worldBlocks[slot/4], slot%4);
+}
@@ -50,6 +50,15 @@ void Geometry::AddIndex(unsigned int i){
     }
 }
 
+// Walks every vertex position to find the box around them
+AABB Geometry::ComputeBounds() const{
+	AABB bounds;
+	for(unsigned int i=0; i+2 < m_vertexPositions.size(); i+=3){
+		bounds.Expand(glm::vec3(m_vertexPositions[i],m_vertexPositions[i+1],m_vertexPositions[i+2]));
+	}
+	return bounds;
+}
+
 // Retrieves a pointer to our data.
 float* Geometry::GetBufferDataPtr(){
 	return m_bufferData.data();
@@ -0,0 +1,164 @@
+#include "JobSystem.hpp"
+
+#include <iostream>
+
+// Which queue the current thread uses. Worker i uses queue i+1,
+// the main thread (and any other thread) uses queue 0.
+static thread_local unsigned int t_threadIndex = 0;
+
+JobSystem::JobSystem(){
+}
+
+JobSystem& JobSystem::Instance(){
+    // Never deleted, Shutdown() joins our threads
+    static JobSystem* instance = new JobSystem();
+    return *instance;
+}
+
+void JobSystem::Initialize(unsigned int workerCount, bool deterministic){
+    Shutdown();
+    ResetStats();
+    m_deterministic = deterministic;
+    if(deterministic){
+        workerCount = 0;
+    }else if(workerCount==0){
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads-1 : 0;
+    }
+    // Queue 0 is for the calling thread
+    for(unsigned int i=0; i < workerCount+1; ++i){
+        m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    m_running = true;
+    for(unsigned int i=0; i < workerCount; ++i){
+        m_workers.push_back(std::thread(&JobSystem::WorkerLoop,this,i+1));
+    }
+    std::cout << "(JobSystem.cpp) Running jobs on " << GetThreadCount() << " thread(s)"
+              << (deterministic ? " in deterministic mode\n" : "\n");
+}
+
+void JobSystem::Shutdown(){
+    if(!m_running){
+        return;
+    }
+    // Finish anything left on our own queue
+    while(m_queuedJobs > 0 && RunOneJob(0)){
+    }
+    m_running = false;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wakeCondition.notify_all();
+    for(unsigned int i=0; i < m_workers.size(); ++i){
+        m_workers[i].join();
+    }
+    m_workers.clear();
+    m_queues.clear();
+}
+
+unsigned int JobSystem::GetThreadIndex() const{
+    return t_threadIndex < m_queues.size() ? t_threadIndex : 0;
+}
+
+void JobSystem::Run(const Job& job, JobCounter& counter){
+    counter.pending.fetch_add(1);
+    // Without workers (or in deterministic mode) just run the job now
+    if(m_queues.size() <= 1){
+        job();
+        counter.pending.fetch_sub(1);
+        return;
+    }
+    JobCounter* c = &counter;
+    WorkQueue& queue = *m_queues[GetThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back([job,c](){
+            job();
+            c->pending.fetch_sub(1);
+        });
+    }
+    m_queuedJobs.fetch_add(1);
+    // Taking the lock makes sure a worker that just found no work
+    // is either already asleep (and gets woken) or sees our job.
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wakeCondition.notify_one();
+}
+
+bool JobSystem::RunOneJob(unsigned int index){
+    Job job;
+    // Newest job from our own queue first, it is most likely in cache
+    {
+        WorkQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty()){
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+    }
+    // Otherwise steal the oldest job from someone else
+    if(!job){
+        for(unsigned int i=1; i < m_queues.size() && !job; ++i){
+            WorkQueue& victim = *m_queues[(index+i)%m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.jobs.empty()){
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                ++m_steals;
+            }
+        }
+    }
+    if(!job){
+        return false;
+    }
+    m_queuedJobs.fetch_sub(1);
+    job();
+    return true;
+}
+
+void JobSystem::Wait(JobCounter& counter){
+    unsigned int index = GetThreadIndex();
+    // Help out rather than block, our jobs may be waiting on a queue
+    while(counter.pending > 0){
+        if(m_queues.empty() || !RunOneJob(index)){
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::WorkerLoop(unsigned int index){
+    t_threadIndex = index;
+    while(m_running){
+        if(RunOneJob(index)){
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeCondition.wait(lock,[this](){ return m_queuedJobs > 0 || !m_running; });
+    }
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize,
+                            const std::function<void(unsigned int, unsigned int)>& fn){
+    if(count==0){
+        return;
+    }
+    if(grainSize==0){
+        grainSize = 1;
+    }
+    // Small ranges are not worth handing out
+    if(count <= grainSize || m_queues.size() <= 1){
+        fn(0,count);
+        return;
+    }
+    JobCounter counter;
+    for(unsigned int first=0; first < count; first+=grainSize){
+        unsigned int last = first+grainSize < count ? first+grainSize : count;
+        Run([&fn,first,last](){ fn(first,last); }, counter);
+    }
+    Wait(counter);
+}
+
+void JobSystem::ResetStats(){
+    m_steals = 0;
+}
@@ -65,6 +65,27 @@ void Object::Bind(){
         m_textureDiffuse.Bind(0);
 }
 
+GLuint Object::GetVertexArrayID() const{
+    return m_vertexBufferLayout.GetID();
+}
+
+GLuint Object::GetDiffuseTextureID() const{
+    return m_textureDiffuse.GetID();
+}
+
+unsigned int Object::GetIndexCount(){
+    return m_geometry.GetIndicesSize();
+}
+
+const AABB& Object::GetLocalBounds(){
+    // Our geometry is built once, so the bounds only need computing once
+    if(!m_localBoundsComputed){
+        m_localBounds = m_geometry.ComputeBounds();
+        m_localBoundsComputed = true;
+    }
+    return m_localBounds;
+}
+
 // Render our geometry
 void Object::Render(){
     // Call our helper function to just bind everything
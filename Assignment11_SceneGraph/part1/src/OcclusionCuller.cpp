@@ -0,0 +1,311 @@
+#include "OcclusionCuller.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define OCCLUSION_USE_SSE
+#endif
+
+// Every pixel of a tile is covered
+static const uint32_t FULL_MASK = 0xFFFFFFFF;
+// Triangles set up per job
+static const unsigned int TRIANGLES_PER_JOB = 1024;
+// Tile rows rasterized per job
+static const unsigned int ROWS_PER_JOB = 2;
+
+OcclusionCuller::OcclusionCuller(){
+    Resize(256,128);
+}
+
+void OcclusionCuller::Resize(unsigned int width, unsigned int height){
+    m_tilesX = std::max(1u,(width+TILE_WIDTH-1)/TILE_WIDTH);
+    m_tilesY = std::max(1u,(height+TILE_HEIGHT-1)/TILE_HEIGHT);
+    m_width = m_tilesX*TILE_WIDTH;
+    m_height = m_tilesY*TILE_HEIGHT;
+    m_tileDepth.assign(m_tilesX*m_tilesY,1.0f);
+    m_tileWorkingDepth.assign(m_tilesX*m_tilesY,0.0f);
+    m_tileMask.assign(m_tilesX*m_tilesY,0);
+    m_rasterizedTriangles = 0;
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection){
+    m_viewProjection = viewProjection;
+    // Keep the memory around for next frame
+    m_vertices.clear();
+    m_indices.clear();
+    std::fill(m_tileDepth.begin(),m_tileDepth.end(),1.0f);
+    std::fill(m_tileWorkingDepth.begin(),m_tileWorkingDepth.end(),0.0f);
+    std::fill(m_tileMask.begin(),m_tileMask.end(),0);
+    m_rasterizedTriangles = 0;
+}
+
+void OcclusionCuller::AddOccluder(const float* positions, unsigned int vertexCount,
+                                  const unsigned int* indices, unsigned int indexCount,
+                                  const glm::mat4& model){
+    for(unsigned int i=0; i < indexCount; ++i){
+        if(indices[i] >= vertexCount){
+            std::cout << "(OcclusionCuller.cpp) ERROR, index " << indices[i] << " is out of range\n";
+            return;
+        }
+    }
+    unsigned int firstVertex = m_vertices.size();
+    glm::mat4 modelViewProjection = m_viewProjection * model;
+    for(unsigned int i=0; i < vertexCount; ++i){
+        glm::vec4 clip = modelViewProjection * glm::vec4(positions[i*3],positions[i*3+1],positions[i*3+2],1.0f);
+        // Vertices in front of the near plane get a negative depth,
+        // which makes their triangles get skipped.
+        glm::vec4 screen(0.0f,0.0f,-1.0f,clip.w);
+        if(clip.w > 0.0f && clip.z >= -clip.w){
+            float inverseW = 1.0f/clip.w;
+            screen.x = (clip.x*inverseW*0.5f+0.5f)*m_width;
+            screen.y = (clip.y*inverseW*0.5f+0.5f)*m_height;
+            screen.z = clip.z*inverseW*0.5f+0.5f;
+        }
+        m_vertices.push_back(screen);
+    }
+    // Only whole triangles
+    unsigned int usedIndices = indexCount-indexCount%3;
+    for(unsigned int i=0; i < usedIndices; ++i){
+        m_indices.push_back(firstVertex+indices[i]);
+    }
+}
+
+void OcclusionCuller::Rasterize(){
+    auto start = std::chrono::steady_clock::now();
+    JobSystem& jobs = JobSystem::Instance();
+
+    unsigned int triangleCount = m_indices.size()/3;
+    m_triangles.resize(triangleCount);
+    jobs.ParallelFor(triangleCount, TRIANGLES_PER_JOB, [this](unsigned int first, unsigned int last){
+        for(unsigned int i=first; i < last; ++i){
+            SetupTriangle(i);
+        }
+    });
+    m_rasterizedTriangles = 0;
+    for(unsigned int i=0; i < triangleCount; ++i){
+        m_rasterizedTriangles += m_triangles[i].valid;
+    }
+    // Each job owns whole rows of tiles, so no two threads touch the same tile
+    if(m_rasterizedTriangles > 0){
+        jobs.ParallelFor(m_tilesY, ROWS_PER_JOB, [this](unsigned int first, unsigned int last){
+            RasterizeRows(first,last);
+        });
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    m_lastRasterizeMs = std::chrono::duration<double,std::milli>(end-start).count();
+}
+
+void OcclusionCuller::SetupTriangle(unsigned int index){
+    ScreenTriangle& triangle = m_triangles[index];
+    triangle.valid = false;
+    glm::vec4 v0 = m_vertices[m_indices[index*3]];
+    glm::vec4 v1 = m_vertices[m_indices[index*3+1]];
+    glm::vec4 v2 = m_vertices[m_indices[index*3+2]];
+    // Clipped by the near plane. Skipping it only loses some occlusion.
+    if(v0.z < 0.0f || v1.z < 0.0f || v2.z < 0.0f){
+        return;
+    }
+    // Both sides are rasterized, so wind every triangle counter clockwise
+    float area = (v1.x-v0.x)*(v2.y-v0.y) - (v2.x-v0.x)*(v1.y-v0.y);
+    if(std::fabs(area) < 1e-6f){
+        return;
+    }
+    if(area < 0.0f){
+        std::swap(v1,v2);
+        area = -area;
+    }
+    // Pixels the triangle's bounding box touches
+    float minX = std::min(v0.x,std::min(v1.x,v2.x));
+    float maxX = std::max(v0.x,std::max(v1.x,v2.x));
+    float minY = std::min(v0.y,std::min(v1.y,v2.y));
+    float maxY = std::max(v0.y,std::max(v1.y,v2.y));
+    if(maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height){
+        return;
+    }
+    triangle.tileMinX = (int)std::max(minX,0.0f)/TILE_WIDTH;
+    triangle.tileMaxX = (int)std::min(maxX,(float)(m_width-1))/TILE_WIDTH;
+    triangle.tileMinY = (int)std::max(minY,0.0f)/TILE_HEIGHT;
+    triangle.tileMaxY = (int)std::min(maxY,(float)(m_height-1))/TILE_HEIGHT;
+
+    // Edge from a to b, positive on the inside of a counter clockwise triangle
+    const glm::vec4* corners[3] = {&v0,&v1,&v2};
+    for(int e=0; e < 3; ++e){
+        const glm::vec4& a = *corners[e];
+        const glm::vec4& b = *corners[(e+1)%3];
+        triangle.edgeA[e] = a.y-b.y;
+        triangle.edgeB[e] = b.x-a.x;
+        triangle.edgeC[e] = a.x*b.y-a.y*b.x;
+    }
+    // Depth is linear in screen space
+    triangle.depthX = ((v1.z-v0.z)*(v2.y-v0.y) - (v2.z-v0.z)*(v1.y-v0.y))/area;
+    triangle.depthY = ((v2.z-v0.z)*(v1.x-v0.x) - (v1.z-v0.z)*(v2.x-v0.x))/area;
+    triangle.depth0 = v0.z - triangle.depthX*v0.x - triangle.depthY*v0.y;
+    triangle.maxDepth = std::max(v0.z,std::max(v1.z,v2.z));
+    triangle.valid = true;
+}
+
+void OcclusionCuller::RasterizeRows(unsigned int firstRow, unsigned int lastRow){
+    for(unsigned int i=0; i < m_triangles.size(); ++i){
+        const ScreenTriangle& triangle = m_triangles[i];
+        if(!triangle.valid || triangle.tileMaxY < (int)firstRow || triangle.tileMinY >= (int)lastRow){
+            continue;
+        }
+        int rowEnd = std::min(triangle.tileMaxY,(int)lastRow-1);
+        for(int tileY=std::max(triangle.tileMinY,(int)firstRow); tileY <= rowEnd; ++tileY){
+            for(int tileX=triangle.tileMinX; tileX <= triangle.tileMaxX; ++tileX){
+                unsigned int tile = tileY*m_tilesX+tileX;
+                // The farthest the triangle gets within this tile
+                float x = (float)(tileX*TILE_WIDTH + (triangle.depthX > 0.0f ? TILE_WIDTH : 0));
+                float y = (float)(tileY*TILE_HEIGHT + (triangle.depthY > 0.0f ? TILE_HEIGHT : 0));
+                float depth = std::min(triangle.depth0+triangle.depthX*x+triangle.depthY*y, triangle.maxDepth);
+                // Already behind what covers the tile
+                if(depth >= m_tileDepth[tile]){
+                    continue;
+                }
+                uint32_t coverage = ComputeCoverage(triangle,tileX,tileY);
+                if(coverage!=0){
+                    UpdateTile(tile,coverage,depth);
+                }
+            }
+        }
+    }
+}
+
+uint32_t OcclusionCuller::ComputeCoverage(const ScreenTriangle& triangle, unsigned int tileX, unsigned int tileY) const{
+    // Sample at pixel centers
+    float x0 = tileX*TILE_WIDTH+0.5f;
+    float y0 = tileY*TILE_HEIGHT+0.5f;
+    uint32_t coverage = 0;
+#ifdef OCCLUSION_USE_SSE
+    // Each edge is evaluated for the left and right four pixels of a row,
+    // then stepped down one row at a time.
+    const __m128 columns = _mm_setr_ps(0.0f,1.0f,2.0f,3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 left[3], right[3], stepY[3];
+    for(int e=0; e < 3; ++e){
+        __m128 a = _mm_set1_ps(triangle.edgeA[e]);
+        __m128 base = _mm_set1_ps(triangle.edgeA[e]*x0+triangle.edgeB[e]*y0+triangle.edgeC[e]);
+        left[e] = _mm_add_ps(base,_mm_mul_ps(a,columns));
+        right[e] = _mm_add_ps(left[e],_mm_mul_ps(a,_mm_set1_ps(4.0f)));
+        stepY[e] = _mm_set1_ps(triangle.edgeB[e]);
+    }
+    for(unsigned int row=0; row < TILE_HEIGHT; ++row){
+        __m128 insideLeft = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(left[0],zero),_mm_cmpge_ps(left[1],zero)),
+                                       _mm_cmpge_ps(left[2],zero));
+        __m128 insideRight = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(right[0],zero),_mm_cmpge_ps(right[1],zero)),
+                                        _mm_cmpge_ps(right[2],zero));
+        uint32_t bits = _mm_movemask_ps(insideLeft) | (_mm_movemask_ps(insideRight) << 4);
+        coverage |= bits << (row*TILE_WIDTH);
+        for(int e=0; e < 3; ++e){
+            left[e] = _mm_add_ps(left[e],stepY[e]);
+            right[e] = _mm_add_ps(right[e],stepY[e]);
+        }
+    }
+#else
+    for(unsigned int row=0; row < TILE_HEIGHT; ++row){
+        for(unsigned int column=0; column < TILE_WIDTH; ++column){
+            float x = x0+column;
+            float y = y0+row;
+            bool inside = true;
+            for(int e=0; e < 3; ++e){
+                inside = inside && triangle.edgeA[e]*x+triangle.edgeB[e]*y+triangle.edgeC[e] >= 0.0f;
+            }
+            if(inside){
+                coverage |= 1u << (row*TILE_WIDTH+column);
+            }
+        }
+    }
+#endif
+    return coverage;
+}
+
+// Depth grows away from the camera. The working layer collects partial
+// coverage until the whole tile is covered, at which point its farthest
+// depth becomes the tile's depth.
+void OcclusionCuller::UpdateTile(unsigned int tile, uint32_t coverage, float depth){
+    float& committed = m_tileDepth[tile];
+    float& working = m_tileWorkingDepth[tile];
+    uint32_t& mask = m_tileMask[tile];
+    if(coverage==FULL_MASK){
+        committed = depth;
+        // The working layer can no longer improve anything
+        if(working >= committed){
+            working = 0.0f;
+            mask = 0;
+        }
+        return;
+    }
+    // A triangle much closer to the committed layer than to the working one
+    // would push the working layer's depth back; start a new layer instead.
+    if(mask!=0 && depth-working > committed-depth){
+        working = 0.0f;
+        mask = 0;
+    }
+    working = std::max(working,depth);
+    mask |= coverage;
+    if(mask==FULL_MASK){
+        committed = std::min(committed,working);
+        working = 0.0f;
+        mask = 0;
+    }
+}
+
+bool OcclusionCuller::IsOccluded(const AABB& box) const{
+    if(!box.IsValid() || m_rasterizedTriangles==0){
+        return false;
+    }
+    // Screen rectangle and nearest depth of the box's corners
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    float nearest = 1e30f;
+    for(int i=0; i < 8; ++i){
+        glm::vec4 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z, 1.0f);
+        glm::vec4 clip = m_viewProjection * corner;
+        // Crosses the near plane, so it is right in front of us
+        if(clip.w <= 0.0f || clip.z < -clip.w){
+            return false;
+        }
+        float inverseW = 1.0f/clip.w;
+        float x = (clip.x*inverseW*0.5f+0.5f)*m_width;
+        float y = (clip.y*inverseW*0.5f+0.5f)*m_height;
+        minX = std::min(minX,x);
+        maxX = std::max(maxX,x);
+        minY = std::min(minY,y);
+        maxY = std::max(maxY,y);
+        nearest = std::min(nearest,clip.z*inverseW*0.5f+0.5f);
+    }
+    // Off screen boxes are the frustum's job
+    if(maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height){
+        return false;
+    }
+    unsigned int tileMinX = (unsigned int)std::max(minX,0.0f)/TILE_WIDTH;
+    unsigned int tileMaxX = (unsigned int)std::min(maxX,(float)(m_width-1))/TILE_WIDTH;
+    unsigned int tileMinY = (unsigned int)std::max(minY,0.0f)/TILE_HEIGHT;
+    unsigned int tileMaxY = (unsigned int)std::min(maxY,(float)(m_height-1))/TILE_HEIGHT;
+    // Visible as soon as one tile's occluders are not in front of the box
+    for(unsigned int tileY=tileMinY; tileY <= tileMaxY; ++tileY){
+        const float* row = &m_tileDepth[tileY*m_tilesX];
+        unsigned int tileX = tileMinX;
+#ifdef OCCLUSION_USE_SSE
+        __m128 boxDepth = _mm_set1_ps(nearest);
+        for(; tileX+4 <= tileMaxX+1; tileX+=4){
+            if(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row+tileX),boxDepth))!=0){
+                return false;
+            }
+        }
+#endif
+        for(; tileX <= tileMaxX; ++tileX){
+            if(row[tileX] >= nearest){
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,175 @@
+#include "OcclusionQueries.hpp"
+#include "SceneNode.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+// Corners of a unit cube
+static float s_cubeVertices[] = {
+    0.0f,0.0f,0.0f,  1.0f,0.0f,0.0f,  1.0f,1.0f,0.0f,  0.0f,1.0f,0.0f,
+    0.0f,0.0f,1.0f,  1.0f,0.0f,1.0f,  1.0f,1.0f,1.0f,  0.0f,1.0f,1.0f
+};
+// Two triangles per face
+static unsigned int s_cubeIndices[] = {
+    0,2,1, 0,3,2,   // back
+    4,5,6, 4,6,7,   // front
+    0,1,5, 0,5,4,   // bottom
+    3,6,2, 3,7,6,   // top
+    0,4,7, 0,7,3,   // left
+    1,2,6, 1,6,5    // right
+};
+
+OcclusionQueries::OcclusionQueries(){
+}
+
+OcclusionQueries::~OcclusionQueries(){
+    Clear();
+    delete m_boxShader;
+    delete m_box;
+}
+
+void OcclusionQueries::Clear(){
+    for(auto& entry : m_nodes){
+        if(entry.second.query!=0){
+            glDeleteQueries(1,&entry.second.query);
+        }
+    }
+    m_nodes.clear();
+    m_pending.clear();
+    m_boxQueries.clear();
+}
+
+void OcclusionQueries::Remove(const SceneNode* node){
+    auto entry = m_nodes.find(node);
+    if(entry==m_nodes.end()){
+        return;
+    }
+    if(entry->second.pending){
+        m_pending.erase(std::remove(m_pending.begin(),m_pending.end(),node),m_pending.end());
+        m_boxQueries.erase(std::remove(m_boxQueries.begin(),m_boxQueries.end(),node),m_boxQueries.end());
+    }
+    glDeleteQueries(1,&entry->second.query);
+    m_nodes.erase(entry);
+}
+
+void OcclusionQueries::BeginFrame(){
+    ++m_frame;
+    m_stats = OcclusionQueryStats();
+    m_boxQueries.clear();
+    unsigned int stillPending = 0;
+    for(unsigned int i=0; i < m_pending.size(); ++i){
+        const SceneNode* node = m_pending[i];
+        NodeQuery& state = m_nodes[node];
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available==GL_FALSE){
+            // Asking for the result now would stall, try again next frame
+            ++m_stats.stallsAvoided;
+            m_pending[stillPending] = node;
+            ++stillPending;
+            continue;
+        }
+        GLuint anySamples = GL_FALSE;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamples);
+        state.pending = false;
+        state.visible = anySamples!=GL_FALSE;
+        if(!state.visible && state.boxQuery){
+            m_stats.drawsSaved += state.conditionalDraws;
+        }
+        state.conditionalDraws = 0;
+        if(state.visible){
+            // Spread the checks of visible nodes over several frames
+            unsigned int offset = (unsigned int)((reinterpret_cast<uintptr_t>(node) >> 4) % VISIBLE_QUERY_INTERVAL);
+            state.nextQueryFrame = m_frame + VISIBLE_QUERY_INTERVAL + offset;
+        }
+    }
+    m_pending.resize(stillPending);
+}
+
+void OcclusionQueries::Issue(const SceneNode* node, NodeQuery& state, bool boxQuery){
+    state.pending = true;
+    state.boxQuery = boxQuery;
+    m_pending.push_back(node);
+    ++m_stats.queriesIssued;
+}
+
+void OcclusionQueries::Assign(RenderQueue& queue, RenderQueue& hidden, const glm::vec3& eye, float nearDistance){
+    for(unsigned int i=0; i < queue.GetPacketCount(); ++i){
+        DrawPacket& packet = queue.GetPacket(i);
+        if(packet.node==nullptr){
+            continue;
+        }
+        NodeQuery& state = m_nodes[packet.node];
+        if(state.query==0){
+            glGenQueries(1,&state.query);
+        }
+        // Too close for its box to be trusted
+        if(packet.node->GetWorldBounds().DistanceSquared(eye) < nearDistance*nearDistance){
+            state.visible = true;
+            continue;
+        }
+        if(state.visible){
+            // Drawn regardless, the query tells us if it is still worth drawing
+            if(!state.pending && m_frame >= state.nextQueryFrame){
+                packet.query = state.query;
+                Issue(packet.node, state, false);
+            }
+        }else{
+            // Drawn only if its box shows up, which the GPU decides
+            if(!state.pending){
+                m_boxQueries.push_back(packet.node);
+                Issue(packet.node, state, true);
+            }
+            packet.query = state.query;
+            packet.conditional = true;
+            ++state.conditionalDraws;
+            ++m_stats.drawsConditional;
+        }
+    }
+    queue.MoveConditionalPackets(hidden);
+}
+
+void OcclusionQueries::IssueBoxQueries(const glm::mat4& viewProjection){
+    if(m_boxQueries.empty()){
+        return;
+    }
+    if(m_boxShader==nullptr){
+        CreateBoxResources();
+    }
+    // Only the depth test matters, nothing is written
+    glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+    glDepthMask(GL_FALSE);
+    GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+    glDisable(GL_CULL_FACE);
+
+    m_boxShader->Bind();
+    m_boxShader->SetUniformMatrix4fv("u_ViewProjection", &viewProjection[0][0]);
+    m_box->Bind();
+    for(unsigned int i=0; i < m_boxQueries.size(); ++i){
+        const SceneNode* node = m_boxQueries[i];
+        const AABB& bounds = node->GetWorldBounds();
+        m_boxShader->SetUniform3f("u_BoxMin", bounds.min.x, bounds.min.y, bounds.min.z);
+        m_boxShader->SetUniform3f("u_BoxMax", bounds.max.x, bounds.max.y, bounds.max.z);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, m_nodes[node].query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+    }
+
+    if(cullFace){
+        glEnable(GL_CULL_FACE);
+    }
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+}
+
+void OcclusionQueries::CreateBoxResources(){
+    m_boxShader = new Shader();
+    std::string vertexShader = m_boxShader->LoadShader("./shaders/boundsVert.glsl");
+    std::string fragmentShader = m_boxShader->LoadShader("./shaders/boundsFrag.glsl");
+    m_boxShader->CreateShader(vertexShader,fragmentShader);
+
+    m_box = new VertexBufferLayout();
+    m_box->CreatePositionBufferLayout(sizeof(s_cubeVertices)/sizeof(float),
+                                      sizeof(s_cubeIndices)/sizeof(unsigned int),
+                                      s_cubeVertices, s_cubeIndices);
+}
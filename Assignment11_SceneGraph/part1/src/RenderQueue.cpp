@@ -0,0 +1,183 @@
+#include "RenderQueue.hpp"
+
+#include <utility>
+
+// Number of bits each field of the key uses
+static const unsigned int PASS_BITS    = 4;
+static const unsigned int SHADER_BITS  = 12;
+static const unsigned int TEXTURE_BITS = 12;
+static const unsigned int VAO_BITS     = 12;
+static const unsigned int DEPTH_BITS   = 24;
+
+// Where each field starts
+static const unsigned int DEPTH_SHIFT   = 0;
+static const unsigned int VAO_SHIFT     = DEPTH_SHIFT+DEPTH_BITS;
+static const unsigned int TEXTURE_SHIFT = VAO_SHIFT+VAO_BITS;
+static const unsigned int SHADER_SHIFT  = TEXTURE_SHIFT+TEXTURE_BITS;
+static const unsigned int PASS_SHIFT    = SHADER_SHIFT+SHADER_BITS;
+
+// Keeps the low 'bits' bits of a value
+static inline uint64_t Field(uint64_t value, unsigned int bits){
+    return value & ((uint64_t(1) << bits)-1);
+}
+
+uint64_t RenderQueue::MakeSortKey(RenderPass pass, GLuint shader, GLuint texture, GLuint vertexArray, float depth){
+    // Quantize depth, anything outside of [0,1] is clamped
+    if(depth < 0.0f){
+        depth = 0.0f;
+    }else if(depth > 1.0f){
+        depth = 1.0f;
+    }
+    uint64_t quantizedDepth = (uint64_t)(depth*((1 << DEPTH_BITS)-1));
+    // Transparent objects must be drawn back to front
+    if(pass==RenderPass::Transparent){
+        quantizedDepth = ((1 << DEPTH_BITS)-1) - quantizedDepth;
+    }
+    // Ids that do not fit only make the ordering less ideal,
+    // the binds themselves compare the real ids.
+    return (Field((uint64_t)pass, PASS_BITS)       << PASS_SHIFT)    |
+           (Field(shader, SHADER_BITS)             << SHADER_SHIFT)  |
+           (Field(texture, TEXTURE_BITS)           << TEXTURE_SHIFT) |
+           (Field(vertexArray, VAO_BITS)           << VAO_SHIFT)     |
+           (Field(quantizedDepth, DEPTH_BITS)      << DEPTH_SHIFT);
+}
+
+RenderQueue::RenderQueue(){
+}
+
+void RenderQueue::Clear(){
+    // Keep the memory around for next frame
+    m_packets.clear();
+    m_items.clear();
+}
+
+void RenderQueue::Push(uint64_t key, const DrawPacket& packet){
+    SortItem item;
+    item.key = key;
+    item.index = m_packets.size();
+    m_items.push_back(item);
+    m_packets.push_back(packet);
+}
+
+void RenderQueue::Append(const RenderQueue& other){
+    unsigned int offset = m_packets.size();
+    m_packets.insert(m_packets.end(),other.m_packets.begin(),other.m_packets.end());
+    for(unsigned int i=0; i < other.m_items.size(); ++i){
+        SortItem item = other.m_items[i];
+        item.index += offset;
+        m_items.push_back(item);
+    }
+}
+
+void RenderQueue::MoveConditionalPackets(RenderQueue& destination){
+    unsigned int kept = 0;
+    for(unsigned int i=0; i < m_items.size(); ++i){
+        const DrawPacket& packet = m_packets[m_items[i].index];
+        if(packet.conditional){
+            destination.Push(m_items[i].key, packet);
+        }else{
+            m_items[kept] = m_items[i];
+            ++kept;
+        }
+    }
+    // Moved packets stay in m_packets, nothing refers to them anymore
+    m_items.resize(kept);
+}
+
+// Least significant digit radix sort, one byte at a time.
+// The sort is stable so equal keys stay in traversal order.
+void RenderQueue::Sort(){
+    unsigned int count = m_items.size();
+    if(count < 2){
+        return;
+    }
+    m_scratch.resize(count);
+    SortItem* source = m_items.data();
+    SortItem* destination = m_scratch.data();
+    for(unsigned int shift=0; shift < 64; shift+=8){
+        unsigned int histogram[256] = {0};
+        for(unsigned int i=0; i < count; ++i){
+            ++histogram[(source[i].key >> shift) & 0xFF];
+        }
+        // Every key has the same byte here, nothing to do
+        if(histogram[(source[0].key >> shift) & 0xFF]==count){
+            continue;
+        }
+        // Turn counts into starting offsets
+        unsigned int offset = 0;
+        for(unsigned int b=0; b < 256; ++b){
+            unsigned int bucketSize = histogram[b];
+            histogram[b] = offset;
+            offset += bucketSize;
+        }
+        for(unsigned int i=0; i < count; ++i){
+            destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source,destination);
+    }
+    // An odd number of passes leaves the result in our scratch buffer
+    if(source!=m_items.data()){
+        m_items.swap(m_scratch);
+    }
+}
+
+void RenderQueue::Submit(const FrameUniforms& frame){
+    m_stateChanges = 0;
+    // What is currently bound
+    GLuint currentProgram = 0;
+    GLuint currentTexture = 0;
+    GLuint currentVertexArray = 0;
+    bool first = true;
+
+    glActiveTexture(GL_TEXTURE0);
+    for(unsigned int i=0; i < m_items.size(); ++i){
+        const DrawPacket& packet = m_packets[m_items[i].index];
+        Shader* shader = packet.shader;
+        Object* object = packet.object;
+
+        if(first || shader->GetID()!=currentProgram){
+            shader->Bind();
+            currentProgram = shader->GetID();
+            ++m_stateChanges;
+            // Only send the camera and light when this program has stale copies
+            if(shader->GetFrameVersion()!=frame.version){
+                shader->SetUniformMatrix4fv("view", &frame.view[0][0]);
+                shader->SetUniformMatrix4fv("projection", &frame.projection[0][0]);
+                shader->SetUniform3f("lightPos",frame.lightPos.x,frame.lightPos.y,frame.lightPos.z);
+                shader->SetFrameVersion(frame.version);
+            }
+        }
+        GLuint texture = object->GetDiffuseTextureID();
+        if(first || texture!=currentTexture){
+            glBindTexture(GL_TEXTURE_2D, texture);
+            currentTexture = texture;
+            ++m_stateChanges;
+        }
+        GLuint vertexArray = object->GetVertexArrayID();
+        if(first || vertexArray!=currentVertexArray){
+            glBindVertexArray(vertexArray);
+            currentVertexArray = vertexArray;
+            ++m_stateChanges;
+        }
+        first = false;
+
+        shader->SetUniformMatrix4fv(shader->GetModelLocation(), packet.model);
+        // The GPU waits for the query itself, the CPU never does
+        if(packet.conditional){
+            glBeginConditionalRender(packet.query, GL_QUERY_WAIT);
+        }else if(packet.query!=0){
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, packet.query);
+        }
+        glDrawElements(GL_TRIANGLES,
+                       object->GetIndexCount(), // The number of indices, not triangles.
+                       GL_UNSIGNED_INT,         // Make sure the data type matches
+                       nullptr);                // Our index buffer is part of the VAO
+        if(packet.conditional){
+            glEndConditionalRender();
+        }else if(packet.query!=0){
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+        }
+    }
+    // Drawing in traversal order bound all three for every draw
+    m_stateChangesSaved = 3*m_items.size() - m_stateChanges;
+}
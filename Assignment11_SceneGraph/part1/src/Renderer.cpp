@@ -1,4 +1,10 @@
 #include "Renderer.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
 
 
 // Sets the height and width of our renderer
@@ -14,6 +20,16 @@ Renderer::Renderer(unsigned int w, unsigned int h){
     m_cameras.push_back(defaultCamera);
 
     m_root = nullptr;
+
+    // One view covering the whole window
+    RenderView window;
+    window.camera = 0;
+    window.width = w;
+    window.height = h;
+    AddView(window);
+
+    // A small depth buffer with the same shape as the screen
+    m_occlusionCuller.Resize(256, 256*h/w);
 }
 
 // Sets the height and width of our renderer
@@ -24,20 +40,146 @@ Renderer::~Renderer(){
     }
 }
 
-void Renderer::Update(){
+unsigned int Renderer::AddCamera(){
+    Camera* camera = new Camera();
+    camera->SetPerspective(glm::radians(45.0f),m_screenWidth,m_screenHeight,m_nearPlane,m_farPlane);
+    m_cameras.push_back(camera);
+    return m_cameras.size()-1;
+}
+
+int Renderer::AddView(const RenderView& view){
+    if(view.camera >= m_cameras.size()){
+        std::cout << "(Renderer.cpp) ERROR, AddView called with camera " << view.camera
+                  << " but there are only " << m_cameras.size() << "\n";
+        return -1;
+    }
+    // A camera has one projection, so every view of it must have the
+    // same shape. Otherwise the views already using it would be stretched.
+    for(unsigned int i=0; i < m_views.size(); ++i){
+        const RenderView& other = m_views[i].view;
+        if(other.camera==view.camera && (uint64_t)view.width*other.height!=(uint64_t)view.height*other.width){
+            std::cout << "(Renderer.cpp) ERROR, AddView called with a " << view.width << "x" << view.height
+                      << " view of camera " << view.camera << ", which view " << i << " already shows at "
+                      << other.width << "x" << other.height << ". Use another camera for a different shape.\n";
+            return -1;
+        }
+    }
     // Here we apply the projection matrix which creates perspective.
     // The first argument is 'field of view'
-    // Then perspective
+    // Then the size of the view
     // Then the near and far clipping plane.
-    // Note I cannot see anything closer than 0.1f units from the screen.
-    m_projectionMatrix = glm::perspective(glm::radians(45.0f),((float)m_screenWidth)/((float)m_screenHeight),0.1f,512.0f);
+    // Note I cannot see anything closer than m_nearPlane units from the screen.
+    m_cameras[view.camera]->SetPerspective(glm::radians(45.0f),view.width,view.height,m_nearPlane,m_farPlane);
+    ViewState state;
+    state.view = view;
+    state.source = m_views.size();
+    m_views.push_back(state);
+    return m_views.size()-1;
+}
 
-    // Perform the update
+void Renderer::Update(){
+    // The light sits just in front of the camera of view 0,
+    // and lights the scene the same way in every view.
+    const Camera* mainCamera = m_cameras[m_views[0].view.camera];
+    glm::vec3 lightPos = mainCamera->GetEyePosition() + mainCamera->GetViewDirection();
+    unsigned int enabledViews = 0;
+    for(unsigned int i=0; i < m_views.size(); ++i){
+        enabledViews += m_views[i].view.enabled ? 1 : 0;
+    }
+    for(unsigned int i=0; i < m_views.size(); ++i){
+        // The camera only rebuilds its matrices after it moves.
+        const Camera* camera = m_cameras[m_views[i].view.camera];
+        const glm::mat4& view = camera->GetWorldToViewmatrix();
+        const glm::mat4& projection = camera->GetProjectionMatrix();
+        FrameUniforms& uniforms = m_views[i].uniforms;
+        // Nodes only re-upload these when the version changes. With
+        // several views the shaders hold whichever view drew last,
+        // so every view sends its own again.
+        if(enabledViews > 1 || view!=uniforms.view || projection!=uniforms.projection || lightPos!=uniforms.lightPos){
+            uniforms.view = view;
+            uniforms.projection = projection;
+            uniforms.lightPos = lightPos;
+            uniforms.version = ++m_uniformVersion;
+        }
+    }
+
+    // Perform the update once, every view shares it
+    m_movedNodes.clear();
     if(m_root!=nullptr){
-        // TODO: By default, we will only have one camera
-        //       You may otherwise not want to hardcode
-        //       a value of '0' here.
-        m_root->Update(m_projectionMatrix, m_cameras[0]);
+        // When the root changed every node moves, which the flat view does
+        // a level at a time. Otherwise only the changed branches are visited.
+        bool updated = false;
+        if(m_root->IsDirty()){
+            if(m_flatScene.GetRoot()!=m_root || m_flatScene.GetStructureVersion()!=SceneNode::GetStructureVersion()){
+                m_flatScene.Build(m_root);
+            }
+            updated = m_flatScene.Update(&m_movedNodes);
+        }
+        if(!updated){
+            m_root->Update(&m_movedNodes);
+        }
+    }
+    // Only nodes that moved need to touch the spatial index
+    for(unsigned int i=0; i < m_movedNodes.size(); ++i){
+        SceneNode* node = m_movedNodes[i];
+        const AABB& bounds = node->GetWorldBounds();
+        if(node->GetProxy()==DynamicAABBTree::NULL_NODE){
+            node->SetProxy(m_spatialIndex.CreateProxy(bounds,node));
+        }else{
+            glm::vec3 displacement = bounds.GetCenter()-m_spatialIndex.GetTightAABB(node->GetProxy()).GetCenter();
+            m_spatialIndex.MoveProxy(node->GetProxy(),bounds,displacement);
+        }
+    }
+}
+
+SceneNode* Renderer::Pick(int mouseX, int mouseY, float* distance){
+    // Turn the pixel into a ray from the near plane to the far plane
+    // of view 0. Mouse rows count down from the top of the window,
+    // viewports count up from the bottom.
+    const RenderView& view = m_views[0].view;
+    float x = 2.0f*(mouseX-view.x)/view.width - 1.0f;
+    float y = 1.0f - 2.0f*(mouseY-(m_screenHeight-view.y-(int)view.height))/view.height;
+    glm::mat4 inverseViewProjection = glm::inverse(m_cameras[view.camera]->GetViewProjectionMatrix());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x,y,-1.0f,1.0f);
+    glm::vec4 farPoint  = inverseViewProjection * glm::vec4(x,y, 1.0f,1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint)/nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint)/farPoint.w - origin;
+    // The direction spans the whole view, so a hit is within [0,1]
+    float hit = 0.0f;
+    int proxy = m_spatialIndex.Raycast(origin,direction,1.0f,&hit);
+    if(proxy==DynamicAABBTree::NULL_NODE){
+        return nullptr;
+    }
+    if(distance!=nullptr){
+        *distance = hit*glm::length(direction);
+    }
+    return static_cast<SceneNode*>(m_spatialIndex.GetUserData(proxy));
+}
+
+void Renderer::AddOccluder(SceneNode* node){
+    if(node==nullptr || std::find(m_occluders.begin(),m_occluders.end(),node)!=m_occluders.end()){
+        return;
+    }
+    m_occluders.push_back(node);
+}
+
+void Renderer::RemoveOccluder(SceneNode* node){
+    m_occluders.erase(std::remove(m_occluders.begin(),m_occluders.end(),node),m_occluders.end());
+}
+
+void Renderer::SetOcclusionQueries(bool enabled){
+    // Results from before are meaningless once we start again
+    if(enabled!=m_occlusionQueriesEnabled){
+        m_occlusionQueries.Clear();
+    }
+    m_occlusionQueriesEnabled = enabled;
+}
+
+void Renderer::QueryRadius(const glm::vec3& center, float radius, std::vector<SceneNode*>& results){
+    std::vector<int> proxies;
+    m_spatialIndex.QuerySphere(center,radius,proxies);
+    for(unsigned int i=0; i < proxies.size(); ++i){
+        results.push_back(static_cast<SceneNode*>(m_spatialIndex.GetUserData(proxies[i])));
     }
 }
 
@@ -50,28 +192,164 @@ void Renderer::Render(){
     // for us that is stored every frame.
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_TEXTURE_2D); 
-    // This is the background of the screen.
-    glViewport(0, 0, m_screenWidth, m_screenHeight);
-    glClearColor( 0.01f, 0.01f, 0.01f, 1.f );
-    // Clear color buffer and Depth Buffer
-    // Remember that the 'depth buffer' is our
-    // z-buffer that figures out how far away items are every frame
-    // and we have to do this every frame!
-    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-
-    // Nice way to debug your scene in wireframe!
-    //glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
-    
-    // Now we render our objects from our scenegraph
-    if(m_root!=nullptr){
-        m_root->Draw();
+
+    // Views of the same camera see the same nodes, so only the
+    // first of them culls and the rest draw its list.
+    m_cullViews.clear();
+    for(unsigned int i=0; i < m_views.size(); ++i){
+        ViewState& state = m_views[i];
+        if(!state.view.enabled){
+            continue;
+        }
+        state.source = i;
+        for(unsigned int j=0; j < i; ++j){
+            if(m_views[j].view.enabled && m_views[j].view.camera==state.view.camera){
+                state.source = m_views[j].source;
+                break;
+            }
+        }
+        if(state.source==i){
+            m_cullViews.push_back(i);
+            // Built here so the jobs below only read the camera
+            m_cameras[state.view.camera]->GetFrustum();
+        }
+    }
+
+    // Occluders hide things from view 0 only
+    const OcclusionCuller* occlusion = nullptr;
+    bool mainView = m_views[0].view.enabled;
+    if(m_root!=nullptr && mainView && m_occlusionCulling && !m_occluders.empty()){
+        const Camera* camera = m_cameras[m_views[0].view.camera];
+        m_occlusionCuller.Begin(camera->GetViewProjectionMatrix());
+        for(unsigned int i=0; i < m_occluders.size(); ++i){
+            SceneNode* node = m_occluders[i];
+            // Occluders out of view cannot hide anything
+            if(node->GetObject()==nullptr || camera->GetFrustum().TestAABB(node->GetWorldBounds())==Containment::Outside){
+                continue;
+            }
+            const Geometry& geometry = node->GetObject()->GetGeometry();
+            m_occlusionCuller.AddOccluder(geometry.GetPositions().data(), geometry.GetPositions().size()/3,
+                                          geometry.GetIndices().data(), geometry.GetIndices().size(),
+                                          node->GetWorldTransform().GetInternalMatrix());
+        }
+        m_occlusionCuller.Rasterize();
+        occlusion = &m_occlusionCuller;
     }
+
+    // Now we gather the draws of our objects from our scenegraph.
+    // Traversal only reads the nodes, so every view culls at once,
+    // and within a view wide nodes split their children across jobs.
+    // Then the draws are sorted so that draws sharing state end
+    // up next to each other.
+    JobSystem::Instance().ParallelFor(m_cullViews.size(), 1,
+        [this,occlusion](unsigned int first, unsigned int last){
+            for(unsigned int i=first; i < last; ++i){
+                unsigned int index = m_cullViews[i];
+                ViewState& state = m_views[index];
+                state.queue.Clear();
+                state.stats = CullingStats();
+                if(m_root!=nullptr){
+                    // Anything outside of the view volume is skipped
+                    // So is anything hidden behind our occluders
+                    m_root->Submit(state.queue, state.uniforms.view, m_farPlane,
+                                   m_cameras[state.view.camera]->GetFrustum(), state.stats,
+                                   index==0 ? occlusion : nullptr);
+                }
+                state.queue.Sort();
+            }
+        });
+
+    // Draws of nodes the GPU last found hidden are held back
+    m_hiddenQueue.Clear();
+    bool queries = m_occlusionQueriesEnabled && mainView;
+    if(queries){
+        m_occlusionQueries.BeginFrame();
+        m_occlusionQueries.Assign(m_views[0].queue, m_hiddenQueue,
+                                  m_cameras[m_views[0].view.camera]->GetEyePosition(), 2.0f*m_nearPlane);
+        m_hiddenQueue.Sort();
+    }
+
+    // Each view only clears and draws its own rectangle
+    glEnable(GL_SCISSOR_TEST);
+    for(unsigned int i=0; i < m_views.size(); ++i){
+        ViewState& state = m_views[i];
+        const RenderView& view = state.view;
+        if(!view.enabled){
+            continue;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, view.framebuffer);
+        glViewport(view.x, view.y, view.width, view.height);
+        glScissor(view.x, view.y, view.width, view.height);
+        // This is the background of the screen.
+        glClearColor( 0.01f, 0.01f, 0.01f, 1.f );
+        // Clear color buffer and Depth Buffer
+        // Remember that the 'depth buffer' is our
+        // z-buffer that figures out how far away items are every frame
+        // and we have to do this every frame!
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+        // Nice way to debug your scene in wireframe!
+        //glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
+
+        m_views[state.source].queue.Submit(state.uniforms);
+        // Then drawn only if their bounding boxes turn out to be visible
+        if(queries && state.source==0){
+            if(i==0){
+                m_occlusionQueries.IssueBoxQueries(m_cameras[view.camera]->GetViewProjectionMatrix());
+            }
+            m_hiddenQueue.Submit(state.uniforms);
+        }
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::DestroyNode(NodeHandle handle){
+    SceneNode* node = SceneNode::Get(handle);
+    if(node==nullptr){
+        std::cout << "(Renderer.cpp) ERROR, DestroyNode called with a stale handle\n";
+        return;
+    }
+    std::function<void(SceneNode*)> forget = [this,&forget](SceneNode* n){
+        if(n->GetProxy()!=DynamicAABBTree::NULL_NODE){
+            m_spatialIndex.DestroyProxy(n->GetProxy());
+            n->SetProxy(DynamicAABBTree::NULL_NODE);
+        }
+        RemoveOccluder(n);
+        m_occlusionQueries.Remove(n);
+        for(unsigned int i=0; i < n->GetChildCount(); ++i){
+            forget(n->GetChild(i));
+        }
+    };
+    forget(node);
+    // Stop drawing from a root that is about to go away
+    for(SceneNode* p = m_root; p!=nullptr; p = p->GetParent()){
+        if(p==node){
+            m_root = nullptr;
+            break;
+        }
+    }
+    SceneNode::Destroy(handle);
 }
 
 // Determines what the root is of the renderer, so the
 // scene can be drawn.
 void Renderer::setRoot(SceneNode* startingNode){
     m_root = startingNode;
+    // Start a new spatial index, every node is added again on the next Update
+    m_spatialIndex.Clear();
+    std::function<void(SceneNode*)> resetProxies = [&resetProxies](SceneNode* node){
+        node->SetProxy(DynamicAABBTree::NULL_NODE);
+        for(unsigned int i=0; i < node->GetChildCount(); ++i){
+            resetProxies(node->GetChild(i));
+        }
+    };
+    // Query results belong to the old scene
+    m_occlusionQueries.Clear();
+    if(m_root!=nullptr){
+        resetProxies(m_root);
+        m_root->MarkDirty();
+    }
 }
 
 
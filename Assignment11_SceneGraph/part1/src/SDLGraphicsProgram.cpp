@@ -2,7 +2,12 @@
 #include "Camera.hpp"
 #include "Terrain.hpp"
 #include "Sphere.hpp"
+#include "JobSystem.hpp"
+#include "ObjectManager.hpp"
+#include "SceneFile.hpp"
+#include "Animator.hpp"
 
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -80,6 +85,9 @@ SDLGraphicsProgram::SDLGraphicsProgram(int w, int h){
 	GetOpenGLVersionInfo();
 
 
+    // Start our worker threads
+    JobSystem::Instance().Initialize();
+
     // Setup our Renderer
     m_renderer = new Renderer(w,h);    
 }
@@ -90,6 +98,7 @@ SDLGraphicsProgram::~SDLGraphicsProgram(){
     if(m_renderer!=nullptr){
         delete m_renderer;
     }
+    JobSystem::Instance().Shutdown();
 
 
     //Destroy window
@@ -110,56 +119,95 @@ bool SDLGraphicsProgram::InitGL(){
 	return success;
 }
 
-// ====================== Create the planets =============
-// NOTE: I will admit it is a little lazy to have these as globals,
-//       we could build on our ObjectManager structure to manage the
-//       each object that is inserted and automatically create a 'SceneNode'
-//       for it for example. Or otherwise, build a 'SceneTree' class that
-//       manages creating nodes and setting their type.
-//       (e.g. A good use of the Factory Design Pattern if you'd like to
-//             invetigate further--but it is beyond the scope of this assignment).
-
-// Create the Moon
-Object* sphere3;
-SceneNode* Moon;
-// Create the Earth
-Object* sphere2;
-SceneNode* Earth;
-// Create the Sun
-Object* sphere;
-SceneNode* Sun;
-// ====================== Create the planets =============
-
 //Loops forever!
 void SDLGraphicsProgram::Loop(){
 
     // ================== Initialize the planets ===============
-    static float rotate = 0.0f;
-
-    // Create new geometry for Earth's Moon
-    sphere3 = new Sphere();
-    sphere3->LoadTexture("./../../common/textures/rock.ppm");
-    // Create a new node using sphere3 as the geometry
-    Moon = new SceneNode(sphere3);
-
-    // Create the Earth
-    sphere2 = new Sphere();
-    sphere2->LoadTexture("./../../common/textures/earth.ppm");
-    Earth = new SceneNode(sphere2);
-    // Create the Sun
-    sphere = new Sphere();
-    sphere->LoadTexture("./../../common/textures/sun.ppm");
-    Sun = new SceneNode(sphere);
-
-    // Render our scene starting from the sun.
-    m_renderer->setRoot(Sun);
-    // Make the Earth a child of the Sun
-    Sun->AddChild(Earth);
-    // Make the Moon a child of the Earth
-    Earth->AddChild(Moon);
+    ObjectManager& objects = ObjectManager::Instance();
+    // The scene is authored in scenes/solarsystem.txt and compiled
+    // into a binary file that loads without any parsing. The binary
+    // file is compiled again whenever it is missing, from an older
+    // version of SceneFile, or out of date with the text.
+    SceneFile sceneFile;
+    if(!sceneFile.Open("./scenes/solarsystem.scn","./scenes/solarsystem.txt")){
+        if(!SceneFile::Compile("./scenes/solarsystem.txt","./scenes/solarsystem.scn") ||
+           !sceneFile.Open("./scenes/solarsystem.scn")){
+            std::cout << "(SDLGraphicsProgram.cpp) ERROR, could not load the scene\n";
+            return;
+        }
+    }
+    // Every asset in the scene is a textured sphere
+    auto loadAsset = [&objects](const char* mesh, const char* texture) -> Object*{
+        if(std::string(mesh)!="sphere"){
+            std::cout << "(SDLGraphicsProgram.cpp) ERROR, unknown mesh " << mesh << "\n";
+            return nullptr;
+        }
+        Sphere* sphere = objects.GetObject(objects.Create<Sphere>());
+        if(texture[0]!='\0'){
+            sphere->LoadTexture(texture);
+        }
+        return sphere;
+    };
+    std::vector<NodeHandle> nodes;
+    NodeHandle root = sceneFile.Instantiate(loadAsset, nodes);
+    if(root.IsNull()){
+        return;
+    }
+    // Render our scene starting from the root.
+    m_renderer->setRoot(SceneNode::Get(root));
+    // Large nodes hide whatever is behind them
+    for(unsigned int i=0; i < nodes.size(); ++i){
+        if(sceneFile.GetNodeFlags()[i] & SceneFile::FLAG_OCCLUDER){
+            m_renderer->AddOccluder(SceneNode::Get(nodes[i]));
+        }
+    }
+    // The animation below expects these planets
+    int sun = sceneFile.FindNode("Sun");
+    int earth = sceneFile.FindNode("Earth");
+    int moon = sceneFile.FindNode("Moon");
+    if(sun < 0 || earth < 0 || moon < 0){
+        std::cout << "(SDLGraphicsProgram.cpp) ERROR, the scene needs a Sun, Earth and Moon\n";
+        m_renderer->DestroyNode(root);
+        objects.RemoveAll();
+        return;
+    }
+
+    // Each orbit is one turn around the y axis, keyed every quarter turn
+    Animator animator;
+    auto addOrbit = [&animator,&sceneFile,&nodes](const char* pivot, float seconds){
+        int index = sceneFile.FindNode(pivot);
+        if(index < 0){
+            std::cout << "(SDLGraphicsProgram.cpp) ERROR, the scene has no " << pivot
+                      << " node, so that orbit will not move\n";
+            return;
+        }
+        std::vector<float> times;
+        std::vector<glm::quat> rotations;
+        for(int i=0; i <= 4; ++i){
+            times.push_back(seconds*i/4.0f);
+            rotations.push_back(glm::angleAxis(glm::radians(90.0f*i), glm::vec3(0.0f,1.0f,0.0f)));
+        }
+        animator.AddRotationTrack(nodes[index], times, rotations);
+    };
+    addOrbit("EarthOrbit", 20.0f);
+    addOrbit("MoonOrbit", 4.0f);
+    // Everything we need has been copied out of the file
+    sceneFile.Close();
     
     // Set a default position for our camera
     m_renderer->GetCamera(0)->SetCameraEyePosition(0.0f,0.0f,20.0f);
+    // A second camera looking down on the whole system, shown
+    // as a minimap in the top right corner of the window
+    unsigned int overviewCamera = m_renderer->AddCamera();
+    m_renderer->GetCamera(overviewCamera)->SetCameraEyePosition(0.0f,40.0f,25.0f);
+    m_renderer->GetCamera(overviewCamera)->LookAt(0.0f,0.0f,0.0f);
+    RenderView minimap;
+    minimap.camera = overviewCamera;
+    minimap.width = m_renderer->GetScreenWidth()/4;
+    minimap.height = m_renderer->GetScreenHeight()/4;
+    minimap.x = m_renderer->GetScreenWidth()-minimap.width;
+    minimap.y = m_renderer->GetScreenHeight()-minimap.height;
+    int minimapView = m_renderer->AddView(minimap);
 
     // Main loop flag
     // If this is quit = 'true' then the program terminates.
@@ -172,6 +220,8 @@ void SDLGraphicsProgram::Loop(){
 
     // Set the camera speed for how fast we move.
     float cameraSpeed = 5.0f;
+    // Animation follows real time, however long frames take
+    auto lastFrame = std::chrono::steady_clock::now();
 
     // While application is running
     while(!quit){
@@ -190,6 +240,15 @@ void SDLGraphicsProgram::Loop(){
                 int mouseY = e.motion.y;
 //              m_renderer->GetCamera(0)->MouseLook(mouseX, mouseY);
             }
+            // Clicking on an object reports what is under the mouse
+            if(e.type==SDL_MOUSEBUTTONDOWN && e.button.button==SDL_BUTTON_LEFT){
+                float distance = 0.0f;
+                SceneNode* picked = m_renderer->Pick(e.button.x, e.button.y, &distance);
+                if(picked!=nullptr){
+                    std::cout << "Picked a node " << distance << " units away with "
+                              << picked->GetChildCount() << " children\n";
+                }
+            }
             switch(e.type){
                 // Handle keyboard presses
                 case SDL_KEYDOWN:
@@ -212,28 +271,30 @@ void SDLGraphicsProgram::Loop(){
                         case SDLK_RCTRL:
                             m_renderer->GetCamera(0)->MoveDown(cameraSpeed);
                             break;
+                        case SDLK_o:
+                            m_renderer->SetOcclusionCulling(!m_renderer->GetOcclusionCulling());
+                            std::cout << "Occlusion culling " << (m_renderer->GetOcclusionCulling() ? "on" : "off") << "\n";
+                            break;
+                        case SDLK_m:
+                            if(minimapView >= 0){
+                                RenderView& view = m_renderer->GetView(minimapView);
+                                view.enabled = !view.enabled;
+                            }
+                            break;
+                        case SDLK_h:
+                            m_renderer->SetOcclusionQueries(!m_renderer->GetOcclusionQueries());
+                            std::cout << "Occlusion queries " << (m_renderer->GetOcclusionQueries() ? "on" : "off") << "\n";
+                            break;
                     }
                 break;
             }
         } // End SDL_PollEvent loop.
         // ================== Use the planets ===============
-        // TODO:
-        //      After the planets have been created, and the hierarchy
-        //      has been made, you can transform them.
-        //      Note, you'll need to setup the scene graph world/local
-        //      transformation correctly first before the planets are shown.
-        //      
-        //      The 'Sun' for example will be the only object shown initially
-        //      since the rest of the planets are children (or grandchildren)
-        //      of the Sun.
-        Sun->GetLocalTransform().LoadIdentity();		
-        // ... transform the Sun
-
-        Moon->GetLocalTransform().LoadIdentity();		
-        // ... transform the Moon
-
-        Earth->GetLocalTransform().LoadIdentity();		
-        // ... transform the Earth        
+        // Their starting transforms come from the scene file, and the
+        // animator turns the orbits. Only the nodes it moves are updated.
+        auto now = std::chrono::steady_clock::now();
+        animator.Update(std::chrono::duration<float>(now-lastFrame).count());
+        lastFrame = now;
 
         // Update our scene through our renderer
         m_renderer->Update();
@@ -247,6 +308,11 @@ void SDLGraphicsProgram::Loop(){
 	}
     //Disable text input
     SDL_StopTextInput();
+
+    // Free the planets while OpenGL is still around.
+    // Destroying the root destroys the Earth and Moon too.
+    m_renderer->DestroyNode(root);
+    objects.RemoveAll();
 }
 
 
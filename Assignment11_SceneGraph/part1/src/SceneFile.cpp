@@ -0,0 +1,524 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+    // windows.h renames GetObject, which SceneNode uses
+    #undef GetObject
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "SceneFile.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+// Bumped whenever the layout changes
+static const uint32_t SCENE_FILE_VERSION = 2;
+
+// Every offset is from the start of the file, so the
+// file works wherever it is mapped.
+struct SceneFile::Header{
+    char magic[4];
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t nodeCount;
+    uint32_t assetCount;
+    uint32_t levelCount;
+    // nodeCount entries each
+    uint32_t parentsOffset;
+    uint32_t localsOffset;
+    uint32_t nodeAssetsOffset;
+    uint32_t nodeFlagsOffset;
+    uint32_t nodeNamesOffset;
+    // Mesh and texture string offsets, two per asset
+    uint32_t assetsOffset;
+    // levelCount+1 entries
+    uint32_t levelsOffset;
+    // Null terminated strings, starting with an empty one
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    // Hash of the text the file was compiled from
+    uint32_t sourceHash;
+};
+
+// FNV-1a, only used to notice that the text has changed
+static uint32_t HashText(const std::string& text){
+    uint32_t hash = 2166136261u;
+    for(unsigned int i=0; i < text.size(); ++i){
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Reads a whole text file. Returns false if it cannot be opened.
+static bool ReadText(const std::string& path, std::string& text){
+    std::ifstream file(path.c_str());
+    if(!file.is_open()){
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+SceneFile::SceneFile(){
+}
+
+SceneFile::~SceneFile(){
+    Close();
+}
+
+// ============== Compiling ==============
+
+// What the text format describes for one node
+struct TextNode{
+    std::string name;
+    int parent;
+    uint32_t asset;
+    uint32_t flags;
+    Transform local;
+};
+
+// Appends 'bytes' bytes at the next multiple of 'alignment'. Returns their offset.
+static uint32_t AppendSection(std::vector<unsigned char>& file, const void* data, size_t bytes, size_t alignment){
+    size_t offset = (file.size()+alignment-1)/alignment*alignment;
+    file.resize(offset+bytes);
+    if(bytes > 0){
+        std::memcpy(file.data()+offset, data, bytes);
+    }
+    return (uint32_t)offset;
+}
+
+bool SceneFile::Compile(const std::string& textPath, const std::string& binaryPath){
+    std::string source;
+    if(!ReadText(textPath, source)){
+        std::cout << "(SceneFile.cpp) ERROR, could not open " << textPath << "\n";
+        return false;
+    }
+    std::istringstream text(source);
+    // The string table starts with an empty string, used for '-'
+    std::string strings(1,'\0');
+    auto addString = [&strings](const std::string& s) -> uint32_t{
+        if(s=="-"){
+            return 0;
+        }
+        uint32_t offset = strings.size();
+        strings += s;
+        strings += '\0';
+        return offset;
+    };
+    std::vector<TextNode> nodes;
+    std::vector<uint32_t> assets;
+    std::unordered_map<std::string,int> nodeIndices;
+    std::unordered_map<std::string,uint32_t> assetIndices;
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while(std::getline(text,line)){
+        ++lineNumber;
+        // Strip comments
+        size_t comment = line.find('#');
+        if(comment!=std::string::npos){
+            line.erase(comment);
+        }
+        std::istringstream stream(line);
+        std::string command;
+        if(!(stream >> command)){
+            continue;
+        }
+        bool ok = true;
+        if(command=="asset"){
+            std::string name, mesh, texture;
+            ok = (bool)(stream >> name >> mesh >> texture) && assetIndices.count(name)==0;
+            if(ok){
+                assetIndices[name] = assets.size()/2;
+                assets.push_back(addString(mesh));
+                assets.push_back(addString(texture));
+            }
+        }else if(command=="node"){
+            std::string name, parent, asset, flag;
+            ok = (bool)(stream >> name >> parent >> asset) && nodeIndices.count(name)==0 &&
+                 (parent=="-" || nodeIndices.count(parent)==1) &&
+                 (asset=="-" || assetIndices.count(asset)==1);
+            if(ok){
+                TextNode node;
+                node.name = name;
+                node.parent = parent=="-" ? NO_PARENT : nodeIndices[parent];
+                node.asset = asset=="-" ? NO_ASSET : assetIndices[asset];
+                node.flags = 0;
+                while(stream >> flag){
+                    if(flag=="occluder"){
+                        node.flags |= FLAG_OCCLUDER;
+                    }else{
+                        ok = false;
+                    }
+                }
+                nodeIndices[name] = nodes.size();
+                nodes.push_back(node);
+            }
+        }else if(command=="translate" || command=="scale"){
+            float x, y, z;
+            ok = (bool)(stream >> x >> y >> z) && !nodes.empty();
+            if(ok && command=="translate"){
+                nodes.back().local.Translate(x,y,z);
+            }else if(ok){
+                nodes.back().local.Scale(x,y,z);
+            }
+        }else if(command=="rotate"){
+            float degrees, x, y, z;
+            ok = (bool)(stream >> degrees >> x >> y >> z) && !nodes.empty();
+            if(ok){
+                nodes.back().local.Rotate(glm::radians(degrees),x,y,z);
+            }
+        }else{
+            ok = false;
+        }
+        if(!ok){
+            std::cout << "(SceneFile.cpp) ERROR, " << textPath << " line " << lineNumber << ": " << line << "\n";
+            return false;
+        }
+    }
+
+    // Order the nodes breadth first, one level at a time
+    std::vector<std::vector<int>> children(nodes.size());
+    std::vector<int> level;
+    for(unsigned int i=0; i < nodes.size(); ++i){
+        if(nodes[i].parent==NO_PARENT){
+            level.push_back(i);
+        }else{
+            children[nodes[i].parent].push_back(i);
+        }
+    }
+    std::vector<int> order;
+    std::vector<uint32_t> levelStarts;
+    while(!level.empty()){
+        levelStarts.push_back(order.size());
+        std::vector<int> nextLevel;
+        for(unsigned int i=0; i < level.size(); ++i){
+            order.push_back(level[i]);
+            nextLevel.insert(nextLevel.end(),children[level[i]].begin(),children[level[i]].end());
+        }
+        level.swap(nextLevel);
+    }
+    levelStarts.push_back(order.size());
+    std::vector<int> newIndex(nodes.size());
+    for(unsigned int i=0; i < order.size(); ++i){
+        newIndex[order[i]] = i;
+    }
+
+    // Lay out each section as a flat array
+    unsigned int nodeCount = nodes.size();
+    std::vector<int32_t> parents(nodeCount);
+    std::vector<glm::mat4> locals(nodeCount);
+    std::vector<uint32_t> nodeAssets(nodeCount);
+    std::vector<uint32_t> nodeFlags(nodeCount);
+    std::vector<uint32_t> nodeNames(nodeCount);
+    for(unsigned int i=0; i < nodeCount; ++i){
+        const TextNode& node = nodes[order[i]];
+        parents[i] = node.parent==NO_PARENT ? NO_PARENT : newIndex[node.parent];
+        locals[i] = node.local.GetInternalMatrix();
+        nodeAssets[i] = node.asset;
+        nodeFlags[i] = node.flags;
+        nodeNames[i] = addString(node.name);
+    }
+    Header header;
+    std::memset(&header,0,sizeof(header));
+    std::vector<unsigned char> file(sizeof(Header));
+    header.parentsOffset    = AppendSection(file, parents.data(), nodeCount*sizeof(int32_t), 4);
+    header.localsOffset     = AppendSection(file, locals.data(), nodeCount*sizeof(glm::mat4), 16);
+    header.nodeAssetsOffset = AppendSection(file, nodeAssets.data(), nodeCount*sizeof(uint32_t), 4);
+    header.nodeFlagsOffset  = AppendSection(file, nodeFlags.data(), nodeCount*sizeof(uint32_t), 4);
+    header.nodeNamesOffset  = AppendSection(file, nodeNames.data(), nodeCount*sizeof(uint32_t), 4);
+    header.assetsOffset     = AppendSection(file, assets.data(), assets.size()*sizeof(uint32_t), 4);
+    header.levelsOffset     = AppendSection(file, levelStarts.data(), levelStarts.size()*sizeof(uint32_t), 4);
+    header.stringsOffset    = AppendSection(file, strings.data(), strings.size(), 4);
+    std::memcpy(header.magic,"SCN1",4);
+    header.version = SCENE_FILE_VERSION;
+    header.fileSize = file.size();
+    header.nodeCount = nodeCount;
+    header.assetCount = assets.size()/2;
+    header.levelCount = levelStarts.size()-1;
+    header.stringsSize = strings.size();
+    header.sourceHash = HashText(source);
+    std::memcpy(file.data(),&header,sizeof(header));
+
+    std::ofstream binary(binaryPath.c_str(), std::ios::binary);
+    if(!binary.is_open()){
+        std::cout << "(SceneFile.cpp) ERROR, could not write " << binaryPath << "\n";
+        return false;
+    }
+    binary.write(reinterpret_cast<const char*>(file.data()), file.size());
+    return (bool)binary;
+}
+
+// ============== Mapping ==============
+
+// True when an array of 'count' items of 'size' bytes at 'offset' fits in the file
+static bool SectionFits(uint32_t offset, uint32_t count, size_t size, size_t fileSize){
+    return offset <= fileSize && (uint64_t)count*size <= fileSize-offset;
+}
+
+bool SceneFile::Open(const std::string& path, const std::string& sourcePath){
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file==INVALID_HANDLE_VALUE){
+        std::cout << "(SceneFile.cpp) ERROR, could not open " << path << "\n";
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file,&size);
+    HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* data = mapping!=nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(data==nullptr){
+        if(mapping!=nullptr){
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        std::cout << "(SceneFile.cpp) ERROR, could not map " << path << "\n";
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = (size_t)size.QuadPart;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if(file < 0){
+        std::cout << "(SceneFile.cpp) ERROR, could not open " << path << "\n";
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if(fstat(file,&info)==0 && info.st_size > 0){
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    // The mapping stays valid after the file is closed
+    close(file);
+    if(data==MAP_FAILED){
+        std::cout << "(SceneFile.cpp) ERROR, could not map " << path << "\n";
+        return false;
+    }
+    m_size = info.st_size;
+#endif
+    m_data = static_cast<const unsigned char*>(data);
+
+    // Check the header and that every section is inside the file
+    const Header* header = GetHeader();
+    bool valid = m_size >= sizeof(Header) && std::memcmp(header->magic,"SCN1",4)==0 &&
+                 header->version==SCENE_FILE_VERSION && header->fileSize==m_size;
+    if(valid){
+        uint32_t nodes = header->nodeCount;
+        valid = SectionFits(header->parentsOffset, nodes, sizeof(int32_t), m_size) &&
+                SectionFits(header->localsOffset, nodes, sizeof(glm::mat4), m_size) &&
+                header->localsOffset%16==0 &&
+                SectionFits(header->nodeAssetsOffset, nodes, sizeof(uint32_t), m_size) &&
+                SectionFits(header->nodeFlagsOffset, nodes, sizeof(uint32_t), m_size) &&
+                SectionFits(header->nodeNamesOffset, nodes, sizeof(uint32_t), m_size) &&
+                SectionFits(header->assetsOffset, header->assetCount, 2*sizeof(uint32_t), m_size) &&
+                SectionFits(header->levelsOffset, header->levelCount+1, sizeof(uint32_t), m_size) &&
+                SectionFits(header->stringsOffset, header->stringsSize, 1, m_size) &&
+                header->stringsSize > 0 && m_data[header->stringsOffset+header->stringsSize-1]=='\0';
+    }
+    if(valid){
+        // Levels must cover every node in order
+        const uint32_t* levels = GetLevelStarts();
+        valid = levels[0]==0 && levels[header->levelCount]==header->nodeCount;
+        for(unsigned int i=0; valid && i < header->levelCount; ++i){
+            valid = levels[i] <= levels[i+1];
+        }
+    }
+    if(!valid){
+        std::cout << "(SceneFile.cpp) ERROR, " << path << " is not a valid scene file\n";
+        Close();
+        return false;
+    }
+    // Without the text there is nothing to compare against, so the file is used as is
+    std::string source;
+    if(!sourcePath.empty() && ReadText(sourcePath, source) && HashText(source)!=header->sourceHash){
+        std::cout << "(SceneFile.cpp) " << path << " was compiled from an older " << sourcePath << "\n";
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SceneFile::Close(){
+    if(m_data==nullptr){
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+// ============== Accessors ==============
+
+unsigned int SceneFile::GetNodeCount() const{
+    return IsOpen() ? GetHeader()->nodeCount : 0;
+}
+
+const int32_t* SceneFile::GetParents() const{
+    return GetSection<int32_t>(GetHeader()->parentsOffset);
+}
+
+const glm::mat4* SceneFile::GetLocalMatrices() const{
+    return GetSection<glm::mat4>(GetHeader()->localsOffset);
+}
+
+const uint32_t* SceneFile::GetNodeAssets() const{
+    return GetSection<uint32_t>(GetHeader()->nodeAssetsOffset);
+}
+
+const uint32_t* SceneFile::GetNodeFlags() const{
+    return GetSection<uint32_t>(GetHeader()->nodeFlagsOffset);
+}
+
+// Strings out of range come back empty rather than pointing outside the file
+static const char* GetString(const unsigned char* data, uint32_t stringsOffset, uint32_t stringsSize, uint32_t offset){
+    if(offset >= stringsSize){
+        offset = 0;
+    }
+    return reinterpret_cast<const char*>(data+stringsOffset+offset);
+}
+
+const char* SceneFile::GetNodeName(unsigned int node) const{
+    const Header* header = GetHeader();
+    return GetString(m_data, header->stringsOffset, header->stringsSize,
+                     GetSection<uint32_t>(header->nodeNamesOffset)[node]);
+}
+
+unsigned int SceneFile::GetLevelCount() const{
+    return IsOpen() ? GetHeader()->levelCount : 0;
+}
+
+const uint32_t* SceneFile::GetLevelStarts() const{
+    return GetSection<uint32_t>(GetHeader()->levelsOffset);
+}
+
+unsigned int SceneFile::GetAssetCount() const{
+    return IsOpen() ? GetHeader()->assetCount : 0;
+}
+
+const char* SceneFile::GetAssetMesh(unsigned int asset) const{
+    const Header* header = GetHeader();
+    return GetString(m_data, header->stringsOffset, header->stringsSize,
+                     GetSection<uint32_t>(header->assetsOffset)[asset*2]);
+}
+
+const char* SceneFile::GetAssetTexture(unsigned int asset) const{
+    const Header* header = GetHeader();
+    return GetString(m_data, header->stringsOffset, header->stringsSize,
+                     GetSection<uint32_t>(header->assetsOffset)[asset*2+1]);
+}
+
+int SceneFile::FindNode(const char* name) const{
+    for(unsigned int i=0; i < GetNodeCount(); ++i){
+        if(std::strcmp(GetNodeName(i),name)==0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+// ============== Using the scene ==============
+
+bool SceneFile::ComputeWorldMatrices(glm::mat4* worlds) const{
+    const int32_t* parents = GetParents();
+    const glm::mat4* locals = GetLocalMatrices();
+    for(unsigned int i=0; i < GetNodeCount(); ++i){
+        int32_t parent = parents[i];
+        if(parent==NO_PARENT){
+            worlds[i] = locals[i];
+        }else if(parent >= 0 && (unsigned int)parent < i){
+            Transform::MultiplyAffine(worlds[parent], locals[i], worlds[i]);
+        }else{
+            std::cout << "(SceneFile.cpp) ERROR, node " << i << " comes before its parent\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+NodeHandle SceneFile::Instantiate(const AssetLoader& loadAsset, std::vector<NodeHandle>& handles) const{
+    unsigned int nodeCount = GetNodeCount();
+    handles.assign(nodeCount, NodeHandle());
+    if(nodeCount==0){
+        return NodeHandle();
+    }
+    const int32_t* parents = GetParents();
+    const glm::mat4* locals = GetLocalMatrices();
+    const uint32_t* nodeAssets = GetNodeAssets();
+    // Each asset is loaded the first time a node uses it
+    std::vector<Object*> objects(GetAssetCount(), nullptr);
+    // Nodes come from a pool, make room for all of them at once
+    SceneNode::Reserve(SceneNode::GetNodeCount()+nodeCount+1);
+
+    // So are the lists of children
+    std::vector<unsigned int> childCounts(nodeCount, 0);
+    for(unsigned int i=0; i < nodeCount; ++i){
+        if(parents[i] >= 0 && (unsigned int)parents[i] < nodeCount){
+            ++childCounts[parents[i]];
+        }
+    }
+
+    const uint32_t* levels = GetLevelStarts();
+    bool severalRoots = levels[1]-levels[0] > 1;
+    NodeHandle root = severalRoots ? SceneNode::Create(nullptr) : NodeHandle();
+    if(severalRoots){
+        SceneNode::Get(root)->ReserveChildren(levels[1]-levels[0]);
+    }
+    for(unsigned int i=0; i < nodeCount; ++i){
+        int32_t parent = parents[i];
+        uint32_t asset = nodeAssets[i];
+        // Parents come first, and a single root comes before everything else
+        bool valid = (parent==NO_PARENT ? severalRoots || root.IsNull()
+                                        : parent >= 0 && (unsigned int)parent < i) &&
+                     (asset==NO_ASSET || asset < objects.size());
+        if(!valid){
+            std::cout << "(SceneFile.cpp) ERROR, node " << i << " has a bad parent or asset\n";
+            // Destroying the root destroys everything made so far
+            if(!root.IsNull()){
+                SceneNode::Destroy(root);
+            }
+            handles.assign(nodeCount, NodeHandle());
+            return NodeHandle();
+        }
+        Object* object = nullptr;
+        if(asset!=NO_ASSET){
+            if(objects[asset]==nullptr){
+                objects[asset] = loadAsset(GetAssetMesh(asset), GetAssetTexture(asset));
+            }
+            object = objects[asset];
+        }
+        handles[i] = SceneNode::Create(object);
+        Transform local;
+        local.SetInternalMatrix(locals[i]);
+        SceneNode::Get(handles[i])->SetLocalTransform(local);
+        SceneNode::Get(handles[i])->ReserveChildren(childCounts[i]);
+        if(parent!=NO_PARENT){
+            SceneNode::Get(handles[parent])->AddChild(handles[i]);
+        }else if(severalRoots){
+            SceneNode::Get(root)->AddChild(handles[i]);
+        }else{
+            root = handles[i];
+        }
+    }
+    return root;
+}
@@ -1,8 +1,64 @@
 #include "SceneNode.hpp"
+#include "JobSystem.hpp"
 
+#include <algorithm>
+#include <mutex>
 #include <string>
 #include <iostream>
 
+// Guards the list of moved nodes when children update in parallel
+static std::mutex s_movedNodesMutex;
+// Guards the queue and stats that parallel culling jobs merge into
+static std::mutex s_submitMutex;
+// Bumped whenever the shape of any tree changes
+static unsigned int s_structureVersion = 0;
+
+// Every node lives here
+static Pool<SceneNode>& GetNodePool(){
+	static Pool<SceneNode> s_pool;
+	return s_pool;
+}
+
+// True (and counted) when a whole subtree is hidden behind occluders
+static bool IsSubtreeOccluded(const SceneNode* node, const OcclusionCuller* occlusion, CullingStats& stats){
+	if(occlusion==nullptr || !occlusion->IsOccluded(node->GetSubtreeBounds())){
+		return false;
+	}
+	stats.nodesOccluded += node->GetSubtreeNodeCount();
+	return true;
+}
+
+// Every node shares one shader unless it is given another.
+// Only a weak reference is kept so the shader goes away with the last node.
+static std::shared_ptr<Shader> GetDefaultShader(){
+	static std::weak_ptr<Shader> s_defaultShader;
+	std::shared_ptr<Shader> shader = s_defaultShader.lock();
+	if(shader!=nullptr){
+		return shader;
+	}
+	shader = std::make_shared<Shader>();
+	// Setup shaders for the node.
+	std::string vertexShader = shader->LoadShader("./shaders/vert.glsl");
+	std::string fragmentShader = shader->LoadShader("./shaders/frag.glsl");
+	// Actually create our shader
+	shader->CreateShader(vertexShader,fragmentShader);
+
+	// Uniforms that never change only need to be set once,
+	// the program remembers them.
+	shader->Bind();
+	// For our object, we apply the texture in the following way
+	// Note that we set the value to 0, because we have bound
+	// our texture to slot 0.
+	shader->SetUniform1i("u_DiffuseMap",0);
+	// Create a 'light'
+	shader->SetUniform3f("lightColor",1.0f,1.0f,1.0f);
+	shader->SetUniform1f("ambientIntensity",0.5f);
+	shader->Unbind();
+
+	s_defaultShader = shader;
+	return shader;
+}
+
 // The constructor
 SceneNode::SceneNode(Object* ob){
 	std::cout << "(SceneNode.cpp) Constructor called\n";
@@ -12,24 +68,73 @@ SceneNode::SceneNode(Object* ob){
 	// If the SceneNode is the root of the tree,
 	// then there is no parent.
 	m_parent = nullptr;
-	
-	// Setup shaders for the node.
-	std::string vertexShader = m_shader.LoadShader("./shaders/vert.glsl");
-	std::string fragmentShader = m_shader.LoadShader("./shaders/frag.glsl");
-	// Actually create our shader
-	m_shader.CreateShader(vertexShader,fragmentShader);       
+
+	// Compute the object's bounds now, rather than during a
+	// (possibly multithreaded) Update. Nodes without an object
+	// are never drawn, so they do not need a shader.
+	if(m_object!=nullptr){
+		m_shader = GetDefaultShader();
+		m_object->GetLocalBounds();
+	}
 }
 
-// The destructor 
+// The destructor
 SceneNode::~SceneNode(){
 	// Remove each object
 	for(unsigned int i =0; i < m_children.size(); ++i){
-		delete m_children[i];
+		GetNodePool().Destroy(m_children[i]->m_handle);
+	}
+}
+
+NodeHandle SceneNode::Create(Object* ob){
+	NodeHandle handle = GetNodePool().Create(ob);
+	SceneNode* node = GetNodePool().Get(handle);
+	if(node!=nullptr){
+		node->m_handle = handle;
+	}
+	return handle;
+}
+
+SceneNode* SceneNode::Get(NodeHandle handle){
+	return GetNodePool().Get(handle);
+}
+
+void SceneNode::Destroy(NodeHandle handle){
+	SceneNode* node = GetNodePool().Get(handle);
+	if(node==nullptr){
+		std::cout << "(SceneNode.cpp) ERROR, Destroy called with a stale handle\n";
+		return;
+	}
+	if(node->m_parent!=nullptr){
+		node->m_parent->RemoveChild(node);
 	}
+	++s_structureVersion;
+	GetNodePool().Destroy(handle);
+}
+
+void SceneNode::Reserve(unsigned int count){
+	GetNodePool().Reserve(count);
+}
+
+unsigned int SceneNode::GetNodeCount(){
+	return GetNodePool().GetCount();
+}
+
+unsigned int SceneNode::GetStructureVersion(){
+	return s_structureVersion;
 }
 
 // Adds a child node to our current node.
-void SceneNode::AddChild(SceneNode* n){
+void SceneNode::AddChild(NodeHandle child){
+	SceneNode* n = GetNodePool().Get(child);
+	if(n==nullptr){
+		std::cout << "(SceneNode.cpp) ERROR, AddChild called with a stale handle\n";
+		return;
+	}
+	// A node only has one parent
+	if(n->m_parent!=nullptr){
+		n->m_parent->RemoveChild(n);
+	}
 	// For the node we have added, we can set
 	// it's parent now to our current node.
 	// 'this' is the current instance of our
@@ -37,80 +142,243 @@ void SceneNode::AddChild(SceneNode* n){
 	// SceneNode.
 	n->m_parent = this;
 	// Add a child node into our SceneNode
+	n->m_indexInParent = m_children.size();
 	m_children.push_back(n);
+	++s_structureVersion;
+	// Every ancestor's subtree just grew
+	for(SceneNode* p = this; p!=nullptr; p = p->m_parent){
+		p->m_subtreeNodeCount += n->m_subtreeNodeCount;
+	}
+	// The child now lives under a new parent
+	n->MarkDirty();
 }
 
-// Draw simply draws the current nodes
-// object and all of its children. This is done by calling directly
-// the objects draw method.
-void SceneNode::Draw(){
-	// Bind the shader for this node or series of nodes
-	m_shader.Bind();
-	// Render our object
-	if(m_object!=nullptr){
-		// Render our object
-		m_object->Render();
-		// For any 'child nodes' also call the drawing routine.
-		for(int i =0; i < m_children.size(); ++i){
-			m_children[i]->Draw();
+// Swaps the last child into the removed child's place, so
+// the order of children may change.
+void SceneNode::RemoveChild(SceneNode* child){
+	unsigned int index = child->m_indexInParent;
+	m_children[index] = m_children.back();
+	m_children[index]->m_indexInParent = index;
+	m_children.pop_back();
+	++s_structureVersion;
+	for(SceneNode* p = this; p!=nullptr; p = p->m_parent){
+		p->m_subtreeNodeCount -= child->m_subtreeNodeCount;
+	}
+	child->m_parent = nullptr;
+	// Our subtree bounds need recomputing
+	MarkDirty();
+}
+
+// Submit adds a draw for the current node's object and all
+// of its children that the camera can see. Nothing is drawn
+// until the queue is submitted.
+void SceneNode::Submit(RenderQueue& queue, const glm::mat4& view, float farPlane,
+                       const Frustum& frustum, CullingStats& stats,
+                       const OcclusionCuller* occlusion){
+	++stats.nodesTested;
+	Containment containment = frustum.TestAABB(m_subtreeBounds);
+	if(containment==Containment::Outside){
+		stats.nodesCulled += m_subtreeNodeCount;
+		return;
+	}
+	if(IsSubtreeOccluded(this, occlusion, stats)){
+		return;
+	}
+	SubmitVisible(queue, view, farPlane, frustum, stats, occlusion, containment==Containment::Inside, true);
+}
+
+void SceneNode::SubmitVisible(RenderQueue& queue, const glm::mat4& view, float farPlane,
+                              const Frustum& frustum, CullingStats& stats,
+                              const OcclusionCuller* occlusion, bool inside, bool parallel){
+	// Our subtree passed, but our own object might not have
+	bool drawObject = m_object!=nullptr && m_shader!=nullptr;
+	if(drawObject && !m_children.empty()){
+		if(!inside){
+			++stats.nodesTested;
+			if(frustum.TestAABB(m_worldBounds)==Containment::Outside){
+				++stats.nodesCulled;
+				drawObject = false;
+			}
 		}
-	}	
-}
-
-// Update simply updates the current nodes
-// object. This is done by calling directly
-// the objects update method.
-// TODO: Consider not passting projection and camera here
-void SceneNode::Update(glm::mat4 projectionMatrix, Camera* camera){
-    if(m_object!=nullptr){
-        // TODO: Implement here!
-    
-		// ??
-		// ??
-		// ??
-		// ??
-		// ??
-		// ??	
-		// ??
-		// ??	
-
-    	// Now apply our shader 
-		m_shader.Bind();
-    	// Set the uniforms in our current shader
-
-        // For our object, we apply the texture in the following way
-        // Note that we set the value to 0, because we have bound
-        // our texture to slot 0.
-        m_shader.SetUniform1i("u_DiffuseMap",0);  
-        // Set the MVP Matrix for our object
-        // Send it into our shader
-        m_shader.SetUniformMatrix4fv("model", &m_worldTransform.GetInternalMatrix()[0][0]);
-        m_shader.SetUniformMatrix4fv("view", &camera->GetWorldToViewmatrix()[0][0]);
-        m_shader.SetUniformMatrix4fv("projection", &projectionMatrix[0][0]);
-
-        // Create a 'light'
-        m_shader.SetUniform3f("lightColor",1.0f,1.0f,1.0f);
-        m_shader.SetUniform3f("lightPos",
-                               camera->GetEyeXPosition() + camera->GetViewXDirection(),
-                               camera->GetEyeYPosition() + camera->GetViewYDirection(),
-                               camera->GetEyeZPosition() + camera->GetViewZDirection());
-        m_shader.SetUniform1f("ambientIntensity",0.5f);
-	
-		// Iterate through all of the children
-		for(int i =0; i < m_children.size(); ++i){
-			m_children[i]->Update(projectionMatrix, camera);
+		if(drawObject && occlusion!=nullptr && occlusion->IsOccluded(m_worldBounds)){
+			++stats.nodesOccluded;
+			drawObject = false;
 		}
 	}
+	if(drawObject){
+		// Distance in front of the camera, from our world position
+		glm::vec4 viewPosition = view * m_worldTransform.GetInternalMatrix()[3];
+		float depth = -viewPosition.z/farPlane;
+
+		DrawPacket packet;
+		packet.shader = m_shader.get();
+		packet.object = m_object;
+		packet.model = m_worldTransform.GetTransformMatrix();
+		packet.node = this;
+		queue.Push(RenderQueue::MakeSortKey(RenderPass::Opaque,
+		                                    m_shader->GetID(),
+		                                    m_object->GetDiffuseTextureID(),
+		                                    m_object->GetVertexArrayID(),
+		                                    depth),
+		           packet);
+	}
+	// Nodes without an object can still be used to group children.
+	if(!parallel || m_children.size() <= CHILDREN_PER_JOB){
+		SubmitChildren(0, m_children.size(), queue, view, farPlane, frustum, stats, occlusion, inside, parallel);
+		return;
+	}
+	// Sibling subtrees are culled independently, so wide nodes hand
+	// groups of children to the job system. Each group fills its own
+	// queue, then adds it in one go. Nothing below splits again.
+	JobSystem::Instance().ParallelFor(m_children.size(), CHILDREN_PER_JOB,
+		[&](unsigned int first, unsigned int last){
+			// Jobs never wait inside a group, so one queue per thread is enough
+			static thread_local RenderQueue s_groupQueue;
+			s_groupQueue.Clear();
+			CullingStats groupStats;
+			SubmitChildren(first, last, s_groupQueue, view, farPlane, frustum, groupStats, occlusion, inside, false);
+			std::lock_guard<std::mutex> lock(s_submitMutex);
+			queue.Append(s_groupQueue);
+			stats.nodesTested += groupStats.nodesTested;
+			stats.nodesCulled += groupStats.nodesCulled;
+			stats.nodesOccluded += groupStats.nodesOccluded;
+		});
+}
+
+void SceneNode::SubmitChildren(unsigned int first, unsigned int last,
+                               RenderQueue& queue, const glm::mat4& view, float farPlane,
+                               const Frustum& frustum, CullingStats& stats,
+                               const OcclusionCuller* occlusion, bool inside, bool parallel){
+	// Once a subtree is completely inside nothing below needs frustum tests.
+	if(inside){
+		for(unsigned int i=first; i < last; ++i){
+			if(!IsSubtreeOccluded(m_children[i], occlusion, stats)){
+				m_children[i]->SubmitVisible(queue, view, farPlane, frustum, stats, occlusion, true, parallel);
+			}
+		}
+		return;
+	}
+	// Test our children's subtrees four at a time
+	const unsigned int batchSize = 4;
+	const AABB* boxes[batchSize];
+	Containment results[batchSize];
+	for(; first < last; first+=batchSize){
+		unsigned int count = std::min<unsigned int>(batchSize, last-first);
+		for(unsigned int i=0; i < count; ++i){
+			boxes[i] = &m_children[first+i]->m_subtreeBounds;
+		}
+		frustum.TestAABBs(boxes, count, results);
+		stats.nodesTested += count;
+		for(unsigned int i=0; i < count; ++i){
+			SceneNode* child = m_children[first+i];
+			if(results[i]==Containment::Outside){
+				stats.nodesCulled += child->m_subtreeNodeCount;
+			}else if(!IsSubtreeOccluded(child, occlusion, stats)){
+				child->SubmitVisible(queue, view, farPlane, frustum, stats, occlusion, results[i]==Containment::Inside, parallel);
+			}
+		}
+	}
+}
+
+// Update brings the world transform of this node and
+// everything below it up to date. Subtrees where nothing
+// changed are skipped entirely.
+void SceneNode::Update(std::vector<SceneNode*>* movedNodes){
+	if(m_parent!=nullptr){
+		UpdateWorldTransform(m_parent->m_worldTransform, false, movedNodes);
+	}else{
+		UpdateWorldTransform(Transform(), false, movedNodes);
+	}
+}
+
+void SceneNode::UpdateWorldTransform(const Transform& parentWorld, bool parentChanged,
+                                     std::vector<SceneNode*>* movedNodes){
+	bool changed = m_dirty || parentChanged;
+	if(changed){
+		// Our world is our parents world with our local transform applied
+		m_worldTransform.SetProduct(parentWorld, m_localTransform);
+		m_dirty = false;
+		UpdateWorldBounds(movedNodes);
+	}
+	// When we moved every child moves with us, otherwise only
+	// visit children if one of them asked for it.
+	if(changed || m_childDirty){
+		// Sibling subtrees do not share anything, so wide nodes
+		// hand groups of children to the job system.
+		JobSystem::Instance().ParallelFor(m_children.size(), CHILDREN_PER_JOB,
+			[this,changed,movedNodes](unsigned int first, unsigned int last){
+				// Each group collects its own list, then adds it in one go
+				std::vector<SceneNode*> moved;
+				for(unsigned int i=first; i < last; ++i){
+					m_children[i]->UpdateWorldTransform(m_worldTransform, changed,
+					                                    movedNodes!=nullptr ? &moved : nullptr);
+				}
+				if(!moved.empty()){
+					std::lock_guard<std::mutex> lock(s_movedNodesMutex);
+					movedNodes->insert(movedNodes->end(),moved.begin(),moved.end());
+				}
+			});
+		// Our children are done, so our subtree bounds can be rebuilt
+		UpdateSubtreeBounds();
+	}
+	m_childDirty = false;
+}
+
+void SceneNode::UpdateWorldBounds(std::vector<SceneNode*>* movedNodes){
+	if(m_object==nullptr){
+		return;
+	}
+	const AABB& localBounds = m_object->GetLocalBounds();
+	const glm::mat4& world = m_worldTransform.GetInternalMatrix();
+	m_worldBounds = localBounds.Transformed(world);
+	m_worldSphere = BoundingSphere::FromAABB(localBounds).Transformed(world);
+	if(movedNodes!=nullptr){
+		movedNodes->push_back(this);
+	}
+}
+
+void SceneNode::UpdateSubtreeBounds(){
+	m_subtreeBounds = m_worldBounds;
+	m_subtreeSphere = m_worldSphere;
+	for(unsigned int i=0; i < m_children.size(); ++i){
+		m_subtreeBounds.Expand(m_children[i]->m_subtreeBounds);
+		m_subtreeSphere.Expand(m_children[i]->m_subtreeSphere);
+	}
+}
+
+// Flags this node, and lets each ancestor know it has
+// a dirty descendent so Update can find us.
+void SceneNode::MarkDirty(){
+	m_dirty = true;
+	SceneNode* p = m_parent;
+	// Once an ancestor is already flagged, so are all of its ancestors
+	while(p!=nullptr && !p->m_childDirty){
+		p->m_childDirty = true;
+		p = p->m_parent;
+	}
 }
 
 // Returns the actual local transform stored in our SceneNode
 // which can then be modified
 Transform& SceneNode::GetLocalTransform(){
-    return m_localTransform; 
+	// We cannot know what the caller will do, so assume it changes
+	MarkDirty();
+	return m_localTransform;
 }
 
-// Returns the worled  transform stored in our SceneNode
-// which can then be modified
-Transform& SceneNode::GetWorldTransform(){
-    return m_worldTransform; 
+// Read only access to the local transform
+const Transform& SceneNode::GetLocalTransform() const{
+	return m_localTransform;
+}
+
+// Replaces the local transform
+void SceneNode::SetLocalTransform(const Transform& t){
+	m_localTransform = t;
+	MarkDirty();
+}
+
+// Returns the world transform stored in our SceneNode.
+// This is computed in Update from our parents.
+const Transform& SceneNode::GetWorldTransform() const{
+	return m_worldTransform;
 }
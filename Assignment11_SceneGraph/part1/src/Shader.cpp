@@ -77,6 +77,9 @@ void Shader::CreateShader(const std::string& vertexShaderSource, const std::stri
     }
 
     m_shaderID = program;
+    m_modelLocation = glGetUniformLocation(m_shaderID,"model");
+    // A new program has none of the frame's uniforms yet
+    m_frameVersion = 0;
 }
 
 
@@ -160,6 +163,10 @@ void Shader::SetUniformMatrix4fv(const GLchar* name, const GLfloat* value){
     glUniformMatrix4fv(location, 1, GL_FALSE, value);
 }
 
+void Shader::SetUniformMatrix4fv(GLint location, const GLfloat* value){
+    glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
 // Set our uniforms for our shader (Useful for a vec3).
 void Shader::SetUniform3f(const GLchar* name, float v0, float v1, float v2){
     GLint location = glGetUniformLocation(m_shaderID,name);
@@ -79,6 +79,10 @@ void Texture::LoadTexture(const std::string filepath){
 // slot tells us which slot we want to bind to.
 // We can have multiple slots. By default, we
 // will set our slot to 0 if it is not specified.
+GLuint Texture::GetID() const{
+    return m_textureID;
+}
+
 void Texture::Bind(unsigned int slot) const{
 	// Using OpenGL 'state' machine we set the active texture
 	// slot that we want to occupy. Again, there could
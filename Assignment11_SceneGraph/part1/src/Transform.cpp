@@ -1,5 +1,10 @@
 #include "Transform.hpp"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define TRANSFORM_USE_SSE
+#endif
+
 // By default, all transform matrices
 // are also identity matrices
 Transform::Transform(){
@@ -12,60 +17,204 @@ Transform::~Transform(){
 
 // Resets the model transform as the identity matrix.
 void Transform::LoadIdentity(){
+    m_position = glm::vec3(0.0f);
+    m_rotation = glm::quat(1.0f,0.0f,0.0f,0.0f);
+    m_scale = glm::vec3(1.0f);
     m_modelTransformMatrix = glm::mat4(1.0f);
+    m_matrixDirty = false;
+    m_trsDirty = false;
+    m_affine = true;
 }
 
 void Transform::Translate(float x, float y, float z){
-        // Here we apply our camera
-        // This first transformation is applied to the object
-        // This is the model transform matrix.
-        // That is, 'how do I move our model'
-        // Here we see I have translated the model -1.0f away from its original location.
-        // We supply the first argument which is the matrix we want to apply
-        // this transformation to (Our previous transformation matrix.
-        m_modelTransformMatrix = glm::translate(m_modelTransformMatrix,glm::vec3(x,y,z));                            
+    if(m_trsDirty){
+        m_modelTransformMatrix = glm::translate(m_modelTransformMatrix,glm::vec3(x,y,z));
+        return;
+    }
+    // Moving along our own (rotated and scaled) axes
+    m_position += m_rotation*(m_scale*glm::vec3(x,y,z));
+    m_matrixDirty = true;
 }
 
 void Transform::Rotate(float radians, float x, float y, float z){
-    m_modelTransformMatrix = glm::rotate(m_modelTransformMatrix, radians,glm::vec3(x,y,z));        
+    // A rotation after a non-uniform scale shears, which
+    // position, rotation and scale cannot describe
+    if(m_trsDirty || m_scale.x!=m_scale.y || m_scale.x!=m_scale.z){
+        UseMatrix();
+        m_modelTransformMatrix = glm::rotate(m_modelTransformMatrix, radians,glm::vec3(x,y,z));
+        return;
+    }
+    m_rotation = glm::normalize(m_rotation*glm::angleAxis(radians,glm::normalize(glm::vec3(x,y,z))));
+    m_matrixDirty = true;
 }
 
 void Transform::Scale(float x, float y, float z){
-    m_modelTransformMatrix = glm::scale(m_modelTransformMatrix,glm::vec3(x,y,z));        
+    if(m_trsDirty){
+        m_modelTransformMatrix = glm::scale(m_modelTransformMatrix,glm::vec3(x,y,z));
+        return;
+    }
+    m_scale *= glm::vec3(x,y,z);
+    m_matrixDirty = true;
 }
 
 // Returns the actual transform matrix
-// Useful for sending 
-GLfloat* Transform::GetTransformMatrix(){
-    return &m_modelTransformMatrix[0][0];
+// Useful for sending
+const GLfloat* Transform::GetTransformMatrix() const{
+    return &GetInternalMatrix()[0][0];
 }
 
 
 // Get the raw internal matrix from the class
-glm::mat4 Transform::GetInternalMatrix() const{
+const glm::mat4& Transform::GetInternalMatrix() const{
+    if(m_matrixDirty){
+        ComposeMatrix();
+    }
     return m_modelTransformMatrix;
 }
 
-void Transform::ApplyTransform(Transform t){
-    m_modelTransformMatrix = t.GetInternalMatrix();
+void Transform::SetInternalMatrix(const glm::mat4& matrix){
+    m_modelTransformMatrix = matrix;
+    m_matrixDirty = false;
+    m_trsDirty = true;
+    m_affine = matrix[0][3]==0.0f && matrix[1][3]==0.0f && matrix[2][3]==0.0f && matrix[3][3]==1.0f;
+}
+
+void Transform::ApplyTransform(const Transform& t){
+    *this = t;
+}
+
+const glm::vec3& Transform::GetPosition() const{
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    return m_position;
+}
+
+const glm::quat& Transform::GetRotation() const{
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    return m_rotation;
 }
 
+const glm::vec3& Transform::GetScale() const{
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    return m_scale;
+}
+
+void Transform::SetPosition(const glm::vec3& position){
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    m_position = position;
+    m_matrixDirty = true;
+}
+
+void Transform::SetRotation(const glm::quat& rotation){
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    m_rotation = rotation;
+    m_matrixDirty = true;
+}
+
+void Transform::SetScale(const glm::vec3& scale){
+    if(m_trsDirty){
+        DecomposeMatrix();
+    }
+    m_scale = scale;
+    m_matrixDirty = true;
+}
+
+void Transform::ComposeMatrix() const{
+    // Columns of the rotation, scaled, then the position
+    glm::mat4 matrix = glm::mat4_cast(m_rotation);
+    matrix[0] *= m_scale.x;
+    matrix[1] *= m_scale.y;
+    matrix[2] *= m_scale.z;
+    matrix[3] = glm::vec4(m_position,1.0f);
+    m_modelTransformMatrix = matrix;
+    m_matrixDirty = false;
+}
+
+void Transform::DecomposeMatrix() const{
+    const glm::mat4& m = m_modelTransformMatrix;
+    m_position = glm::vec3(m[3]);
+    m_scale = glm::vec3(glm::length(glm::vec3(m[0])),
+                        glm::length(glm::vec3(m[1])),
+                        glm::length(glm::vec3(m[2])));
+    if(m_scale.x > 0.0f && m_scale.y > 0.0f && m_scale.z > 0.0f){
+        glm::mat3 rotation(glm::vec3(m[0])/m_scale.x,
+                           glm::vec3(m[1])/m_scale.y,
+                           glm::vec3(m[2])/m_scale.z);
+        m_rotation = glm::normalize(glm::quat_cast(rotation));
+    }else{
+        m_rotation = glm::quat(1.0f,0.0f,0.0f,0.0f);
+    }
+    // The matrix stays exact, so it is still up to date
+    m_trsDirty = false;
+}
+
+void Transform::UseMatrix(){
+    GetInternalMatrix();
+    m_trsDirty = true;
+}
+
+void Transform::SetProduct(const Transform& lhs, const Transform& rhs){
+    const glm::mat4& a = lhs.GetInternalMatrix();
+    const glm::mat4& b = rhs.GetInternalMatrix();
+    bool affine = lhs.m_affine && rhs.m_affine;
+    if(affine){
+        MultiplyAffine(a,b,m_modelTransformMatrix);
+    }else{
+        m_modelTransformMatrix = a*b;
+    }
+    m_matrixDirty = false;
+    m_trsDirty = true;
+    m_affine = affine;
+}
+
+#ifdef TRANSFORM_USE_SSE
+// One column of the result per instruction, skipping the
+// zeros in the last row of 'b'
+void Transform::MultiplyAffine(const glm::mat4& a, const glm::mat4& b, glm::mat4& out){
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for(int j=0; j < 4; ++j){
+        __m128 r = _mm_mul_ps(a0,_mm_set1_ps(b[j][0]));
+        r = _mm_add_ps(r,_mm_mul_ps(a1,_mm_set1_ps(b[j][1])));
+        r = _mm_add_ps(r,_mm_mul_ps(a2,_mm_set1_ps(b[j][2])));
+        if(j==3){
+            r = _mm_add_ps(r,a3);
+        }
+        _mm_storeu_ps(&out[j][0],r);
+    }
+}
+#else
+void Transform::MultiplyAffine(const glm::mat4& a, const glm::mat4& b, glm::mat4& out){
+    glm::vec4 a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+    for(int j=0; j < 4; ++j){
+        glm::vec4 bj = b[j];
+        out[j] = a0*bj.x + a1*bj.y + a2*bj.z;
+    }
+    out[3] += a3;
+}
+#endif
+
 
 // Perform a matrix multiplication with our Transform
 Transform& Transform::operator*=(const Transform& t) {
-    m_modelTransformMatrix =  m_modelTransformMatrix * t.GetInternalMatrix();
+    SetProduct(*this,t);
     return *this;
 }
 
 // Perform a matrix addition with our Transform
 Transform& Transform::operator+=(const Transform& t) {
-    m_modelTransformMatrix =  m_modelTransformMatrix + t.GetInternalMatrix();
-    return *this;
-}
-
-// Matrix assignment
-Transform& Transform::operator=(const Transform& t) {
-    m_modelTransformMatrix =  t.GetInternalMatrix();
+    SetInternalMatrix(GetInternalMatrix() + t.GetInternalMatrix());
     return *this;
 }
 
@@ -73,12 +222,11 @@ Transform& Transform::operator=(const Transform& t) {
 //       x * y should return a copy, rather than a reference
 //       need to be very careful when operator overloading.
 //       See operator*= for an example of returning the reference
-//       and avoiding the copy.
-// This code probably needs optimized (lots of new objects on the stack!)
+//       and avoiding the copy. SetProduct avoids the copy entirely.
 Transform operator*(const Transform& lhs, const Transform& rhs){
     Transform result;
 
-    result.m_modelTransformMatrix = lhs.GetInternalMatrix() * rhs.GetInternalMatrix();
+    result.SetProduct(lhs,rhs);
 
     return result;
 }
@@ -87,7 +235,7 @@ Transform operator*(const Transform& lhs, const Transform& rhs){
 Transform operator+(const Transform& lhs, const Transform& rhs){
     Transform result;
 
-    result.m_modelTransformMatrix = lhs.GetInternalMatrix() + rhs.GetInternalMatrix();
+    result.SetInternalMatrix(lhs.GetInternalMatrix() + rhs.GetInternalMatrix());
 
     return result;
 }
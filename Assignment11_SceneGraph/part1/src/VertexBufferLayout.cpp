@@ -22,6 +22,10 @@ void VertexBufferLayout::Bind(){
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferObject);
 }
 
+GLuint VertexBufferLayout::GetID() const{
+    return m_VAOId;
+}
+
 // Note: Calling Unbind is rarely done, if you need
 // to draw something else then just bind to new buffer.
 void VertexBufferLayout::Unbind(){